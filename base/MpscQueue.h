@@ -0,0 +1,106 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#ifndef MUDUO_BASE_MPSCQUEUE_H
+#define MUDUO_BASE_MPSCQUEUE_H
+
+#include <boost/noncopyable.hpp>
+#include <assert.h>
+#include <stddef.h>
+#include <utility>
+
+namespace muduo
+{
+
+///
+/// Unbounded lock-free queue, many producers, one consumer.
+///
+/// put() is wait-free, one allocation and one atomic exchange.
+/// front()/pop() must only be called from the consumer thread.
+/// front() may miss an element whose put() has not returned yet,
+/// callers need their own signal to come back for it.
+///
+/// http://www.1024cores.net/home/lock-free-algorithms/queues/non-intrusive-mpsc-node-based-queue
+template<typename T>
+class MpscQueue : boost::noncopyable
+{
+ public:
+  MpscQueue()
+    : head_(new Node),
+      tail_(head_)
+  {
+  }
+
+  ~MpscQueue()
+  {
+    while (front())
+    {
+      pop();
+    }
+    delete tail_;
+  }
+
+  void put(const T& x)
+  {
+    push(new Node(x));
+  }
+
+#ifdef __GXX_EXPERIMENTAL_CXX0X__
+  void put(T&& x)
+  {
+    push(new Node(std::move(x)));
+  }
+#endif
+
+  /// The oldest element, or NULL if the queue is empty.
+  T* front()
+  {
+    Node* next = __atomic_load_n(&tail_->next, __ATOMIC_ACQUIRE);
+    return next ? &next->value : NULL;
+  }
+
+  /// Removes the element returned by front().
+  void pop()
+  {
+    Node* next = __atomic_load_n(&tail_->next, __ATOMIC_ACQUIRE);
+    assert(next != NULL);
+    delete tail_;
+    tail_ = next;
+    // next is the new stub, release what it holds now.
+    next->value = T();
+  }
+
+  bool empty()
+  {
+    return front() == NULL;
+  }
+
+ private:
+  struct Node
+  {
+    Node() : next(NULL), value() { }
+    explicit Node(const T& x) : next(NULL), value(x) { }
+#ifdef __GXX_EXPERIMENTAL_CXX0X__
+    explicit Node(T&& x) : next(NULL), value(std::move(x)) { }
+#endif
+
+    Node* next;
+    T value;
+  };
+
+  void push(Node* node)
+  {
+    Node* prev = __atomic_exchange_n(&head_, node, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+  }
+
+  Node* head_;  // written by producers
+  char pad_[64 - sizeof(Node*)];  // keep head_ and tail_ in different cache lines
+  Node* tail_;  // owned by consumer
+};
+
+}
+
+#endif  // MUDUO_BASE_MPSCQUEUE_H
@@ -32,7 +32,8 @@ Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reusepor
       acceptChannel_(loop, acceptSocket_.fd()),
       // 记录：套接字acceptSocket_(其内部成员变量：sockfd_)，未处于监听状态
       listenning_(false),
-      idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC))
+      idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC)),
+      acceptBudget_(kDefaultAcceptBudget)
 {
     assert(idleFd_ >= 0);
     acceptSocket_.setReuseAddr(true);
@@ -101,42 +102,69 @@ void Acceptor::handleRead()
     // 确保：执行事件循环（EventLoop::loop()）的线程，是IO线程
     // 即：确保，执行void Acceptor::handleRead()函数的线程，是IO线程
     loop_->assertInLoopThread();
-    // 用于存放服务端进程，获取到的客户端的IP地址和端口号
-    InetAddress peerAddr;
-    //FIXME loop until no more
-    /// 服务端进程，调用accept函数从处于监听状态的套接字acceptSocket_(其内部成员变量：sockfd_)的客户端进程连接请求队列中取出排在最前面的一个客户连接请求，
-    /// 并且服务端进程，会创建一个新的套接字，来与客户端进程的套接字，创建连接通道
-    /// 服务端进程，获取到的客户端的socket地址（IP地址和端口号），将被存放到peeraddr中
-    /// connfd，存放服务端进程新创建的套接字的socket文件描述符
-    int connfd = acceptSocket_.accept(&peerAddr);
-    if (connfd >= 0)
+    // 一次可读事件中，循环accept，直到连接请求队列取空（EAGAIN），或者用完acceptBudget_
+    batch_.clear();
+    while (static_cast<int>(batch_.size()) < acceptBudget_)
     {
-        // string hostport = peerAddr.toIpPort();
-        // LOG_TRACE << "Accepts of " << hostport;
-        if (newConnectionCallback_)
+        // 用于存放服务端进程，获取到的客户端的IP地址和端口号
+        InetAddress peerAddr;
+        /// 服务端进程，调用accept函数从处于监听状态的套接字acceptSocket_(其内部成员变量：sockfd_)的客户端进程连接请求队列中取出排在最前面的一个客户连接请求，
+        /// 并且服务端进程，会创建一个新的套接字，来与客户端进程的套接字，创建连接通道
+        /// 服务端进程，获取到的客户端的socket地址（IP地址和端口号），将被存放到peeraddr中
+        /// connfd，存放服务端进程新创建的套接字的socket文件描述符
+        int connfd = acceptSocket_.accept(&peerAddr);
+        if (connfd >= 0)
         {
-            // 执行新连接回调函数
-            // 实际执行的是：TcpServer.cc中的void TcpServer::newConnection函数
-            // 实现服务端进程，对客户端进程发来的新的连接请求的处理
-            newConnectionCallback_(connfd, peerAddr);
+            // string hostport = peerAddr.toIpPort();
+            // LOG_TRACE << "Accepts of " << hostport;
+            batch_.push_back(AcceptedConnection(connfd, peerAddr));
         }
         else
         {
-            sockets::close(connfd);
+            int savedErrno = errno;
+            // EAGAIN：连接请求队列已经取空了
+            if (savedErrno != EAGAIN)
+            {
+                LOG_SYSERR << "in Acceptor::handleRead";
+            }
+            // Read the section named "The special problem of
+            // accept()ing when you can't" in libev's doc.
+            // By Marc Lehmann, author of libev.
+            if (savedErrno == EMFILE)
+            {
+                ::close(idleFd_);
+                idleFd_ = ::accept(acceptSocket_.fd(), NULL, NULL);
+                ::close(idleFd_);
+                idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+            }
+            break;
         }
     }
+
+    if (batch_.empty())
+    {
+        return;
+    }
+    if (newConnectionBatchCallback_)
+    {
+        // 实际执行的是：TcpServer.cc中的void TcpServer::newConnections函数
+        // 一批连接一起交给TcpServer，每个IO线程只需要唤醒一次
+        newConnectionBatchCallback_(batch_);
+    }
     else
     {
-        LOG_SYSERR << "in Acceptor::handleRead";
-        // Read the section named "The special problem of
-        // accept()ing when you can't" in libev's doc.
-        // By Marc Lehmann, author of libev.
-        if (errno == EMFILE)
+        for (size_t i = 0; i < batch_.size(); ++i)
         {
-            ::close(idleFd_);
-            idleFd_ = ::accept(acceptSocket_.fd(), NULL, NULL);
-            ::close(idleFd_);
-            idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+            if (newConnectionCallback_)
+            {
+                // 执行新连接回调函数
+                // 实现服务端进程，对客户端进程发来的新的连接请求的处理
+                newConnectionCallback_(batch_[i].first, batch_[i].second);
+            }
+            else
+            {
+                sockets::close(batch_[i].first);
+            }
         }
     }
 }
@@ -11,10 +11,14 @@
 #ifndef MUDUO_NET_ACCEPTOR_H
 #define MUDUO_NET_ACCEPTOR_H
 
+#include <utility>
+#include <vector>
+
 #include <boost/function.hpp>
 #include <boost/noncopyable.hpp>
 
 #include <muduo/net/Channel.h>
+#include <muduo/net/InetAddress.h>
 #include <muduo/net/Socket.h>
 
 namespace muduo
@@ -23,7 +27,6 @@ namespace muduo
     {
 
         class EventLoop;
-        class InetAddress;
 
         ///
         /// Acceptor of incoming TCP connections.
@@ -37,6 +40,10 @@ namespace muduo
         public:
             typedef boost::function<void (int sockfd,
                                           const InetAddress &)> NewConnectionCallback;
+            // 一次可读事件中accept的一批连接：socket文件描述符，客户端的地址
+            typedef std::pair<int, InetAddress> AcceptedConnection;
+            typedef std::vector<AcceptedConnection> ConnectionBatch;
+            typedef boost::function<void (const ConnectionBatch &)> NewConnectionBatchCallback;
 
             Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reuseport);
             ~Acceptor();
@@ -48,6 +55,21 @@ namespace muduo
             {
                 newConnectionCallback_ = cb;
             }
+            // 设置了这个回调函数时，一次可读事件中accept的连接，一次交给它，不再调用newConnectionCallback_
+            void setNewConnectionBatchCallback(const NewConnectionBatchCallback &cb)
+            {
+                newConnectionBatchCallback_ = cb;
+            }
+
+            // 一次可读事件中，最多accept几个连接，连接请求队列取空（EAGAIN）时提前结束
+            // 连接风暴（例如发布之后客户端一起重连）时，不必每个连接都回到poll一次，
+            // 剩下的连接，监听套接字仍然可读，下一轮事件循环再accept
+            static const int kDefaultAcceptBudget = 16;
+            void setAcceptBudget(int budget)
+            {
+                assert(budget > 0);
+                acceptBudget_ = budget;
+            }
 
             // 获取：套接字acceptSocket_(其内部成员变量：sockfd_)，是否处于监听状态
             bool listenning() const
@@ -58,6 +80,12 @@ namespace muduo
             // 服务端进程，开始监听服务端socket -- acceptSocket_
             void listen();
 
+            // SO_REUSEPORT的多个监听套接字中，内核优先把cpu这个CPU收到的连接交给这个套接字，见Socket::setIncomingCpu()
+            void setIncomingCpu(int cpu)
+            {
+                acceptSocket_.setIncomingCpu(cpu);
+            }
+
         private:
             // 套接字acceptSocket_(其内部成员变量：sockfd_)，上有可读事件发生时，
             // 读事件的事件处理函数为Acceptor::handleRead
@@ -88,6 +116,10 @@ namespace muduo
             // 记录：套接字acceptSocket_(其内部成员变量：sockfd_)，是否处于监听状态
             bool listenning_;
             int idleFd_;
+            int acceptBudget_;
+            NewConnectionBatchCallback newConnectionBatchCallback_;
+            // 一次可读事件中accept的连接，复用，不必每次分配内存
+            ConnectionBatch batch_;
         };
     }
 }
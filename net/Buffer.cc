@@ -12,20 +12,166 @@
 #include <muduo/net/SocketsOps.h>
 
 #include <errno.h>
+#include <stdlib.h>
 #include <sys/uio.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__))
+#define MUDUO_HAVE_AVX2_KERNEL 1
+#include <immintrin.h>
+#endif
+
 using namespace muduo;
 using namespace muduo::net;
 
 const char Buffer::kCRLF[] = "\r\n";
+const char Buffer::kCRLFCRLF[] = "\r\n\r\n";
 
 const size_t Buffer::kCheapPrepend;
 const size_t Buffer::kInitialSize;
+const size_t Buffer::kExtraBufSize;
+
+namespace
+{
+
+typedef const char* (*SearchFunc)(const char* begin, const char* end,
+                                  const char* needle, size_t len);
+
+const char* searchScalar(const char* begin, const char* end,
+                         const char* needle, size_t len)
+{
+  while (static_cast<size_t>(end - begin) >= len)
+  {
+    const void* first = memchr(begin, needle[0], end - begin - len + 1);
+    if (first == NULL)
+    {
+      return NULL;
+    }
+    const char* p = static_cast<const char*>(first);
+    if (memcmp(p + 1, needle + 1, len - 1) == 0)
+    {
+      return p;
+    }
+    begin = p + 1;
+  }
+  return NULL;
+}
+
+// The SIMD kernels test 16 or 32 candidate positions at once,
+// by matching the first and the last byte of needle,
+// only the candidates passing both are compared in full.
+// Needles of one byte go to memchr(3), which is vectorized in libc already.
+
+#if defined(__SSE2__)
+const char* searchSSE2(const char* begin, const char* end,
+                       const char* needle, size_t len)
+{
+  const __m128i first = _mm_set1_epi8(needle[0]);
+  const __m128i last = _mm_set1_epi8(needle[len-1]);
+  const char* p = begin;
+  while (static_cast<size_t>(end - p) >= 16 + len - 1)
+  {
+    const __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    const __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + len - 1));
+    const __m128i eq = _mm_and_si128(_mm_cmpeq_epi8(first, blockFirst),
+                                     _mm_cmpeq_epi8(last, blockLast));
+    unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(eq));
+    while (mask != 0)
+    {
+      const int bit = __builtin_ctz(mask);
+      if (len <= 2 || memcmp(p + bit + 1, needle + 1, len - 2) == 0)
+      {
+        return p + bit;
+      }
+      mask &= mask - 1;
+    }
+    p += 16;
+  }
+  return searchScalar(p, end, needle, len);
+}
+#endif
+
+#ifdef MUDUO_HAVE_AVX2_KERNEL
+__attribute__((target("avx2")))
+const char* searchAVX2(const char* begin, const char* end,
+                       const char* needle, size_t len)
+{
+  const __m256i first = _mm256_set1_epi8(needle[0]);
+  const __m256i last = _mm256_set1_epi8(needle[len-1]);
+  const char* p = begin;
+  while (static_cast<size_t>(end - p) >= 32 + len - 1)
+  {
+    const __m256i blockFirst = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    const __m256i blockLast = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + len - 1));
+    const __m256i eq = _mm256_and_si256(_mm256_cmpeq_epi8(first, blockFirst),
+                                        _mm256_cmpeq_epi8(last, blockLast));
+    unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(eq));
+    while (mask != 0)
+    {
+      const int bit = __builtin_ctz(mask);
+      if (len <= 2 || memcmp(p + bit + 1, needle + 1, len - 2) == 0)
+      {
+        return p + bit;
+      }
+      mask &= mask - 1;
+    }
+    p += 32;
+  }
+  return searchScalar(p, end, needle, len);
+}
+#endif
+
+SearchFunc chooseSearch()
+{
+  if (::getenv("MUDUO_NO_SIMD"))
+  {
+    return searchScalar;
+  }
+#ifdef MUDUO_HAVE_AVX2_KERNEL
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && !::getenv("MUDUO_NO_AVX2"))
+  {
+    return searchAVX2;
+  }
+#endif
+#if defined(__SSE2__)
+  return searchSSE2;
+#else
+  return searchScalar;
+#endif
+}
+
+}
+
+const char* Buffer::search(const char* begin, const char* end,
+                           const char* needle, size_t len)
+{
+  assert(begin <= end);
+  if (len == 0)
+  {
+    // an empty needle matches at begin, like std::search
+    return begin;
+  }
+  if (len == 1)
+  {
+    return static_cast<const char*>(memchr(begin, needle[0], end - begin));
+  }
+  if (static_cast<size_t>(end - begin) < len)
+  {
+    return NULL;
+  }
+  // local static, so it works during static initialization of other files.
+  static const SearchFunc searchFunc = chooseSearch();
+  return searchFunc(begin, end, needle, len);
+}
 
 ssize_t Buffer::readFd(int fd, int* savedErrno)
 {
   // saved an ioctl()/FIONREAD call to tell how much to read
-  char extrabuf[65536];
+  char extrabuf[kExtraBufSize];
   struct iovec vec[2];
   const size_t writable = writableBytes();
   vec[0].iov_base = begin()+writerIndex_;
@@ -49,10 +195,8 @@ ssize_t Buffer::readFd(int fd, int* savedErrno)
     writerIndex_ = buffer_.size();
     append(extrabuf, n - writable);
   }
-  // if (n == writable + sizeof extrabuf)
-  // {
-  //   goto line_30;
-  // }
+  // TcpConnection reads again if (n == writable + sizeof extrabuf),
+  // according to its ReadPolicy.
   return n;
 }
 
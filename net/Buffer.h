@@ -44,6 +44,8 @@ class Buffer : public muduo::copyable
  public:
   static const size_t kCheapPrepend = 8;
   static const size_t kInitialSize = 1024;
+  // stack space readFd() uses when this buffer is not large enough.
+  static const size_t kExtraBufSize = 65536;
 
   explicit Buffer(size_t initialSize = kInitialSize)
     : buffer_(kCheapPrepend + initialSize),
@@ -79,18 +81,40 @@ class Buffer : public muduo::copyable
 
   const char* findCRLF() const
   {
-    // FIXME: replace with memmem()?
-    const char* crlf = std::search(peek(), beginWrite(), kCRLF, kCRLF+2);
-    return crlf == beginWrite() ? NULL : crlf;
+    return search(peek(), beginWrite(), kCRLF, 2);
   }
 
   const char* findCRLF(const char* start) const
   {
     assert(peek() <= start);
     assert(start <= beginWrite());
-    // FIXME: replace with memmem()?
-    const char* crlf = std::search(start, beginWrite(), kCRLF, kCRLF+2);
-    return crlf == beginWrite() ? NULL : crlf;
+    return search(start, beginWrite(), kCRLF, 2);
+  }
+
+  /// End of HTTP headers.
+  const char* findCRLFCRLF() const
+  {
+    return search(peek(), beginWrite(), kCRLFCRLF, 4);
+  }
+
+  const char* findCRLFCRLF(const char* start) const
+  {
+    assert(peek() <= start);
+    assert(start <= beginWrite());
+    return search(start, beginWrite(), kCRLFCRLF, 4);
+  }
+
+  /// Finds an arbitrary delimiter, usually one or two bytes.
+  const char* find(const StringPiece& delim) const
+  {
+    return search(peek(), beginWrite(), delim.data(), delim.size());
+  }
+
+  const char* find(const char* start, const StringPiece& delim) const
+  {
+    assert(peek() <= start);
+    assert(start <= beginWrite());
+    return search(start, beginWrite(), delim.data(), delim.size());
   }
 
   const char* findEOL() const
@@ -413,7 +437,14 @@ class Buffer : public muduo::copyable
   size_t readerIndex_;
   size_t writerIndex_;
 
+  // Searches [begin, end) for needle with SSE2 or AVX2, chosen at runtime,
+  // returns NULL if not found, begin if needle is empty.
+  // Set MUDUO_NO_AVX2 or MUDUO_NO_SIMD in environment to use narrower kernels.
+  static const char* search(const char* begin, const char* end,
+                            const char* needle, size_t len);
+
   static const char kCRLF[];
+  static const char kCRLFCRLF[];
 };
 
 }
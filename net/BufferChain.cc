@@ -0,0 +1,268 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+
+#include <muduo/net/BufferChain.h>
+
+#include <muduo/base/Logging.h>
+#include <muduo/net/BufferPool.h>
+#include <muduo/net/SocketsOps.h>
+
+#include <errno.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const size_t BufferChain::kChunkSize;
+const int BufferChain::kMaxIovecs;
+
+BufferChain::BufferChain()
+  : readableBytes_(0),
+    pool_(NULL)
+{
+}
+
+BufferChain::~BufferChain()
+{
+}
+
+void BufferChain::setBufferPool(BufferPool* pool)
+{
+  if (pool_ && pool_ != pool)
+  {
+    for (std::deque<Chunk>::iterator it = chunks_.begin(); it != chunks_.end(); ++it)
+    {
+      if (it->pooled)
+      {
+        assert(pool);
+        pool_->transfer(it->buffer, pool);
+      }
+    }
+  }
+  pool_ = pool;
+}
+
+void BufferChain::append(const char* /*restrict*/ data, size_t len)
+{
+  if (len == 0)
+  {
+    return;
+  }
+  // fill the tail chunk first, never let it grow, so no realloc nor memmove.
+  if (!chunks_.empty() && chunks_.back().buffer)
+  {
+    Buffer* tail = get_pointer(chunks_.back().buffer);
+    size_t n = std::min(len, tail->writableBytes());
+    tail->append(data, n);
+    readableBytes_ += n;
+    data += n;
+    len -= n;
+  }
+
+  if (len > 0)
+  {
+    Chunk chunk;
+    size_t size = std::max(len, kChunkSize);
+    if (pool_)
+    {
+      chunk.buffer = pool_->acquire(size);
+      chunk.pooled = true;
+    }
+    else
+    {
+      chunk.buffer.reset(new Buffer(size));
+    }
+    chunk.buffer->append(data, len);
+    chunks_.push_back(chunk);
+    readableBytes_ += len;
+  }
+}
+
+void BufferChain::append(Buffer* buf)
+{
+  size_t len = buf->readableBytes();
+  if (len == 0)
+  {
+    return;
+  }
+  Chunk chunk;
+  if (pool_)
+  {
+    // trade buf's storage for a pooled one of about the same capacity,
+    // it is released to the pool once written out.
+    size_t capacity = buf->internalCapacity() - Buffer::kCheapPrepend;
+    chunk.buffer = pool_->acquire(
+        std::min(capacity, BufferPool::kClassSizes[BufferPool::kNumClasses - 1]));
+    chunk.pooled = true;
+  }
+  else
+  {
+    chunk.buffer.reset(new Buffer(0));
+  }
+  chunk.buffer->swap(*buf);
+  chunks_.push_back(chunk);
+  readableBytes_ += len;
+}
+
+void BufferChain::append(const BufferPtr& buf)
+{
+  append(buf->peek(), buf->readableBytes(), buf);
+}
+
+void BufferChain::append(const char* data, size_t len, const boost::shared_ptr<void>& owner)
+{
+  if (len == 0)
+  {
+    return;
+  }
+  Chunk chunk;
+  chunk.data = data;
+  chunk.len = len;
+  chunk.owner = owner;
+  chunks_.push_back(chunk);
+  readableBytes_ += len;
+}
+
+void BufferChain::appendFile(int fd, off_t offset, size_t len, const boost::shared_ptr<void>& owner)
+{
+  assert(fd >= 0);
+  if (len == 0)
+  {
+    return;
+  }
+  Chunk chunk;
+  chunk.len = len;
+  chunk.fd = fd;
+  chunk.offset = offset;
+  chunk.owner = owner;
+  chunks_.push_back(chunk);
+  readableBytes_ += len;
+}
+
+void BufferChain::retrieve(size_t len)
+{
+  assert(len <= readableBytes_);
+  readableBytes_ -= len;
+  while (len > 0)
+  {
+    assert(!chunks_.empty());
+    Chunk& front = chunks_.front();
+    size_t readable = front.readableBytes();
+    if (len < readable)
+    {
+      if (front.buffer)
+      {
+        front.buffer->retrieve(len);
+      }
+      else if (front.isFile())
+      {
+        front.offset += static_cast<off_t>(len);
+        front.len -= len;
+      }
+      else
+      {
+        front.data += len;
+        front.len -= len;
+      }
+      len = 0;
+    }
+    else
+    {
+      len -= readable;
+      popFront();
+    }
+  }
+}
+
+void BufferChain::retrieveAll()
+{
+  while (!chunks_.empty())
+  {
+    popFront();
+  }
+  readableBytes_ = 0;
+}
+
+void BufferChain::popFront()
+{
+  Chunk& front = chunks_.front();
+  if (front.pooled)
+  {
+    assert(pool_);
+    pool_->release(&front.buffer);
+  }
+  chunks_.pop_front();
+}
+
+ssize_t BufferChain::writeFd(int fd, int* savedErrno)
+{
+  if (!chunks_.empty() && chunks_.front().isFile())
+  {
+    return writeFile(fd, savedErrno);
+  }
+
+  // stop at the first file chunk, it goes with the next call.
+  struct iovec vec[kMaxIovecs];
+  int iovcnt = 0;
+  for (std::deque<Chunk>::const_iterator it = chunks_.begin();
+       it != chunks_.end() && !it->isFile() && iovcnt < kMaxIovecs;
+       ++it)
+  {
+    vec[iovcnt].iov_base = const_cast<char*>(it->peek());
+    vec[iovcnt].iov_len = it->readableBytes();
+    ++iovcnt;
+  }
+  const ssize_t n = sockets::writev(fd, vec, iovcnt);
+  if (n < 0)
+  {
+    *savedErrno = errno;
+  }
+  else
+  {
+    retrieve(implicit_cast<size_t>(n));
+  }
+  return n;
+}
+
+ssize_t BufferChain::writeFile(int fd, int* savedErrno)
+{
+  Chunk& front = chunks_.front();
+  off_t offset = front.offset;
+  ssize_t n = sockets::sendfile(fd, front.fd, &offset, front.len);
+  if (n < 0 && (errno == EINVAL || errno == ENOSYS))
+  {
+    // fd does not support mmap-like operations, copy through user space.
+    char buf[65536];
+    n = ::pread(front.fd, buf, std::min(sizeof buf, front.len), front.offset);
+    if (n > 0)
+    {
+      n = sockets::write(fd, buf, implicit_cast<size_t>(n));
+    }
+  }
+
+  if (n > 0)
+  {
+    retrieve(implicit_cast<size_t>(n));
+  }
+  else if (n == 0)
+  {
+    // the file is shorter than promised, drop the rest of it.
+    LOG_ERROR << "BufferChain::writeFile unexpected end of file, fd = " << front.fd;
+    readableBytes_ -= front.len;
+    popFront();
+    *savedErrno = EIO;
+    n = -1;
+  }
+  else
+  {
+    *savedErrno = errno;
+  }
+  return n;
+}
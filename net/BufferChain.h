@@ -0,0 +1,162 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_BUFFERCHAIN_H
+#define MUDUO_NET_BUFFERCHAIN_H
+
+#include <muduo/base/StringPiece.h>
+#include <muduo/base/Types.h>
+#include <muduo/net/Buffer.h>
+#include <muduo/net/Callbacks.h>
+
+#include <deque>
+#include <sys/types.h>  // off_t
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace muduo
+{
+namespace net
+{
+
+class BufferPool;
+
+/// A queue of output chunks, flushed with writev(2).
+///
+/// Small pieces are copied into a private tail chunk.
+/// Buffers handed over by the caller are queued as they are, without copying.
+/// File regions are queued by descriptor and sent with sendfile(2).
+///
+/// @code
+/// +----------------+----------------+---------------+----------------+
+/// | private chunk  |  shared chunk  |  file chunk   |  owned chunk   |
+/// | (copied bytes) | (BufferPtr)    | (fd + offset) | (data + owner) |
+/// +----------------+----------------+---------------+----------------+
+/// ^ front, next byte to write                       back, appendable ^
+/// @endcode
+class BufferChain : boost::noncopyable
+{
+ public:
+  static const size_t kChunkSize = 4096;
+  static const int kMaxIovecs = 64;
+
+  BufferChain();
+  ~BufferChain();
+
+  /// Private chunks are leased from pool and given back once written out,
+  /// so are buffers handed over with append(Buffer*).
+  /// Must be used in the loop thread of pool then,
+  /// except for the destructor, which never touches the pool.
+  /// Chunks leased from the previous pool are transferred to pool,
+  /// call it in the loop thread of the previous pool.
+  void setBufferPool(BufferPool* pool);
+
+  size_t readableBytes() const
+  { return readableBytes_; }
+
+  size_t numChunks() const
+  { return chunks_.size(); }
+
+  bool empty() const
+  { return chunks_.empty(); }
+
+  /// Copies data into the tail chunk.
+  void append(const StringPiece& str)
+  {
+    append(str.data(), str.size());
+  }
+
+  void append(const void* /*restrict*/ data, size_t len)
+  {
+    append(static_cast<const char*>(data), len);
+  }
+
+  void append(const char* /*restrict*/ data, size_t len);
+
+  /// Takes over the content of buf by swapping, no copy.
+  /// buf is left empty, with a pooled buffer of about the same
+  /// capacity if there is a pool, so the caller keeps its capacity.
+  void append(Buffer* buf);
+
+  /// Queues readable bytes of buf, no copy.
+  /// buf is shared with the caller, who must not modify it afterwards,
+  /// so it can be sent to many connections at once.
+  void append(const BufferPtr& buf);
+
+  /// Queues caller-owned memory, no copy.
+  /// owner keeps [data, data+len) alive until it is written out.
+  void append(const char* data, size_t len, const boost::shared_ptr<void>& owner);
+
+  /// Queues [offset, offset+len) of a regular file, no copy.
+  /// owner keeps fd open until it is written out.
+  void appendFile(int fd, off_t offset, size_t len, const boost::shared_ptr<void>& owner);
+
+  void retrieve(size_t len);
+  void retrieveAll();
+
+  /// Writes queued chunks with a single writev(2),
+  /// or a file chunk at front with sendfile(2).
+  ///
+  /// @return result of writev(2), @c errno is saved
+  ssize_t writeFd(int fd, int* savedErrno);
+
+  /// Swaps queued chunks, the buffer pools stay.
+  void swap(BufferChain& rhs)
+  {
+    chunks_.swap(rhs.chunks_);
+    std::swap(readableBytes_, rhs.readableBytes_);
+  }
+
+ private:
+  struct Chunk
+  {
+    Chunk()
+      : data(NULL),
+        len(0),
+        fd(-1),
+        offset(0),
+        pooled(false)
+    {
+    }
+
+    bool isFile() const
+    { return fd >= 0; }
+
+    const char* peek() const
+    { return buffer ? buffer->peek() : data; }
+
+    size_t readableBytes() const
+    { return buffer ? buffer->readableBytes() : len; }
+
+    // private bytes, consumed in place, NULL for a borrowed chunk.
+    BufferPtr buffer;
+    // borrowed bytes, used when buffer is NULL.
+    const char* data;
+    size_t len;
+    // file region, used when fd >= 0, len is the remaining bytes.
+    int fd;
+    off_t offset;
+    boost::shared_ptr<void> owner;
+    // buffer was acquired from pool_, and goes back there.
+    bool pooled;
+  };
+
+  ssize_t writeFile(int fd, int* savedErrno);
+  void popFront();
+
+  std::deque<Chunk> chunks_;
+  size_t readableBytes_;
+  BufferPool* pool_;
+};
+
+}
+}
+
+#endif  // MUDUO_NET_BUFFERCHAIN_H
@@ -0,0 +1,132 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+
+#include <muduo/net/BufferPool.h>
+
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const size_t BufferPool::kClassSizes[kNumClasses] = { 1024, 4096, 16384, 65536 };
+const int BufferPool::kNumClasses;
+const size_t BufferPool::kDefaultMaxCachedBytes;
+const size_t BufferPool::kScratchSize;
+
+BufferPool::BufferPool(size_t maxCachedBytes)
+  : maxCachedBytes_(maxCachedBytes)
+{
+}
+
+BufferPool::~BufferPool()
+{
+}
+
+// smallest class holding size bytes, kNumClasses if none.
+int BufferPool::classOf(size_t size)
+{
+  int i = 0;
+  while (i < kNumClasses && kClassSizes[i] < size)
+  {
+    ++i;
+  }
+  return i;
+}
+
+BufferPtr BufferPool::acquire(size_t size)
+{
+  acquired_.increment();
+  int i = classOf(size);
+  if (i == kNumClasses)
+  {
+    allocated_.increment();
+    return BufferPtr(new Buffer(size));
+  }
+
+  if (free_[i].empty())
+  {
+    allocated_.increment();
+    return BufferPtr(new Buffer(kClassSizes[i]));
+  }
+
+  BufferPtr buf;
+  buf.swap(free_[i].back());
+  free_[i].pop_back();
+  cached_[i].decrement();
+  cachedBytes_.add(-static_cast<int64_t>(kClassSizes[i]));
+  assert(buf->readableBytes() == 0);
+  assert(buf->writableBytes() >= size);
+  return buf;
+}
+
+void BufferPool::release(BufferPtr* buf)
+{
+  assert(*buf);
+  released_.increment();
+  if (!buf->unique())
+  {
+    // someone else still reads it.
+    buf->reset();
+    dropped_.increment();
+    return;
+  }
+
+  (*buf)->retrieveAll();
+  size_t capacity = (*buf)->writableBytes();
+  // largest class fitting in capacity, but do not keep a grown buffer
+  // in a much smaller class.
+  int i = classOf(capacity + 1) - 1;
+  if (i >= 0
+      && capacity <= 2 * kClassSizes[i]
+      && cachedBytes_.get() + static_cast<int64_t>(kClassSizes[i])
+         <= static_cast<int64_t>(maxCachedBytes_))
+  {
+    free_[i].push_back(BufferPtr());
+    free_[i].back().swap(*buf);
+    cached_[i].increment();
+    cachedBytes_.add(static_cast<int64_t>(kClassSizes[i]));
+  }
+  else
+  {
+    buf->reset();
+    dropped_.increment();
+  }
+}
+
+void BufferPool::transfer(const BufferPtr& buf, BufferPool* to)
+{
+  assert(buf);
+  assert(to != this);
+  released_.increment();
+  to->acquired_.increment();
+}
+
+string BufferPool::stats() const
+{
+  string result;
+  char buf[256];
+  snprintf(buf, sizeof buf,
+           "leased %lld acquired %lld allocated %lld released %lld dropped %lld "
+           "scratch_taken %lld cached_bytes %lld\n",
+           static_cast<long long>(leased()),
+           static_cast<long long>(acquired_.get()),
+           static_cast<long long>(allocated_.get()),
+           static_cast<long long>(released_.get()),
+           static_cast<long long>(dropped_.get()),
+           static_cast<long long>(taken_.get()),
+           static_cast<long long>(cachedBytes_.get()));
+  result += buf;
+  for (int i = 0; i < kNumClasses; ++i)
+  {
+    snprintf(buf, sizeof buf, "class %zu cached %lld\n",
+             kClassSizes[i], static_cast<long long>(cached_[i].get()));
+    result += buf;
+  }
+  return result;
+}
@@ -0,0 +1,110 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_BUFFERPOOL_H
+#define MUDUO_NET_BUFFERPOOL_H
+
+#include <muduo/base/Atomic.h>
+#include <muduo/base/Types.h>
+#include <muduo/net/Buffer.h>
+#include <muduo/net/Callbacks.h>
+
+#include <vector>
+#include <boost/noncopyable.hpp>
+
+namespace muduo
+{
+namespace net
+{
+
+///
+/// Size-classed free lists of Buffer, one per EventLoop.
+///
+/// Connections lease buffers on demand and give them back once drained,
+/// so idle connections hold no buffer memory, and busy ones reuse
+/// buffers of the same few sizes instead of fragmenting the heap.
+///
+/// Not thread safe, must be used in the loop thread.
+/// Statistics can be read from any thread.
+class BufferPool : boost::noncopyable
+{
+ public:
+  static const int kNumClasses = 4;
+  static const size_t kClassSizes[kNumClasses];  // 1k, 4k, 16k, 64k
+  static const size_t kDefaultMaxCachedBytes = 4 * 1024 * 1024;
+  static const size_t kScratchSize = 65536;
+
+  explicit BufferPool(size_t maxCachedBytes = kDefaultMaxCachedBytes);
+  ~BufferPool();
+
+  /// Returns an empty buffer with at least size writable bytes.
+  BufferPtr acquire(size_t size = Buffer::kInitialSize);
+
+  /// Gives buf back to the pool, buf is reset.
+  /// The buffer is freed if it is shared, oversized or the pool is full.
+  void release(BufferPtr* buf);
+
+  /// Moves a leased buf to pool to, which it is released to later,
+  /// when its connection moves to another loop.  Only touches statistics,
+  /// so it may be called from the loop thread of either pool.
+  void transfer(const BufferPtr& buf, BufferPool* to);
+
+  /// A loop-wide buffer to read into, shared by connections
+  /// which have no pending input.  Must be left empty after use,
+  /// or taken over with takeScratch().
+  const BufferPtr& scratch()
+  {
+    if (!scratch_)
+    {
+      scratch_ = acquire(kScratchSize);
+    }
+    return scratch_;
+  }
+
+  /// Hands the scratch buffer over to the caller,
+  /// a new one is acquired on next use.
+  BufferPtr takeScratch()
+  {
+    BufferPtr buf;
+    buf.swap(scratch_);
+    taken_.increment();
+    return buf;
+  }
+
+  /// Number of buffers acquired and not released yet.
+  int64_t leased() const
+  { return acquired_.get() - released_.get(); }
+
+  int64_t cachedBytes() const
+  { return cachedBytes_.get(); }
+
+  /// Human readable statistics, one line per size class.
+  string stats() const;
+
+ private:
+  static int classOf(size_t size);
+
+  const size_t maxCachedBytes_;
+  BufferPtr scratch_;
+  std::vector<BufferPtr> free_[kNumClasses];
+  // written in loop thread, read by anyone.
+  mutable AtomicInt64 cached_[kNumClasses];
+  mutable AtomicInt64 cachedBytes_;
+  mutable AtomicInt64 acquired_;
+  mutable AtomicInt64 allocated_;
+  mutable AtomicInt64 released_;
+  mutable AtomicInt64 dropped_;
+  mutable AtomicInt64 taken_;
+};
+
+}
+}
+
+#endif  // MUDUO_NET_BUFFERPOOL_H
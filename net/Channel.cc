@@ -36,7 +36,9 @@ Channel::Channel(EventLoop *loop, int fd__)
       logHup_(true),
       tied_(false),
       eventHandling_(false),
-      addedToLoop_(false)
+      addedToLoop_(false),
+      edgeTriggered_(false),
+      readyEvents_(0)
 {
 }
 
@@ -56,6 +58,42 @@ void Channel::tie(const boost::shared_ptr<void> &obj)
     tied_ = true;
 }
 
+void Channel::setEdgeTriggered(bool on)
+{
+    edgeTriggered_ = on;
+    if (addedToLoop_ && !isNoneEvent())
+    {
+        update();
+    }
+}
+
+void Channel::markReadReady()
+{
+    if (readyEvents_ == 0)
+    {
+        loop_->addReadyChannel(this);
+    }
+    readyEvents_ |= POLLIN;
+}
+
+void Channel::markWriteReady()
+{
+    if (readyEvents_ == 0)
+    {
+        loop_->addReadyChannel(this);
+    }
+    readyEvents_ |= POLLOUT;
+}
+
+bool Channel::mergeReadyEvents()
+{
+    // 放入就绪链表之后，可能已经disableReading/disableWriting了
+    int ready = readyEvents_ & events_;
+    readyEvents_ = 0;
+    revents_ |= ready;
+    return ready != 0;
+}
+
 /// ====================================================================================================
 /// 在，class PollPoller IO复用的封装：封装了poll，中的功能
 /// ====================================================================================================
@@ -293,6 +293,30 @@ namespace muduo
                 return events_ & kReadEvent;
             }
 
+            /// 边沿触发：只有EPollPoller支持（EPOLLET），其他Poller仍然是水平触发
+            /// 边沿触发时，事件处理函数必须读（写）到EAGAIN为止，不然不会再有事件，
+            /// 为了公平，读写的数据量达到预算时，调用markReadReady/markWriteReady，
+            /// 由EventLoop在下一轮事件循环中，再次调用事件处理函数
+            void setEdgeTriggered(bool on);
+            bool isEdgeTriggered() const
+            {
+                return edgeTriggered_;
+            }
+
+            /// 还没有读到EAGAIN，下一轮事件循环时，不经过poll，再次处理可读事件
+            void markReadReady();
+            /// 还没有写到EAGAIN，下一轮事件循环时，不经过poll，再次处理可写事件
+            void markWriteReady();
+
+            // for EventLoop
+            /// 把就绪链表中记下的事件，并入revents_，已经不关注的事件丢弃
+            /// 返回false表示没有需要处理的事件
+            bool mergeReadyEvents();
+            bool isReady() const
+            {
+                return readyEvents_ != 0;
+            }
+
             // for Poller
             /// 获取：
             /// （1）class Channel类，所管理的文件描述符，对应的struct pollfd，
@@ -325,6 +349,16 @@ namespace muduo
                 return loop_;
             }
 
+            /// 把Channel交给另一个EventLoop，必须先remove()，从原来的Poller中删除
+            /// index_重置为-1，新的Poller会把它当作新的表项
+            /// 用于TcpConnection在IO线程之间迁移
+            void setOwnerLoop(EventLoop *loop)
+            {
+                assert(!addedToLoop_);
+                loop_ = loop;
+                index_ = -1;
+            }
+
             /// ====================================================================================================
             /// 在，class PollPoller IO复用的封装：封装了poll，中的功能
             /// ====================================================================================================
@@ -401,6 +435,9 @@ namespace muduo
             bool tied_;
             bool eventHandling_;
             bool addedToLoop_;
+            bool edgeTriggered_;
+            /// 就绪链表中的事件，不为0时，本Channel在EventLoop的就绪链表中
+            int readyEvents_;
 
             /// 存放：读事件的，事件回调函数
             ReadEventCallback readCallback_;
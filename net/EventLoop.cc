@@ -9,7 +9,7 @@
 #include <muduo/net/EventLoop.h>
 
 #include <muduo/base/Logging.h>
-#include <muduo/base/Mutex.h>
+#include <muduo/net/BufferPool.h>
 #include <muduo/net/Channel.h>
 #include <muduo/net/Poller.h>
 #include <muduo/net/SocketsOps.h>
@@ -17,6 +17,8 @@
 
 #include <boost/bind.hpp>
 
+#include <algorithm>
+
 #include <signal.h>
 #include <sys/eventfd.h>
 #include <unistd.h>
@@ -71,9 +73,12 @@ EventLoop::EventLoop()
       threadId_(CurrentThread::tid()),
       poller_(Poller::newDefaultPoller(this)),
       timerQueue_(new TimerQueue(this)),
+      bufferPool_(new BufferPool),
       wakeupFd_(createEventfd()),
       wakeupChannel_(new Channel(this, wakeupFd_)),
-      currentActiveChannel_(NULL)
+      currentActiveChannel_(NULL),
+      polling_(0),
+      busyPollUsec_(0)
 {
     LOG_DEBUG << "EventLoop created " << this << " in thread " << threadId_;
     /// 当前线程，已经创建了其他的EventLoop对象
@@ -142,6 +147,8 @@ void EventLoop::loop()
     quit_ = false;  // FIXME: what if someone calls quit() before loop() ?
     LOG_TRACE << "EventLoop " << this << " start looping";
 
+    /// 上一轮事件循环结束的时间，也就是这一轮开始poll的时间
+    Timestamp iterationEnd(Timestamp::now());
     while (!quit_)
     {
         activeChannels_.clear();
@@ -172,7 +179,28 @@ void EventLoop::loop()
         /// (2)遍历epoll的内核事件监听表epollfd_，从中找出有事件发生的fd，并将该fd所对应的表项的内容，
         ///   填入到，记录实际发生的事件的表activeChannels和记录实际发生的事件的表events_中保存
         /// (3)本质上，EPollPoller::poll这个函数，就是epoll_wait函数所做的事
-        pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+        /// 忙轮询模式下，先以0超时反复poll，在busyPollUsec_微秒内没有等到事件，才阻塞在poll中
+        if (busyPollUsec_ == 0 || !busyPoll())
+        {
+            /// 声明即将阻塞在poll中，然后再检查一次pendingFunctors_：
+            /// 这之后放入的回调函数，由放入者唤醒IO线程；这之前放入的，在这里看到，不阻塞
+            int timeoutMs = kPollTimeMs;
+            __atomic_store_n(&polling_, 1, __ATOMIC_RELAXED);
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            if (!pendingFunctors_.empty() || !readyChannels_.empty())
+            {
+                timeoutMs = 0;
+            }
+            pollReturnTime_ = poller_->poll(timeoutMs, &activeChannels_);
+            __atomic_store_n(&polling_, 0, __ATOMIC_RELAXED);
+            wakeupPending_.getAndSet(0);
+        }
+        eventsPerPoll_.add(static_cast<int64_t>(activeChannels_.size()));
+        pollWaitUsec_.add(pollReturnTime_.microSecondsSinceEpoch() - iterationEnd.microSecondsSinceEpoch());
+        if (!readyChannels_.empty())
+        {
+            collectReadyChannels();
+        }
         ++iteration_;
         if (Logger::logLevel() <= Logger::TRACE)
         {
@@ -199,12 +227,91 @@ void EventLoop::loop()
         eventHandling_ = false;
         /// 在IO线程中，执行延期执行的回调函数
         doPendingFunctors();
+        iterationEnd = Timestamp::now();
+        handlerUsec_.add(iterationEnd.microSecondsSinceEpoch() - pollReturnTime_.microSecondsSinceEpoch());
     }
 
     LOG_TRACE << "EventLoop " << this << " stop looping";
     looping_ = false;
 }
 
+int64_t EventLoop::syscallCount() const
+{
+    return poller_->syscallCount();
+}
+
+void EventLoop::collectReadyChannels()
+{
+    /// 本轮poll又返回了的channel，并入revents_，不重复放入activeChannels_
+    for (ChannelList::iterator it = activeChannels_.begin();
+            it != activeChannels_.end(); ++it)
+    {
+        if ((*it)->isReady())
+        {
+            (*it)->mergeReadyEvents();
+        }
+    }
+    ChannelList ready;
+    ready.swap(readyChannels_);
+    for (ChannelList::iterator it = ready.begin(); it != ready.end(); ++it)
+    {
+        Channel *channel = *it;
+        if (channel->isReady())
+        {
+            channel->set_revents(0);
+            if (channel->mergeReadyEvents())
+            {
+                activeChannels_.push_back(channel);
+                readyChannelCount_.increment();
+            }
+        }
+    }
+}
+
+/// 以0超时反复poll，直到有事件发生、有回调函数放入，或者超过busyPollUsec_微秒
+/// 返回值：true，等到了，activeChannels_中是发生的事件；false，没有等到，需要阻塞在poll中
+/// 期间polling_为0，放入回调函数的线程不写wakeupFd_
+bool EventLoop::busyPoll()
+{
+    int64_t deadline = Timestamp::now().microSecondsSinceEpoch() + busyPollUsec_;
+    int64_t polls = 0;
+    bool hit = false;
+    while (!hit)
+    {
+        pollReturnTime_ = poller_->poll(0, &activeChannels_);
+        ++polls;
+        hit = !activeChannels_.empty() || !pendingFunctors_.empty()
+              || !readyChannels_.empty() || quit_;
+        if (pollReturnTime_.microSecondsSinceEpoch() >= deadline)
+        {
+            break;
+        }
+    }
+    busyPollSpins_.increment();
+    busyPollPolls_.add(polls);
+    if (hit)
+    {
+        busyPollHits_.increment();
+    }
+    return hit;
+}
+
+void EventLoop::setBusyPollUsec(int usec)
+{
+    assertInLoopThread();
+    assert(usec >= 0);
+    busyPollUsec_ = usec;
+}
+
+EventLoop::BusyPollStats EventLoop::busyPollStats() const
+{
+    BusyPollStats stats;
+    stats.spins = busyPollSpins_.get();
+    stats.hits = busyPollHits_.get();
+    stats.polls = busyPollPolls_.get();
+    return stats;
+}
+
 void EventLoop::quit()
 {
     quit_ = true;
@@ -245,23 +352,29 @@ void EventLoop::runInLoop(const Functor &cb)
 /// 将需要在IO线程中执行的用户回调函数cb，放入到队列中保存，并在必要时唤醒IO线程，执行这个用户任务回调函数
 void EventLoop::queueInLoop(const Functor &cb)
 {
-    {
-        MutexLockGuard lock(mutex_);
-        /// pendingFunctors_用于存放：需要延期执行的用户任务回调：这些回调函数，都是需要在IO线程中执行的用户任务回调
-        pendingFunctors_.push_back(cb);
-    }
+    functorsQueued_.increment();
+    /// pendingFunctors_用于存放：需要延期执行的用户任务回调：这些回调函数，都是需要在IO线程中执行的用户任务回调
+    pendingFunctors_.put(cb);
+    wakeupIfPolling();
+}
 
-    if (!isInLoopThread() || callingPendingFunctors_)
+/// 只有IO线程可能阻塞在poll中时，才唤醒IO线程，并且多个线程同时放入回调函数时，只唤醒一次
+/// IO线程自己放入回调函数时，阻塞之前会再检查一次pendingFunctors_，不需要唤醒
+void EventLoop::wakeupIfPolling()
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&polling_, __ATOMIC_RELAXED)
+        && wakeupPending_.getAndSet(1) == 0)
     {
         /// 非IO线程执行此函数，向IO线程发送一个数据1，实现唤醒IO线程
         wakeup();
+        wakeups_.increment();
     }
 }
 
 size_t EventLoop::queueSize() const
 {
-    MutexLockGuard lock(mutex_);
-    return pendingFunctors_.size();
+    return static_cast<size_t>(functorsQueued_.get() - functorsRun_.get());
 }
 
 /// 函数参数含义：
@@ -308,6 +421,14 @@ TimerId EventLoop::runEvery(double interval, const TimerCallback &cb)
     return timerQueue_->addTimer(cb, time, interval);
 }
 
+/// 以当前时间Timestamp::now()为起点，经过delay到delay + slack之间的时间后，定时器超时
+/// 到期时间和其他定时器合并，少设置几次timerfd，少唤醒几次IO线程
+TimerId EventLoop::runAfterWithSlack(double delay, double slack, const TimerCallback &cb)
+{
+    Timestamp time(addTime(Timestamp::now(), delay));
+    return timerQueue_->addTimer(cb, time, 0.0, slack);
+}
+
 #ifdef __GXX_EXPERIMENTAL_CXX0X__
 // FIXME: remove duplication
 void EventLoop::runInLoop(Functor &&cb)
@@ -325,17 +446,10 @@ void EventLoop::runInLoop(Functor &&cb)
 /// 将需要在IO线程中执行的用户回调函数cb，放入到队列中保存，并在必要时唤醒IO线程，执行这个用户任务回调函数
 void EventLoop::queueInLoop(Functor &&cb)
 {
-    {
-        MutexLockGuard lock(mutex_);
-        /// pendingFunctors_用于存放：需要延期执行的用户任务回调：这些回调函数，都是需要在IO线程中执行的用户任务回调
-        pendingFunctors_.push_back(std::move(cb));  // emplace_back
-    }
-
-    if (!isInLoopThread() || callingPendingFunctors_)
-    {
-        /// 非IO线程执行此函数，向IO线程发送一个数据1，实现唤醒IO线程
-        wakeup();
-    }
+    functorsQueued_.increment();
+    /// pendingFunctors_用于存放：需要延期执行的用户任务回调：这些回调函数，都是需要在IO线程中执行的用户任务回调
+    pendingFunctors_.put(std::move(cb));
+    wakeupIfPolling();
 }
 
 /// 函数参数含义：
@@ -382,6 +496,12 @@ TimerId EventLoop::runEvery(double interval, TimerCallback &&cb)
     /// 也就是在，时间点Timestamp::now() + interval + interval处，定时器超时
     return timerQueue_->addTimer(std::move(cb), time, interval);
 }
+
+TimerId EventLoop::runAfterWithSlack(double delay, double slack, TimerCallback &&cb)
+{
+    Timestamp time(addTime(Timestamp::now(), delay));
+    return timerQueue_->addTimer(std::move(cb), time, 0.0, slack);
+}
 #endif
 
 void EventLoop::cancel(TimerId timerId)
@@ -389,6 +509,27 @@ void EventLoop::cancel(TimerId timerId)
     return timerQueue_->cancel(timerId);
 }
 
+void EventLoop::setTimingWheel(bool on)
+{
+    assertInLoopThread();
+    timerQueue_->setTimingWheel(on);
+}
+
+bool EventLoop::timingWheel() const
+{
+    return timerQueue_->timingWheel();
+}
+
+int64_t EventLoop::timerRearmCount() const
+{
+    return timerQueue_->rearmCount();
+}
+
+int64_t EventLoop::timerRearmsAvoided() const
+{
+    return timerQueue_->rearmsAvoided();
+}
+
 /// ====================================================================================================
 /// 在，class PollPoller IO复用的封装：封装了poll，中的功能
 /// ====================================================================================================
@@ -453,9 +594,23 @@ void EventLoop::removeChannel(Channel *channel)
         assert(currentActiveChannel_ == channel ||
                std::find(activeChannels_.begin(), activeChannels_.end(), channel) == activeChannels_.end());
     }
+    if (channel->isReady())
+    {
+        /// removeChannel之前，已经disableAll，mergeReadyEvents只是清空就绪事件
+        channel->mergeReadyEvents();
+        readyChannels_.erase(std::remove(readyChannels_.begin(), readyChannels_.end(), channel),
+                             readyChannels_.end());
+    }
     poller_->removeChannel(channel);
 }
 
+void EventLoop::addReadyChannel(Channel *channel)
+{
+    assert(channel->ownerLoop() == this);
+    assertInLoopThread();
+    readyChannels_.push_back(channel);
+}
+
 /// 函数参数含义：
 /// class Channel类的作用：
 /// （1）channel：通道，大管子，文件描述符（文件描述符：就是插在文件上的大管子）
@@ -511,22 +666,24 @@ void EventLoop::handleRead()
 /// 在IO线程中，执行某个用户任务回调函数
 void EventLoop::doPendingFunctors()
 {
-    /// 空向量
-    std::vector<Functor> functors;
     callingPendingFunctors_ = true;
-
-    {
-        MutexLockGuard lock(mutex_);
-        /// pendingFunctors_用于存放：需要延期执行的用户任务回调：这些回调函数，都是需要在IO线程中执行的用户任务回调
-        /// 把pendingFunctors_变成空向量，并把pendingFunctors_中原来存放的内容，全部替换到functors向量中
-        functors.swap(pendingFunctors_);
-    }
-
-    for (size_t i = 0; i < functors.size(); ++i)
+    /// 只执行本次开始时已经放入的回调函数，执行期间新放入的，留到下一次事件循环，
+    /// 不会因为回调函数不断放入新的回调函数，而饿死IO事件
+    int64_t count = functorsQueued_.get() - functorsRun_.get();
+    int64_t ran = 0;
+    for (; ran < count; ++ran)
     {
+        Functor *functor = pendingFunctors_.front();
+        if (functor == NULL)
+        {
+            // 放入者还没有链接好节点，下一次事件循环再执行
+            break;
+        }
         /// 执行用户任务回调函数
-        functors[i]();
+        (*functor)();
+        pendingFunctors_.pop();
     }
+    functorsRun_.add(ran);
     callingPendingFunctors_ = false;
 }
 
@@ -18,10 +18,13 @@
 #include <boost/noncopyable.hpp>
 #include <boost/scoped_ptr.hpp>
 
+#include <muduo/base/Atomic.h>
 #include <muduo/base/Mutex.h>
+#include <muduo/base/MpscQueue.h>
 #include <muduo/base/CurrentThread.h>
 #include <muduo/base/Timestamp.h>
 #include <muduo/net/Callbacks.h>
+#include <muduo/net/Histogram.h>
 #include <muduo/net/TimerId.h>
 
 namespace muduo
@@ -29,6 +32,7 @@ namespace muduo
     namespace net
     {
 
+        class BufferPool;
         class Channel;
         class Poller;
         class TimerQueue;
@@ -92,8 +96,75 @@ namespace muduo
             /// 将需要在IO线程中执行的用户回调函数cb，放入到队列中保存，并在必要时唤醒IO线程，执行这个用户任务回调函数
             void queueInLoop(const Functor &cb);
 
+            /// 忙轮询：阻塞在poll之前，先以0超时反复poll，最多usec微秒，
+            /// 用CPU换取更低的延迟，0表示关闭（默认），只能在IO线程中调用
+            void setBusyPollUsec(int usec);
+
+            struct BusyPollStats
+            {
+                int64_t spins;  // 忙轮询的次数
+                int64_t hits;   // 其中等到了事件，不必阻塞的次数
+                int64_t polls;  // 以0超时调用poll的总次数
+            };
+            /// 可以在任何线程中调用
+            BusyPollStats busyPollStats() const;
+
+            /// 还没有执行的回调函数个数，近似值
             size_t queueSize() const;
 
+            /// queueInLoop实际写wakeupFd_的次数，IO线程没有阻塞在poll中时，不必唤醒
+            int64_t wakeupCount() const
+            {
+                return wakeups_.get();
+            }
+
+            /// Poller调用的系统调用次数：poll/epoll_wait/io_uring_enter，以及epoll_ctl，
+            /// 可以在任何线程中调用
+            int64_t syscallCount() const;
+
+            /// 每一轮事件循环的统计，可以在任何线程中调用
+            /// 一次poll返回的事件个数
+            const Histogram &eventsPerPoll() const
+            {
+                return eventsPerPoll_;
+            }
+            /// 阻塞（或者忙轮询）在poll中的时间，微秒
+            const Histogram &pollWaitUsec() const
+            {
+                return pollWaitUsec_;
+            }
+            /// 处理事件和执行回调函数的时间，微秒
+            const Histogram &handlerUsec() const
+            {
+                return handlerUsec_;
+            }
+
+            /// 从就绪链表中，不经过poll就处理的事件次数
+            int64_t readyChannelCount() const
+            {
+                return readyChannelCount_.get();
+            }
+
+            /// 负载：这个IO线程中的TCP连接个数，以及这些连接的输出缓冲区中还没有发送的字节数，
+            /// EventLoopThreadPool按负载选择IO线程时使用，可以在任何线程中调用
+            int64_t connectionCount() const
+            {
+                return connectionCount_.get();
+            }
+            int64_t pendingOutputBytes() const
+            {
+                return pendingOutputBytes_.get();
+            }
+            /// Internal use only. 由TcpConnection维护
+            void addConnectionCount(int n)
+            {
+                connectionCount_.add(n);
+            }
+            void addPendingOutputBytes(int64_t n)
+            {
+                pendingOutputBytes_.add(n);
+            }
+
 #ifdef __GXX_EXPERIMENTAL_CXX0X__
             void runInLoop(Functor &&cb);
             void queueInLoop(Functor &&cb);
@@ -131,15 +202,39 @@ namespace muduo
             /// 以当前时间Timestamp::now()为起点，经过interval + interval这么长的时间后，定时器超时，并调用定时器回调函数
             TimerId runEvery(double interval, const TimerCallback &cb);
             ///
+            /// Runs callback after @c delay seconds, or up to @c slack seconds later.
+            /// Safe to call from other threads.
+            ///
+            /// 函数功能：
+            /// 用于允许晚到期的定时器，例如空闲连接的检查、心跳：
+            /// 到期时间在[now + delay, now + delay + slack]之内调整，和其他定时器合并，
+            /// 少调用几次timerfd_settime()，少唤醒几次IO线程
+            TimerId runAfterWithSlack(double delay, double slack, const TimerCallback &cb);
+            ///
             /// Cancels the timer.
             /// Safe to call from other threads.
             ///
             void cancel(TimerId timerId);
 
+            ///
+            /// 选择定时器容器：on为true时用分层时间轮（精度1毫秒，添加和注销是O(1)的），
+            /// 否则用按到期时间排序的std::set；已有的定时器一起搬过去
+            /// 默认用std::set，设置了环境变量MUDUO_TIMER_WHEEL时，默认用时间轮
+            /// Must be called in loop thread.
+            ///
+            void setTimingWheel(bool on);
+            bool timingWheel() const;
+
+            /// 定时器设置timerfd的次数，以及允许晚到期的定时器合并后，省掉的次数，
+            /// 可以在任何线程中调用
+            int64_t timerRearmCount() const;
+            int64_t timerRearmsAvoided() const;
+
 #ifdef __GXX_EXPERIMENTAL_CXX0X__
             TimerId runAt(const Timestamp &time, TimerCallback &&cb);
             TimerId runAfter(double delay, TimerCallback &&cb);
             TimerId runEvery(double interval, TimerCallback &&cb);
+            TimerId runAfterWithSlack(double delay, double slack, TimerCallback &&cb);
 #endif
 
             // internal usage
@@ -205,6 +300,10 @@ namespace muduo
             /// 判断，channel，在ChannelMap表 channels_中是否存在
             bool hasChannel(Channel *channel);
 
+            /// 边沿触发的channel，读写的数据量达到预算，还没有到EAGAIN时，放入就绪链表，
+            /// 下一轮事件循环不等待poll（超时为0），直接再次处理它的事件
+            void addReadyChannel(Channel *channel);
+
             /// pid_t threadId() const { return threadId_; }
             /// 确保:(1）执行事件循环（EventLoop::loop()）的线程，是IO线程
             ///      (2）执行某个函数的线程，是IO线程
@@ -246,14 +345,24 @@ namespace muduo
                 return &context_;
             }
 
+            /// 本IO线程中，各个TCP连接的输入、输出缓冲区，从这个缓冲区池中租用，数据处理完后归还
+            /// 只能在IO线程中使用
+            BufferPool *bufferPool()
+            {
+                return get_pointer(bufferPool_);
+            }
+
             /// 获得每个线程中仅有的那个EventLoop对象
             static EventLoop *getEventLoopOfCurrentThread();
 
         private:
             void abortNotInLoopThread();
             void handleRead();  // waked up
+            void wakeupIfPolling();
+            bool busyPoll();
             /// 在IO线程中，执行某个用户任务回调函数
             void doPendingFunctors();
+            void collectReadyChannels();
 
             void printActiveChannels() const; // DEBUG
 
@@ -274,6 +383,7 @@ namespace muduo
 
             /// 定时器容器
             boost::scoped_ptr<TimerQueue> timerQueue_;
+            boost::scoped_ptr<BufferPool> bufferPool_;
 
             /// 用于唤醒IO线程的文件描述符
             int wakeupFd_;
@@ -298,12 +408,29 @@ namespace muduo
             /// （3）用一个class Channel类，来管理一个文件描述符
             /// currentActiveChannel_：管理(存放)，从记录实际发生的事件的表activeChannels_中，取出来的一个表项
             Channel *currentActiveChannel_;
+            /// 就绪链表：没有读（写）到EAGAIN的边沿触发channel
+            ChannelList readyChannels_;
+            mutable AtomicInt64 readyChannelCount_;
+            Histogram eventsPerPoll_;
+            Histogram pollWaitUsec_;
+            Histogram handlerUsec_;
 
-            /// 保护下面的pendingFunctors_
-            mutable MutexLock mutex_;
             /// 存放：需要延期执行的用户任务回调：这些回调函数，都是需要在IO线程中执行的用户任务回调
-            /// 多线程共享资源
-            std::vector<Functor> pendingFunctors_; // @GuardedBy mutex_
+            /// 多线程共享资源，多个线程放入，IO线程取出，不加锁
+            MpscQueue<Functor> pendingFunctors_;
+            mutable AtomicInt64 functorsQueued_;
+            mutable AtomicInt64 functorsRun_;
+            /// IO线程可能阻塞在poll中时为1，用__atomic访问
+            int polling_;
+            /// 已经写过wakeupFd_，IO线程还没有从poll返回
+            AtomicInt32 wakeupPending_;
+            mutable AtomicInt64 wakeups_;
+            int busyPollUsec_;
+            mutable AtomicInt64 busyPollSpins_;
+            mutable AtomicInt64 busyPollHits_;
+            mutable AtomicInt64 busyPollPolls_;
+            mutable AtomicInt64 connectionCount_;
+            mutable AtomicInt64 pendingOutputBytes_;
         };
     }
 }
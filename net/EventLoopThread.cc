@@ -8,13 +8,37 @@
 
 #include <muduo/net/EventLoopThread.h>
 
+#include <muduo/base/Logging.h>
 #include <muduo/net/EventLoop.h>
 
 #include <boost/bind.hpp>
 
+#include <pthread.h>
+#include <sched.h>
+
 using namespace muduo;
 using namespace muduo::net;
 
+namespace
+{
+    void bindToCpu(int cpu)
+    {
+        if (cpu >= CPU_SETSIZE)
+        {
+            LOG_ERROR << "EventLoopThread cannot bind to cpu " << cpu;
+            return;
+        }
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        int err = ::pthread_setaffinity_np(::pthread_self(), sizeof cpus, &cpus);
+        if (err != 0)
+        {
+            LOG_ERROR << "EventLoopThread cannot bind to cpu " << cpu << ": " << strerror_tl(err);
+        }
+    }
+}
+
 
 EventLoopThread::EventLoopThread(const ThreadInitCallback &cb,
                                  const string &name)
@@ -24,7 +48,8 @@ EventLoopThread::EventLoopThread(const ThreadInitCallback &cb,
       thread_(boost::bind(&EventLoopThread::threadFunc, this), name),
       mutex_(),
       cond_(mutex_),
-      callback_(cb)
+      callback_(cb),
+      cpu_(-1)
 {
 }
 
@@ -76,6 +101,11 @@ EventLoop *EventLoopThread::startLoop()
 /// 向多线程共享的EventLoop对象地址缓冲区loop_中，放入void EventLoopThread::threadFunc()创建好的多线程共享的EventLoop对象
 void EventLoopThread::threadFunc()
 {
+    // 先绑定CPU，再创建EventLoop，见setCpu()
+    if (cpu_ >= 0)
+    {
+        bindToCpu(cpu_);
+    }
     /// （1）创建EventLoop对象（IO线程：创建了EventLoop对象的线程）
     /// 即：执行void EventLoopThread::threadFunc()函数代码的线程，是IO线程
     /// （2）创建的是：EventLoop* EventLoopThread::startLoop()函数，一直等待获得的EventLoop对象
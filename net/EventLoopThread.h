@@ -42,6 +42,19 @@ namespace muduo
             /// 从多线程共享的EventLoop对象地址缓冲区loop_中，取得void EventLoopThread::threadFunc()创建好的多线程共享的EventLoop对象
             EventLoop *startLoop();
 
+            /// 在startLoop()之前调用，IO线程先绑定到这个CPU上，再创建EventLoop，
+            /// EventLoop在IO线程的栈上，它和Poller、缓冲区池等首次写入的内存，
+            /// 按Linux默认的首次访问分配策略，都分配在这个CPU所在的NUMA节点上
+            /// -1（默认）表示不绑定
+            void setCpu(int cpu)
+            {
+                cpu_ = cpu;
+            }
+            int cpu() const
+            {
+                return cpu_;
+            }
+
         private:
             /// （1）IO线程需要执行的代码，就是这个函数的代码：
             /// 创建EventLoop对象，
@@ -69,6 +82,7 @@ namespace muduo
             MutexLock mutex_;/// 互斥锁：入口等待队列
             Condition cond_;/// 条件变量：条件变量等待队列
             ThreadInitCallback callback_;
+            int cpu_;
         };
 
     }
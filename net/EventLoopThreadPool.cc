@@ -8,12 +8,15 @@
 
 #include <muduo/net/EventLoopThreadPool.h>
 
+#include <muduo/base/FileUtil.h>
+#include <muduo/base/Logging.h>
 #include <muduo/net/EventLoop.h>
 #include <muduo/net/EventLoopThread.h>
 
 #include <boost/bind.hpp>
 
 #include <stdio.h>
+#include <stdlib.h>
 
 using namespace muduo;
 using namespace muduo::net;
@@ -24,7 +27,9 @@ EventLoopThreadPool::EventLoopThreadPool(EventLoop *baseLoop, const string &name
       name_(nameArg),
       started_(false),// 记录：事件循环线程池，没有创建
       numThreads_(0),
-      next_(0)
+      next_(0),
+      placement_(kRoundRobin),
+      seed_(static_cast<unsigned int>(reinterpret_cast<uintptr_t>(this)))
 {
 }
 
@@ -54,6 +59,10 @@ void EventLoopThreadPool::start(const ThreadInitCallback &cb)
         /// （1）这个类创建的对象，就是事件循环线程管理对象
         /// （2）一个事件循环线程管理对象，就管理（代表）一个事件循环线程（IO线程）
         EventLoopThread *t = new EventLoopThread(cb, buf);
+        if (!cpus_.empty())
+        {
+            t->setCpu(cpus_[i % cpus_.size()]);
+        }
 
         // boost::ptr_vector<EventLoopThread> threads_事件循环线程池：由事件循环线程（IO线程：创建了EventLoop对象的线程）构成
         // 将事件循环线程（IO线程）对象，放入到事件循环线程（IO线程）池（线程对象池）中
@@ -70,6 +79,18 @@ void EventLoopThreadPool::start(const ThreadInitCallback &cb)
         // （3）执行EventLoopThread::startLoop()函数的线程，就是消费者线程，
         // 也就是执行void EventLoopThreadPool::start()函数的线程，也就是主线程
         loops_.push_back(t->startLoop());
+        int cpu = t->cpu();
+        if (cpu >= 0)
+        {
+            if (implicit_cast<size_t>(cpu) >= loopsByCpu_.size())
+            {
+                loopsByCpu_.resize(cpu + 1, NULL);
+            }
+            if (loopsByCpu_[cpu] == NULL)
+            {
+                loopsByCpu_[cpu] = loops_.back();
+            }
+        }
     }
     if (numThreads_ == 0 && cb)
     {
@@ -85,7 +106,15 @@ EventLoop *EventLoopThreadPool::getNextLoop()
     // 使用默认的EventLoop对象
     EventLoop *loop = baseLoop_;
     // EventLoop对象缓冲区loops_，不为空
-    if (!loops_.empty())
+    if (loops_.size() > 1 && placement_ == kPowerOfTwoChoices)
+    {
+        loop = loops_[powerOfTwoChoices()];
+    }
+    else if (loops_.size() > 1 && (placement_ == kLeastConnections || placement_ == kLeastPendingBytes))
+    {
+        loop = loops_[leastLoaded(placement_ == kLeastPendingBytes)];
+    }
+    else if (!loops_.empty())
     {
         // round-robin
         // 从EventLoop对象缓冲区loops_中，获取一个EventLoop对象
@@ -100,6 +129,48 @@ EventLoop *EventLoopThreadPool::getNextLoop()
     return loop;
 }
 
+namespace
+{
+    // 按未发送的字节数比较时，字节数相同（例如都是0），再比较连接数
+    bool lessLoaded(const EventLoop *lhs, const EventLoop *rhs, bool byPendingBytes)
+    {
+        if (byPendingBytes && lhs->pendingOutputBytes() != rhs->pendingOutputBytes())
+        {
+            return lhs->pendingOutputBytes() < rhs->pendingOutputBytes();
+        }
+        return lhs->connectionCount() < rhs->connectionCount();
+    }
+}
+
+size_t EventLoopThreadPool::leastLoaded(bool byPendingBytes)
+{
+    size_t n = loops_.size();
+    size_t best = static_cast<size_t>(next_);
+    for (size_t i = 1; i < n; ++i)
+    {
+        size_t index = (static_cast<size_t>(next_) + i) % n;
+        if (lessLoaded(loops_[index], loops_[best], byPendingBytes))
+        {
+            best = index;
+        }
+    }
+    // 负载相同的IO线程，下次从best的下一个开始找，轮流选择
+    next_ = static_cast<int>((best + 1) % n);
+    return best;
+}
+
+size_t EventLoopThreadPool::powerOfTwoChoices()
+{
+    size_t n = loops_.size();
+    size_t first = static_cast<size_t>(rand_r(&seed_)) % n;
+    size_t second = static_cast<size_t>(rand_r(&seed_)) % (n - 1);
+    if (second >= first)
+    {
+        ++second;
+    }
+    return lessLoaded(loops_[second], loops_[first], false) ? second : first;
+}
+
 EventLoop *EventLoopThreadPool::getLoopForHash(size_t hashCode)
 {
     baseLoop_->assertInLoopThread();
@@ -112,6 +183,71 @@ EventLoop *EventLoopThreadPool::getLoopForHash(size_t hashCode)
     return loop;
 }
 
+int EventLoopThreadPool::cpuOf(const EventLoop *loop) const
+{
+    // start()之后loops_、threads_不再改变，可以在任何线程中调用
+    for (size_t i = 0; i < loops_.size(); ++i)
+    {
+        if (loops_[i] == loop)
+        {
+            return threads_[i].cpu();
+        }
+    }
+    return -1;
+}
+
+std::vector<int> EventLoopThreadPool::cpusOfNode(int node)
+{
+    std::vector<int> cpus;
+    char path[64];
+    snprintf(path, sizeof path, "/sys/devices/system/node/node%d/cpulist", node);
+    string content;
+    int err = FileUtil::readFile(path, 4096, &content);
+    if (err != 0)
+    {
+        LOG_ERROR << "EventLoopThreadPool::cpusOfNode cannot read " << path << ": " << strerror_tl(err);
+        return cpus;
+    }
+    // 格式为"0-3,8-11"
+    const char *p = content.c_str();
+    while (*p)
+    {
+        char *end = NULL;
+        long first = strtol(p, &end, 10);
+        if (end == p)
+        {
+            break;
+        }
+        long last = first;
+        if (*end == '-')
+        {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+        }
+        for (long cpu = first; cpu <= last; ++cpu)
+        {
+            cpus.push_back(static_cast<int>(cpu));
+        }
+        if (*end != ',')
+        {
+            break;
+        }
+        p = end + 1;
+    }
+    return cpus;
+}
+
+EventLoop *EventLoopThreadPool::getLoopForCpu(int cpu)
+{
+    baseLoop_->assertInLoopThread();
+    assert(started_);
+    if (cpu >= 0 && implicit_cast<size_t>(cpu) < loopsByCpu_.size() && loopsByCpu_[cpu])
+    {
+        return loopsByCpu_[cpu];
+    }
+    return getNextLoop();
+}
+
 std::vector<EventLoop *> EventLoopThreadPool::getAllLoops()
 {
     baseLoop_->assertInLoopThread();
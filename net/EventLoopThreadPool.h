@@ -30,6 +30,17 @@ namespace muduo
         public:
             typedef boost::function<void(EventLoop *)> ThreadInitCallback;
 
+            /// getNextLoop()为新连接选择IO线程的策略，负载见EventLoop::connectionCount()、
+            /// EventLoop::pendingOutputBytes()
+            enum Placement
+            {
+                kRoundRobin,            // 轮流选择，默认
+                kLeastConnections,      // 连接数最少的
+                kLeastPendingBytes,     // 输出缓冲区中还没有发送的字节数最少的
+                kPowerOfTwoChoices,     // 随机选两个，取连接数少的，不必查看所有的IO线程
+                kIncomingCpu,           // TcpServer按连接的SO_INCOMING_CPU，选绑定在这个CPU上的IO线程，见getLoopForCpu()
+            };
+
             EventLoopThreadPool(EventLoop *baseLoop, const string &nameArg);
             ~EventLoopThreadPool();
 
@@ -42,13 +53,39 @@ namespace muduo
             // 并将多线程共享的EventLoop对象，放入到EventLoop对象缓冲区loops_中
             void start(const ThreadInitCallback &cb = ThreadInitCallback());
 
+            /// 在baseLoop的线程中调用
+            void setPlacement(Placement placement)
+            {
+                placement_ = placement;
+            }
+            Placement placement() const
+            {
+                return placement_;
+            }
+
+            /// 在start()之前调用：第i个IO线程绑定到cpus[i % cpus.size()]这个CPU上，见EventLoopThread::setCpu()，
+            /// IO线程的EventLoop、缓冲区池等内存，分配在它的CPU所在的NUMA节点上
+            /// cpus为空（默认）时不绑定；线程个数为0时，baseLoop不绑定
+            /// 例如：setCpuAffinity(cpusOfNode(node))，IO线程都在网卡所在的NUMA节点上
+            void setCpuAffinity(const std::vector<int> &cpus)
+            {
+                cpus_ = cpus;
+            }
+            /// loop绑定的CPU，没有绑定时为-1，start()之后调用
+            int cpuOf(const EventLoop *loop) const;
+            /// NUMA节点node上的CPU，读取/sys/devices/system/node/node<node>/cpulist，出错时返回空
+            static std::vector<int> cpusOfNode(int node);
+
             // valid after calling start()
-            /// round-robin
+            /// round-robin, or by load, see setPlacement()
             // 从EventLoop对象缓冲区loops_中，获取一个EventLoop对象
             EventLoop *getNextLoop();
 
             /// with the same hash code, it will always return the same EventLoop
             EventLoop *getLoopForHash(size_t hashCode);
+            /// 绑定在cpu上的IO线程（见setCpuAffinity()），同一个CPU上有多个时，总是第一个；
+            /// 没有时（包括cpu为-1），轮流选择
+            EventLoop *getLoopForCpu(int cpu);
 
             std::vector<EventLoop *> getAllLoops();
 
@@ -63,6 +100,9 @@ namespace muduo
             }
 
         private:
+            // 从next_开始，找负载最小的IO线程，负载相同时轮流选择
+            size_t leastLoaded(bool byPendingBytes);
+            size_t powerOfTwoChoices();
 
             // 记录：默认的EventLoop对象的地址
             EventLoop *baseLoop_;
@@ -77,6 +117,14 @@ namespace muduo
             // 记录：EventLoop对象缓冲区loops_中，能被获取的EventLoop对象的位置
             int next_;
 
+            Placement placement_;
+            // kPowerOfTwoChoices用的随机数种子
+            unsigned int seed_;
+            // 各个IO线程绑定的CPU，见setCpuAffinity()
+            std::vector<int> cpus_;
+            // 下标是CPU，绑定在它上面的第一个IO线程，没有时为NULL，start()之后不再改变
+            std::vector<EventLoop *> loopsByCpu_;
+
             /// class EventLoopThread这个类的作用：对事件循环线程（IO线程：创建了EventLoop对象的线程），进行管理
             /// （1）这个类创建的对象，就是事件循环线程管理对象
             /// （2）一个事件循环线程管理对象，就管理（代表）一个事件循环线程（IO线程）
@@ -0,0 +1,152 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include <muduo/net/Histogram.h>
+
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+// Single writer, so a relaxed load and store is enough,
+// and avoids a locked instruction on every add().
+inline void relaxedAdd(int64_t* p, int64_t delta)
+{
+  __atomic_store_n(p, __atomic_load_n(p, __ATOMIC_RELAXED) + delta, __ATOMIC_RELAXED);
+}
+
+inline int64_t relaxedLoad(const int64_t* p)
+{
+  return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+
+}
+
+const int Histogram::kNumBuckets;
+
+Histogram::Histogram()
+  : count_(0),
+    sum_(0),
+    max_(0)
+{
+  for (int i = 0; i < kNumBuckets; ++i)
+  {
+    buckets_[i] = 0;
+  }
+}
+
+void Histogram::add(int64_t value)
+{
+  int i = 0;
+  if (value > 0)
+  {
+    i = 64 - __builtin_clzll(static_cast<unsigned long long>(value));
+    if (i >= kNumBuckets)
+    {
+      i = kNumBuckets - 1;
+    }
+  }
+  relaxedAdd(&buckets_[i], 1);
+  relaxedAdd(&count_, 1);
+  relaxedAdd(&sum_, value);
+  if (value > max_)
+  {
+    __atomic_store_n(&max_, value, __ATOMIC_RELAXED);
+  }
+}
+
+int64_t Histogram::count() const
+{
+  return relaxedLoad(&count_);
+}
+
+int64_t Histogram::sum() const
+{
+  return relaxedLoad(&sum_);
+}
+
+int64_t Histogram::max() const
+{
+  return relaxedLoad(&max_);
+}
+
+int64_t Histogram::bucketCount(int i) const
+{
+  return relaxedLoad(&buckets_[i]);
+}
+
+int64_t Histogram::bucketLow(int i)
+{
+  return i == 0 ? 0 : static_cast<int64_t>(1) << (i - 1);
+}
+
+int64_t Histogram::bucketHigh(int i)
+{
+  return i == 0 ? 0 : (static_cast<int64_t>(1) << i) - 1;
+}
+
+int64_t Histogram::percentile(double p) const
+{
+  int64_t buckets[kNumBuckets];
+  int64_t total = 0;
+  for (int i = 0; i < kNumBuckets; ++i)
+  {
+    buckets[i] = bucketCount(i);
+    total += buckets[i];
+  }
+  if (total == 0)
+  {
+    return 0;
+  }
+
+  double rank = p / 100 * static_cast<double>(total);
+  int64_t seen = 0;
+  int i = 0;
+  for (; i < kNumBuckets - 1; ++i)
+  {
+    seen += buckets[i];
+    if (static_cast<double>(seen) >= rank)
+    {
+      break;
+    }
+  }
+  // the last bucket has no upper bound
+  int64_t high = bucketHigh(i);
+  int64_t maxValue = max();
+  return high < maxValue && i < kNumBuckets - 1 ? high : maxValue;
+}
+
+string Histogram::toString() const
+{
+  int64_t n = count();
+  char buf[256];
+  snprintf(buf, sizeof buf, "count %lld mean %.1f p50 %lld p90 %lld p99 %lld max %lld\n",
+           static_cast<long long>(n),
+           n > 0 ? static_cast<double>(sum()) / static_cast<double>(n) : 0.0,
+           static_cast<long long>(percentile(50)),
+           static_cast<long long>(percentile(90)),
+           static_cast<long long>(percentile(99)),
+           static_cast<long long>(max()));
+  string result(buf);
+  for (int i = 0; i < kNumBuckets; ++i)
+  {
+    int64_t c = bucketCount(i);
+    if (c > 0)
+    {
+      snprintf(buf, sizeof buf, "  %lld-%lld %lld\n",
+               static_cast<long long>(bucketLow(i)),
+               static_cast<long long>(bucketHigh(i)),
+               static_cast<long long>(c));
+      result += buf;
+    }
+  }
+  return result;
+}
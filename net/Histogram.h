@@ -0,0 +1,64 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_HISTOGRAM_H
+#define MUDUO_NET_HISTOGRAM_H
+
+#include <muduo/base/Types.h>
+
+#include <boost/noncopyable.hpp>
+
+namespace muduo
+{
+namespace net
+{
+
+///
+/// Histogram with power-of-two buckets, for per loop statistics.
+///
+/// Bucket 0 counts values <= 0, bucket i counts [2^(i-1), 2^i).
+/// add() must be called from one thread, usually the loop thread.
+/// Readers in other threads see a recent, not necessarily consistent,
+/// snapshot.
+class Histogram : boost::noncopyable
+{
+ public:
+  static const int kNumBuckets = 40;
+
+  Histogram();
+
+  void add(int64_t value);
+
+  int64_t count() const;
+  int64_t sum() const;
+  int64_t max() const;
+  int64_t bucketCount(int i) const;
+
+  /// Smallest and largest value that falls into bucket i.
+  static int64_t bucketLow(int i);
+  static int64_t bucketHigh(int i);
+
+  /// Upper bound of the bucket holding the p-th percentile, 0 < p <= 100.
+  int64_t percentile(double p) const;
+
+  /// One line summary, then one line per non-empty bucket.
+  string toString() const;
+
+ private:
+  int64_t count_;
+  int64_t sum_;
+  int64_t max_;
+  int64_t buckets_[kNumBuckets];
+};
+
+}
+}
+
+#endif  // MUDUO_NET_HISTOGRAM_H
@@ -0,0 +1,143 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include <muduo/net/IdleWheel.h>
+
+#include <muduo/base/Logging.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/TcpConnection.h>
+
+#include <boost/bind.hpp>
+
+using namespace muduo;
+using namespace muduo::net;
+
+IdleWheel::IdleWheel(EventLoop *loop, int timeoutSeconds)
+    : loop_(loop),
+      timeout_(timeoutSeconds),
+      buckets_(timeoutSeconds + 1, static_cast<TcpConnection *>(NULL)),
+      now_(0),
+      size_(0),
+      started_(false)
+{
+    assert(timeoutSeconds > 0);
+}
+
+IdleWheel::~IdleWheel()
+{
+}
+
+void IdleWheel::start()
+{
+    loop_->assertInLoopThread();
+    assert(!started_);
+    started_ = true;
+    timer_ = loop_->runEvery(1.0, boost::bind(&IdleWheel::onTick, this));
+}
+
+void IdleWheel::stop()
+{
+    loop_->assertInLoopThread();
+    if (started_)
+    {
+        loop_->cancel(timer_);
+        started_ = false;
+    }
+    for (size_t i = 0; i < buckets_.size(); ++i)
+    {
+        while (buckets_[i])
+        {
+            TcpConnection *conn = buckets_[i];
+            unlink(conn);
+            conn->idleWheel_ = NULL;
+        }
+    }
+    size_ = 0;
+}
+
+void IdleWheel::add(TcpConnection *conn)
+{
+    loop_->assertInLoopThread();
+    assert(conn->idleBucket_ < 0);
+    conn->idleWheel_ = this;
+    conn->idleTouched_ = now_;
+    link(conn, deadline(now_));
+    ++size_;
+}
+
+void IdleWheel::remove(TcpConnection *conn)
+{
+    loop_->assertInLoopThread();
+    assert(conn->idleWheel_ == this);
+    if (conn->idleBucket_ >= 0)
+    {
+        unlink(conn);
+        --size_;
+    }
+    conn->idleWheel_ = NULL;
+}
+
+void IdleWheel::onTick()
+{
+    ++now_;
+    size_t index = static_cast<size_t>(now_ % static_cast<int64_t>(buckets_.size()));
+    TcpConnection *conn = buckets_[index];
+    while (conn)
+    {
+        TcpConnection *next = conn->idleNext_;
+        unlink(conn);
+        int64_t expiration = deadline(conn->idleTouched_);
+        if (expiration > now_)
+        {
+            // 这期间有过读写，按最后一次读写的时间，移到后面的桶中
+            link(conn, expiration);
+        }
+        else
+        {
+            --size_;
+            closed_.increment();
+            conn->idleWheel_ = NULL;
+            LOG_DEBUG << "IdleWheel::onTick closing idle connection " << conn->name();
+            conn->forceClose();
+        }
+        conn = next;
+    }
+}
+
+void IdleWheel::link(TcpConnection *conn, int64_t deadline)
+{
+    int bucket = static_cast<int>(deadline % static_cast<int64_t>(buckets_.size()));
+    TcpConnection *head = buckets_[bucket];
+    conn->idlePrev_ = NULL;
+    conn->idleNext_ = head;
+    conn->idleBucket_ = bucket;
+    if (head)
+    {
+        head->idlePrev_ = conn;
+    }
+    buckets_[bucket] = conn;
+}
+
+void IdleWheel::unlink(TcpConnection *conn)
+{
+    if (conn->idlePrev_)
+    {
+        conn->idlePrev_->idleNext_ = conn->idleNext_;
+    }
+    else
+    {
+        buckets_[conn->idleBucket_] = conn->idleNext_;
+    }
+    if (conn->idleNext_)
+    {
+        conn->idleNext_->idlePrev_ = conn->idlePrev_;
+    }
+    conn->idlePrev_ = NULL;
+    conn->idleNext_ = NULL;
+    conn->idleBucket_ = -1;
+}
@@ -0,0 +1,94 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is an internal header file, you should not include this.
+
+#ifndef MUDUO_NET_IDLEWHEEL_H
+#define MUDUO_NET_IDLEWHEEL_H
+
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <muduo/base/Atomic.h>
+#include <muduo/net/TimerId.h>
+
+namespace muduo
+{
+    namespace net
+    {
+        class EventLoop;
+        class TcpConnection;
+
+        ///
+        /// 空闲连接检查：一个IO线程中，TcpServer的所有连接，按到期的秒数，放在timeout + 1个桶中
+        /// Buckets of connections by idle deadline, one per TcpServer per loop.
+        ///
+        /// 连接用TcpConnection中的指针串成双向链表，不另外分配内存
+        /// 连接有读写事件时，只记下当前的秒数（touch()），不移动链表
+        /// 每秒检查一个桶：桶中的连接，这期间有过读写的，按最后一次读写的时间，移到后面的桶中；
+        /// 没有的，调用forceClose()关闭
+        /// 每秒的工作量，平均是连接数 / timeout，和读写的次数无关
+        ///
+        /// 只在所属的IO线程中使用
+        class IdleWheel : boost::noncopyable
+        {
+        public:
+            IdleWheel(EventLoop *loop, int timeoutSeconds);
+            ~IdleWheel();
+
+            /// 开始每秒检查一次，在IO线程中调用
+            void start();
+            /// 停止检查，并放开所有的连接，在IO线程中调用
+            void stop();
+
+            /// 连接建立时放入，关闭时取出
+            void add(TcpConnection *conn);
+            void remove(TcpConnection *conn);
+
+            /// 当前的秒数，连接有读写时，记到TcpConnection中
+            int64_t now() const
+            {
+                return now_;
+            }
+
+            size_t size() const
+            {
+                return size_;
+            }
+
+            /// 因为空闲而关闭的连接数，可以在任何线程中调用
+            int64_t closedCount() const
+            {
+                return closed_.get();
+            }
+
+        private:
+            void onTick();
+            // 秒数touched时有过读写的连接，在哪一秒检查时关闭
+            // 秒数touched之后、下一秒之前的读写都记为touched，所以多等一秒，保证至少空闲了timeout_秒
+            int64_t deadline(int64_t touched) const
+            {
+                return touched + timeout_ + 1;
+            }
+            void link(TcpConnection *conn, int64_t deadline);
+            void unlink(TcpConnection *conn);
+
+            EventLoop *loop_;
+            const int timeout_;
+            // 到期的秒数为t的连接，放在buckets_[t % buckets_.size()]中，这是链表的表头
+            std::vector<TcpConnection *> buckets_;
+            int64_t now_;
+            size_t size_;
+            TimerId timer_;
+            bool started_;
+            mutable AtomicInt64 closed_;
+        };
+    }
+}
+#endif  // MUDUO_NET_IDLEWHEEL_H
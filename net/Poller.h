@@ -15,6 +15,7 @@
 #include <vector>
 #include <boost/noncopyable.hpp>
 
+#include <muduo/base/Atomic.h>
 #include <muduo/base/Timestamp.h>
 #include <muduo/net/EventLoop.h>
 
@@ -139,6 +140,12 @@ namespace muduo
                 ownerLoop_->assertInLoopThread();
             }
 
+            /// 调用的系统调用次数（poll、epoll_wait、epoll_ctl、io_uring_enter），可以在任何线程中调用
+            int64_t syscallCount() const
+            {
+                return syscalls_.get();
+            }
+
         protected:
             /// class Channel类的作用：
             /// （1）channel：通道，大管子，文件描述符（文件描述符：就是插在文件上的大管子）
@@ -148,6 +155,8 @@ namespace muduo
             /// 网络库中，所有的文件描述符fd，其上注册的事件events，以及其上实际发生的事件revents，都保存在了，ChannelMap表中
             typedef std::map<int, Channel *> ChannelMap;
             ChannelMap channels_;
+            /// 子类每调用一次系统调用，加一
+            mutable AtomicInt64 syscalls_;
 
         private:
             EventLoop *ownerLoop_;
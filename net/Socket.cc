@@ -102,6 +102,14 @@ void Socket::setTcpNoDelay(bool on)
     // FIXME CHECK
 }
 
+void Socket::setTcpCork(bool on)
+{
+    int optval = on ? 1 : 0;
+    ::setsockopt(sockfd_, IPPROTO_TCP, TCP_CORK,
+                 &optval, static_cast<socklen_t>(sizeof optval));
+    // FIXME CHECK
+}
+
 void Socket::setReuseAddr(bool on)
 {
     int optval = on ? 1 : 0;
@@ -136,3 +144,35 @@ void Socket::setKeepAlive(bool on)
     // FIXME CHECK
 }
 
+bool Socket::setBusyPoll(int usec)
+{
+#ifdef SO_BUSY_POLL
+    int ret = ::setsockopt(sockfd_, SOL_SOCKET, SO_BUSY_POLL,
+                           &usec, static_cast<socklen_t>(sizeof usec));
+    if (ret < 0)
+    {
+        LOG_SYSERR << "SO_BUSY_POLL failed.";
+    }
+    return ret == 0;
+#else
+    LOG_ERROR << "SO_BUSY_POLL is not supported.";
+    return false;
+#endif
+}
+
+bool Socket::setIncomingCpu(int cpu)
+{
+#ifdef SO_INCOMING_CPU
+    int ret = ::setsockopt(sockfd_, SOL_SOCKET, SO_INCOMING_CPU,
+                           &cpu, static_cast<socklen_t>(sizeof cpu));
+    if (ret < 0)
+    {
+        LOG_SYSERR << "SO_INCOMING_CPU failed.";
+    }
+    return ret == 0;
+#else
+    LOG_ERROR << "SO_INCOMING_CPU is not supported.";
+    return false;
+#endif
+}
+
@@ -73,6 +73,11 @@ namespace muduo
             ///
             void setTcpNoDelay(bool on);
 
+            ///
+            /// Enable/disable TCP_CORK, only full segments are sent while it is on.
+            ///
+            void setTcpCork(bool on);
+
             ///
             /// Enable/disable SO_REUSEADDR
             ///
@@ -88,6 +93,19 @@ namespace muduo
             ///
             void setKeepAlive(bool on);
 
+            ///
+            /// Set SO_BUSY_POLL, busy poll the device queue for up to usec
+            /// microseconds on blocking receive, 0 disables.
+            /// Raising it above net.core.busy_read needs CAP_NET_ADMIN.
+            ///
+            bool setBusyPoll(int usec);
+
+            ///
+            /// Set SO_INCOMING_CPU on a listening socket. Among SO_REUSEPORT
+            /// listeners, the kernel prefers the one whose cpu handled the SYN.
+            ///
+            bool setIncomingCpu(int cpu);
+
         private:
             // 管理的socket文件描述符
             const int sockfd_;
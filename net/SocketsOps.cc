@@ -16,8 +16,9 @@
 #include <fcntl.h>
 #include <stdio.h>  // snprintf
 #include <strings.h>  // bzero
+#include <sys/sendfile.h>
 #include <sys/socket.h>
-#include <sys/uio.h>  // readv
+#include <sys/uio.h>  // readv, writev
 #include <unistd.h>
 
 using namespace muduo;
@@ -141,7 +142,11 @@ int sockets::accept(int sockfd, struct sockaddr_in6 *addr)
     if (connfd < 0)
     {
         int savedErrno = errno;
-        LOG_SYSERR << "Socket::accept";
+        // Acceptor一次accept多个连接，直到EAGAIN，这不是错误
+        if (savedErrno != EAGAIN)
+        {
+            LOG_SYSERR << "Socket::accept";
+        }
         switch (savedErrno)
         {
         case EAGAIN:
@@ -192,6 +197,16 @@ ssize_t sockets::write(int sockfd, const void *buf, size_t count)
     return ::write(sockfd, buf, count);
 }
 
+ssize_t sockets::writev(int sockfd, const struct iovec *iov, int iovcnt)
+{
+    return ::writev(sockfd, iov, iovcnt);
+}
+
+ssize_t sockets::sendfile(int sockfd, int infd, off_t *offset, size_t count)
+{
+    return ::sendfile(sockfd, infd, offset, count);
+}
+
 // 关闭sockfd
 void sockets::close(int sockfd)
 {
@@ -274,6 +289,23 @@ int sockets::getSocketError(int sockfd)
     }
 }
 
+int sockets::getIncomingCpu(int sockfd)
+{
+#ifdef SO_INCOMING_CPU
+    int cpu = -1;
+    socklen_t optlen = static_cast<socklen_t>(sizeof cpu);
+    if (::getsockopt(sockfd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &optlen) < 0)
+    {
+        LOG_SYSERR << "sockets::getIncomingCpu";
+        return -1;
+    }
+    return cpu;
+#else
+    (void)sockfd;
+    return -1;
+#endif
+}
+
 struct sockaddr_in6 sockets::getLocalAddr(int sockfd)
 {
     struct sockaddr_in6 localaddr;
@@ -41,6 +41,9 @@ namespace muduo
             ssize_t read(int sockfd, void *buf, size_t count);
             ssize_t readv(int sockfd, const struct iovec *iov, int iovcnt);
             ssize_t write(int sockfd, const void *buf, size_t count);
+            ssize_t writev(int sockfd, const struct iovec *iov, int iovcnt);
+            // 把文件infd中，从*offset开始的count字节，在内核中直接发送到sockfd，不经过用户空间
+            ssize_t sendfile(int sockfd, int infd, off_t *offset, size_t count);
 
             // 关闭sockfd
             void close(int sockfd);
@@ -57,6 +60,8 @@ namespace muduo
                             struct sockaddr_in6 *addr);
 
             int getSocketError(int sockfd);
+            // SO_INCOMING_CPU：处理这个连接收到的数据包的CPU，不支持或者出错时返回-1
+            int getIncomingCpu(int sockfd);
 
             const struct sockaddr *sockaddr_cast(const struct sockaddr_in *addr);
             const struct sockaddr *sockaddr_cast(const struct sockaddr_in6 *addr);
@@ -10,18 +10,72 @@
 
 #include <muduo/base/Logging.h>
 #include <muduo/base/WeakCallback.h>
+#include <muduo/net/BufferPool.h>
 #include <muduo/net/Channel.h>
 #include <muduo/net/EventLoop.h>
+#include <muduo/net/IdleWheel.h>
 #include <muduo/net/Socket.h>
 #include <muduo/net/SocketsOps.h>
 
 #include <boost/bind.hpp>
 
 #include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
 using namespace muduo;
 using namespace muduo::net;
 
+namespace
+{
+    // 持有sendFile时dup出来的文件描述符，文件数据发送完毕后关闭
+    class FileHolder : boost::noncopyable
+    {
+    public:
+        explicit FileHolder(int fd)
+            : fd_(fd)
+        {
+        }
+
+        ~FileHolder()
+        {
+            ::close(fd_);
+        }
+
+    private:
+        const int fd_;
+    };
+}
+
+const size_t TcpConnection::kMaxCopyOnDetach;
+const size_t TcpConnection::kMinReadSizeHint;
+const size_t TcpConnection::kMaxReadSizeHint;
+const size_t TcpConnection::kDefaultDrainBudget;
+
+// 非IO线程send的一条数据，以下三种之一：
+//  (1)buffer非空：send(Buffer*)、send(BufferPtr)
+//  (2)file非空：sendFile
+//  (3)否则：send(StringPiece)，数据拷贝在message中
+struct TcpConnection::PendingSend
+{
+    PendingSend()
+        : fd(-1),
+          offset(0),
+          length(0)
+    {
+    }
+
+    string message;
+    BufferPtr buffer;
+    int fd;
+    off_t offset;
+    size_t length;
+    boost::shared_ptr<void> file;
+};
+
 void muduo::net::defaultConnectionCallback(const TcpConnectionPtr &conn)
 {
     LOG_TRACE << conn->localAddress().toIpPort() << " -> "
@@ -43,11 +97,22 @@ TcpConnection::TcpConnection(EventLoop *loop,
                              const InetAddress &localAddr,
                              const InetAddress &peerAddr)
     : loop_(CHECK_NOTNULL(loop)),
+      migrating_(false),
       // 存放服务端进程与客户端进程，所建立的连接的名字
       name_(nameArg),
       // 存放服务端进程与客户端进程，所建立的连接的连接状态
       state_(kConnecting),
       reading_(true),
+      lazyInputBuffer_(false),
+      readPolicy_(kReadOnce),
+      readBudget_(0),
+      readSizeHint_(kMinReadSizeHint),
+      readSizeShrinking_(false),
+      corkDepth_(0),
+      corkDuringRead_(false),
+      kernelCork_(false),
+      edgeTriggered_(false),
+      drainBudget_(kDefaultDrainBudget),
       // （1）第一个作用
       // 服务端进程，调用accept函数从处于监听状态的套接字的客户端进程连接请求队列中取出排在最前面的一个客户连接请求，
       // 并且服务端进程，会创建一个新的套接字，来与客户端进程的套接字，创建连接通道
@@ -60,7 +125,14 @@ TcpConnection::TcpConnection(EventLoop *loop,
       channel_(new Channel(loop, sockfd)),
       localAddr_(localAddr),
       peerAddr_(peerAddr),
-      highWaterMark_(64 * 1024 * 1024)
+      highWaterMark_(64 * 1024 * 1024),
+      idleWheel_(NULL),
+      idlePrev_(NULL),
+      idleNext_(NULL),
+      idleBucket_(-1),
+      idleTouched_(0),
+      pendingBytes_(0),
+      sampledWakeups_(0)
 {
     // 设置：套接字socket_(其内部成员变量：sockfd_)，上有可读事件发生时，
     // 读事件的事件处理函数为void TcpConnection::handleRead()
@@ -84,9 +156,13 @@ TcpConnection::TcpConnection(EventLoop *loop,
     // 执行此函数，进行错误处理
     channel_->setErrorCallback(
         boost::bind(&TcpConnection::handleError, this));
+    // 输出缓冲区outputBuffer_中的数据块，从IO线程的缓冲区池中租用
+    outputBuffer_.setBufferPool(loop->bufferPool());
     LOG_DEBUG << "TcpConnection::ctor[" <<  name_ << "] at " << this
               << " fd=" << sockfd;
     socket_->setKeepAlive(true);
+    // TcpServer在选择IO线程时就创建连接，这时就计入负载，避免一批新连接都选中同一个IO线程
+    loop->addConnectionCount(1);
 }
 
 TcpConnection::~TcpConnection()
@@ -95,6 +171,49 @@ TcpConnection::~TcpConnection()
               << " fd=" << channel_->fd()
               << " state=" << stateToString();
     assert(state_ == kDisconnected);
+    getLoop()->addConnectionCount(-1);
+    getLoop()->addPendingOutputBytes(-static_cast<int64_t>(pendingBytes_));
+}
+
+Buffer *TcpConnection::inputBuffer()
+{
+    getLoop()->assertInLoopThread();
+    if (!inputBuffer_)
+    {
+        inputBuffer_ = getLoop()->bufferPool()->acquire();
+    }
+    return get_pointer(inputBuffer_);
+}
+
+void TcpConnection::releaseInputBuffer()
+{
+    if (inputBuffer_ && inputBuffer_->readableBytes() == 0)
+    {
+        getLoop()->bufferPool()->release(&inputBuffer_);
+    }
+}
+
+void TcpConnection::setLazyInputBuffer(bool on)
+{
+    getLoop()->assertInLoopThread();
+    lazyInputBuffer_ = on;
+}
+
+void TcpConnection::setReadPolicy(ReadPolicy policy, size_t budget)
+{
+    getLoop()->assertInLoopThread();
+    assert(policy != kReadBudget || budget > 0);
+    readPolicy_ = policy;
+    readBudget_ = budget;
+}
+
+void TcpConnection::setEdgeTriggered(bool on, size_t drainBudget)
+{
+    getLoop()->assertInLoopThread();
+    assert(drainBudget > 0);
+    edgeTriggered_ = on;
+    drainBudget_ = drainBudget;
+    channel_->setEdgeTriggered(on);
 }
 
 bool TcpConnection::getTcpInfo(struct tcp_info *tcpi) const
@@ -131,21 +250,17 @@ void TcpConnection::send(const StringPiece &message)
     if (state_ == kConnected)
     {
         // 正在执行TcpConnection::send的函数的线程，是IO线程
-        if (loop_->isInLoopThread())
+        if (getLoop()->isInLoopThread())
         {
             sendInLoop(message);
         }
         else// 正在执行TcpConnection::send的函数的线程，不是IO线程
         {
-            /// 在IO线程中，执行用户任务回调函数TcpConnection::sendInLoop
-            /// (1)当前在IO线程中，所以，可以立即执行用户任务回调函数TcpConnection::sendInLoop
-            /// (2)当前不在IO线程中，所以，就不能立即执行用户任务回回调函数
-            /// 将需要在IO线程中执行的用户回调函数TcpConnection::sendInLoop，放入到队列中保存，并在必要时唤醒IO线程，执行这个用户任务回调函数
-            loop_->runInLoop(
-                boost::bind(&TcpConnection::sendInLoop,
-                            this,     // FIXME
-                            message.as_string()));
-            //std::forward<string>(message)));
+            /// 当前不在IO线程中，所以，就不能立即发送
+            /// 将数据放入到本连接的发送队列sendQueue_中，由IO线程在一次事件循环中统一发送
+            PendingSend pending;
+            message.CopyToString(&pending.message);
+            queueSend(pending);
         }
     }
 }
@@ -161,26 +276,136 @@ void TcpConnection::send(Buffer *buf)
     if (state_ == kConnected)
     {
         // 正在执行TcpConnection::send的函数的线程，是IO线程
-        if (loop_->isInLoopThread())
+        if (getLoop()->isInLoopThread())
         {
-            sendInLoop(buf->peek(), buf->readableBytes());
+            bool faultError = false;
+            size_t nwrote = writeDirectly(buf->peek(), buf->readableBytes(), &faultError);
+            buf->retrieve(nwrote);
+            if (!faultError && buf->readableBytes() > 0)
+            {
+                size_t oldLen = outputBuffer_.readableBytes();
+                // 不拷贝数据：剩余的数据，通过swap挂到outputBuffer_的链表末尾，
+                // buf换到一块从缓冲区池租来的、容量差不多的空缓冲区，
+                // buf通常就是本连接的inputBuffer_（或者IO线程的scratch缓冲区），它们的容量不变，
+                // 换出去的内存发送完之后，归还给缓冲区池
+                outputBuffer_.append(buf);
+                outputQueued(oldLen);
+            }
             buf->retrieveAll();
         }
         else // 正在执行TcpConnection::send的函数的线程，不是IO线程
         {
-            /// 在IO线程中，执行用户任务回调函数TcpConnection::sendInLoop
-            /// (1)当前在IO线程中，所以，可以立即执行用户任务回调函数TcpConnection::sendInLoop
-            /// (2)当前不在IO线程中，所以，就不能立即执行用户任务回回调函数
-            /// 将需要在IO线程中执行的用户回调函数TcpConnection::sendInLoop，放入到队列中保存，并在必要时唤醒IO线程，执行这个用户任务回调函数
-            loop_->runInLoop(
-                boost::bind(&TcpConnection::sendInLoop,
-                            this,     // FIXME
-                            buf->retrieveAllAsString()));
-            //std::forward<string>(message)));
+            // 通过swap取走buf中的数据，不拷贝
+            BufferPtr message(new Buffer(0));
+            message->swap(*buf);
+            PendingSend pending;
+            pending.buffer = message;
+            queueSend(pending);
         }
     }
 }
 
+// 函数参数含义：
+//    const BufferPtr &message：需要发送的数据，都存放都这里了
+// 函数功能：
+//  （1）不拷贝数据，直接把message挂到输出缓冲区outputBuffer_的链表末尾
+//  （2）message可以同时发送给多个连接，发送完成之前，调用者不可以再修改message
+void TcpConnection::send(const BufferPtr &message)
+{
+    if (state_ == kConnected)
+    {
+        if (getLoop()->isInLoopThread())
+        {
+            sendBufferInLoop(message);
+        }
+        else
+        {
+            PendingSend pending;
+            pending.buffer = message;
+            queueSend(pending);
+        }
+    }
+}
+
+// 函数参数含义：
+//    int fd：需要发送的文件（普通文件）的文件描述符
+//    off_t offset：从文件的这个位置开始发送
+//    size_t length：需要发送的字节数
+// 函数功能：
+//  与其他send按调用顺序排队，由sendfile(2)在内核中直接发送，不经过用户空间
+void TcpConnection::sendFile(int fd, off_t offset, size_t length)
+{
+    if (state_ == kConnected)
+    {
+        // dup一份，调用者可以立即关闭fd
+        int filefd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        if (filefd < 0)
+        {
+            LOG_SYSERR << "TcpConnection::sendFile";
+            return;
+        }
+        boost::shared_ptr<void> file(new FileHolder(filefd));
+        if (getLoop()->isInLoopThread())
+        {
+            sendFileInLoop(filefd, offset, length, file);
+        }
+        else
+        {
+            PendingSend pending;
+            pending.fd = filefd;
+            pending.offset = offset;
+            pending.length = length;
+            pending.file = file;
+            queueSend(pending);
+        }
+    }
+}
+
+// 函数功能：
+//  非IO线程调用send时，放入发送队列sendQueue_，不加锁，也不为每条消息分配一个boost::function，
+//  发送队列从空变为非空时，才调用一次queueInLoop，唤醒IO线程执行drainSendQueue
+void TcpConnection::queueSend(const PendingSend &pending)
+{
+    sendQueue_.put(pending);
+    // 先放入队列，再设置标志；drainSendQueue先清除标志，再取队列，不会漏掉数据
+    if (sendQueueScheduled_.getAndSet(1) == 0)
+    {
+        getLoop()->queueInLoop(boost::bind(&TcpConnection::drainSendQueue, shared_from_this()));
+    }
+}
+
+// 函数功能：
+//  在IO线程中，按放入的顺序，发送sendQueue_中的全部数据，
+//  期间cork，一批数据只用一次writev发送
+void TcpConnection::drainSendQueue()
+{
+    // 连接迁移到了另一个IO线程时，在旧的IO线程中排队的调用，转交给新的IO线程执行
+    if (!getLoop()->isInLoopThread())
+    {
+        getLoop()->queueInLoop(boost::bind(&TcpConnection::drainSendQueue, shared_from_this()));
+        return;
+    }
+    sendQueueScheduled_.getAndSet(0);
+    cork();
+    while (PendingSend *pending = sendQueue_.front())
+    {
+        if (pending->buffer)
+        {
+            sendBufferInLoop(pending->buffer);
+        }
+        else if (pending->file)
+        {
+            sendFileInLoop(pending->fd, pending->offset, pending->length, pending->file);
+        }
+        else
+        {
+            sendInLoop(pending->message);
+        }
+        sendQueue_.pop();
+    }
+    uncork();
+}
+
 // 函数参数的含义：
 //    const StringPiece &message：需要发送的数据，都存放都这里了
 // 函数功能：
@@ -201,9 +426,41 @@ void TcpConnection::sendInLoop(const void *data, size_t len)
 {
     // 确保：执行事件循环（EventLoop::loop()）的线程，是IO线程
     // 即：确保，执行TcpConnection::sendInLoop函数的线程，是IO线程
-    loop_->assertInLoopThread();
-    ssize_t nwrote = 0;
-    size_t remaining = len;
+    getLoop()->assertInLoopThread();
+    bool faultError = false;
+    if (state_ == kDisconnected)
+    {
+        LOG_WARN << "disconnected, give up writing";
+        return;
+    }
+
+    // nwrote：记录本次直接发送出去的数据的长度
+    // remaining：记录，还剩下多少数据没有被发送
+    size_t nwrote = writeDirectly(data, len, &faultError);
+    size_t remaining = len - nwrote;
+
+    // 代码执行到这里，意味着：outputBuffer_.readableBytes() != 0 ，也就是，outputBuffer_中有待发送的数据
+    // 那就不能直接发送数据，因为这会造成数据乱序，
+    // 所以，需要将本次发送的数据，也执行outputBuffer_.append(static_cast<const char *>(data) + nwrote, remaining)，
+    // 保存到outputBuffer_中
+    assert(remaining <= len);
+    if (!faultError && remaining > 0)
+    {
+        // 获取outputBuffer_中待发送的数据的长度oldLen
+        size_t oldLen = outputBuffer_.readableBytes();
+        // 将本次发送的数据data，拷贝到outputBuffer_的末尾数据块中
+        outputBuffer_.append(static_cast<const char *>(data) + nwrote, remaining);
+        outputQueued(oldLen);
+    }
+}
+
+// 函数参数的含义：
+//    const BufferPtr &message：需要发送的数据，都存放都这里了
+// 函数功能：
+//  与sendInLoop相同，但未发送完的数据，不拷贝，直接挂到outputBuffer_的链表末尾
+void TcpConnection::sendBufferInLoop(const BufferPtr &message)
+{
+    getLoop()->assertInLoopThread();
     bool faultError = false;
     if (state_ == kDisconnected)
     {
@@ -211,29 +468,179 @@ void TcpConnection::sendInLoop(const void *data, size_t len)
         return;
     }
 
-    // if no thing in output queue, try writing directly
+    size_t len = message->readableBytes();
+    size_t nwrote = writeDirectly(message->peek(), len, &faultError);
+    size_t remaining = len - nwrote;
+    if (!faultError && remaining > 0)
+    {
+        size_t oldLen = outputBuffer_.readableBytes();
+        outputBuffer_.append(message->peek() + nwrote, remaining, message);
+        outputQueued(oldLen);
+    }
+}
+
+// 函数参数的含义：
+//    int fd：需要发送的文件的文件描述符（dup出来的，由file持有）
+//    off_t offset：从文件的这个位置开始发送
+//    size_t length：需要发送的字节数
+//    const boost::shared_ptr<void> &file：文件数据发送完毕之前，保持fd打开
+// 函数功能：
+//  把文件区域挂到outputBuffer_的链表末尾，outputBuffer_中原本没有待发送的数据时，立即用sendfile发送
+void TcpConnection::sendFileInLoop(int fd, off_t offset, size_t length,
+                                   const boost::shared_ptr<void> &file)
+{
+    getLoop()->assertInLoopThread();
+    if (state_ == kDisconnected)
+    {
+        LOG_WARN << "disconnected, give up writing";
+        return;
+    }
+
+    size_t oldLen = outputBuffer_.readableBytes();
+    bool writeNow = corkDepth_ == 0 && !channel_->isWriting() && oldLen == 0;
+    if (length == 0)
+    {
+        // 没有数据要发送，与发送空的消息一样：没有待发送的数据时，也调用一次写完成回调函数
+        if (writeNow && writeCompleteCallback_)
+        {
+            getLoop()->queueInLoop(boost::bind(&TcpConnection::callWriteComplete, shared_from_this()));
+        }
+        return;
+    }
+    outputBuffer_.appendFile(fd, offset, length, file);
+    if (writeNow)
+    {
+        flushOutput();
+    }
+
+    if (!outputBuffer_.empty())
+    {
+        outputQueued(oldLen);
+    }
+}
+
+// 函数功能：
+//  outputBuffer_中有数据，但还没有关注写事件时（例如刚刚uncork），立即用一次writev发送，
+//  没发完的数据，关注channel_上的写事件，在handleWrite中继续发送
+void TcpConnection::flushOutput()
+{
+    if (state_ == kDisconnected || channel_->isWriting() || outputBuffer_.empty())
+    {
+        return;
+    }
+
+    int savedErrno = 0;
+    ssize_t n = outputBuffer_.writeFd(channel_->fd(), &savedErrno);
+    if (n < 0 && savedErrno == EIO)
+    {
+        abortOutput("TcpConnection::flushOutput");
+        return;
+    }
+    if (n < 0 && savedErrno != EWOULDBLOCK)
+    {
+        errno = savedErrno;
+        LOG_SYSERR << "TcpConnection::flushOutput";
+        if (savedErrno == EPIPE || savedErrno == ECONNRESET) // FIXME: any others?
+        {
+            outputBuffer_.retrieveAll();
+            updatePendingBytes();
+            return;
+        }
+    }
+    updatePendingBytes();
+
+    if (outputBuffer_.empty())
+    {
+        if (n >= 0 && writeCompleteCallback_)
+        {
+            getLoop()->queueInLoop(boost::bind(&TcpConnection::callWriteComplete, shared_from_this()));
+        }
+        if (state_ == kDisconnecting)
+        {
+            shutdownInLoop();
+        }
+    }
+    else
+    {
+        channel_->enableWriting();
+    }
+}
+
+void TcpConnection::abortOutput(const char *where)
+{
+    LOG_ERROR << where << " [" << name_ << "] file shorter than sendFile() length, force close";
+    outputBuffer_.retrieveAll();
+    updatePendingBytes();
+    if (channel_->isWriting())
+    {
+        channel_->disableWriting();
+    }
+    forceClose();
+}
+
+// 函数功能：
+//  开始攒数据：在uncork之前，send的数据都只追加到outputBuffer_中，不立即发送，
+//  uncork时，用一次writev全部发送出去
+//  可以嵌套调用，只能在IO线程中调用
+void TcpConnection::cork()
+{
+    getLoop()->assertInLoopThread();
+    if (corkDepth_++ == 0 && kernelCork_)
+    {
+        socket_->setTcpCork(true);
+    }
+}
+
+void TcpConnection::uncork()
+{
+    getLoop()->assertInLoopThread();
+    assert(corkDepth_ > 0);
+    if (--corkDepth_ == 0)
+    {
+        flushOutput();
+        if (kernelCork_ && state_ != kDisconnected)
+        {
+            // 清除TCP_CORK，内核立即发出最后一个不满的报文段
+            socket_->setTcpCork(false);
+        }
+    }
+}
+
+void TcpConnection::setCorkDuringRead(bool on)
+{
+    getLoop()->assertInLoopThread();
+    corkDuringRead_ = on;
+}
+
+void TcpConnection::setKernelCork(bool on)
+{
+    getLoop()->assertInLoopThread();
+    assert(corkDepth_ == 0);
+    kernelCork_ = on;
+}
+
+// 函数功能：
+// if no thing in output queue, try writing directly
+// 返回：本次直接发送出去的数据的长度
+size_t TcpConnection::writeDirectly(const void *data, size_t len, bool *faultError)
+{
+    ssize_t nwrote = 0;
     // !channel_->isWriting()：channel_上，此时并未正在进行发送数据
     // outputBuffer_.readableBytes() == 0：outputBuffer_中，没有待发送的数据
-    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+    // corkDepth_ == 0：没有在攒数据
+    if (corkDepth_ == 0 && !channel_->isWriting() && outputBuffer_.readableBytes() == 0)
     {
         // 实施发送数据
         // nwrote：记录本次执行sockets::write时，总共发送了多少数据
         nwrote = sockets::write(channel_->fd(), data, len);
         if (nwrote >= 0)
         {
-            // size_t len：需要发送的数据的总长度
-            // nwrote：记录本次执行sockets::write时，总共发送了多少数据
-            // remaining：记录，还剩下多少数据没有被发送
-            remaining = len - nwrote;
             // 写完成回调函数writeCompleteCallback_的作用：
-            // 1.）输出缓冲区outputBuffer_的作用：
-            //     (1)服务端，将需要发送给客户端的数据，存放到这里，然后发送给客户端
-            //     (2)客户端，将需要发送给服务端的数据，存放到这里，然后发送给服务端
-            // 2.）输出缓冲区outputBuffer_中的数据，发送完毕后，会调用这个回调函数，提示数据发送完成
-            if (remaining == 0 && writeCompleteCallback_)
+            // 输出缓冲区outputBuffer_中的数据，发送完毕后，会调用这个回调函数，提示数据发送完成
+            if (implicit_cast<size_t>(nwrote) == len && writeCompleteCallback_)
             {
                 /// 将需要在IO线程中执行的用户回调函数writeCompleteCallback_，放入到队列中保存，并在必要时唤醒IO线程，执行这个用户任务回调函数
-                loop_->queueInLoop(boost::bind(writeCompleteCallback_, shared_from_this()));
+                getLoop()->queueInLoop(boost::bind(&TcpConnection::callWriteComplete, shared_from_this()));
             }
         }
         else // nwrote < 0
@@ -244,44 +651,50 @@ void TcpConnection::sendInLoop(const void *data, size_t len)
                 LOG_SYSERR << "TcpConnection::sendInLoop";
                 if (errno == EPIPE || errno == ECONNRESET) // FIXME: any others?
                 {
-                    faultError = true;
+                    *faultError = true;
                 }
             }
         }
     }
+    return implicit_cast<size_t>(nwrote);
+}
 
-    // 代码执行到这里，意味着：outputBuffer_.readableBytes() != 0 ，也就是，outputBuffer_中有待发送的数据
-    // 那就不能执行上面的if语句内部的逻辑，进行先发送数据，因为这会造成数据乱序，
-    // 所以，需要将本次发送的数据，也执行outputBuffer_.append(static_cast<const char *>(data) + nwrote, remaining)，
-    // 保存到outputBuffer_中
-    assert(remaining <= len);
-    if (!faultError && remaining > 0)
+void TcpConnection::updatePendingBytes()
+{
+    size_t len = outputBuffer_.readableBytes();
+    if (len != pendingBytes_)
     {
-        // 获取outputBuffer_中待发送的数据的长度oldLen
-        size_t oldLen = outputBuffer_.readableBytes();
+        getLoop()->addPendingOutputBytes(static_cast<int64_t>(len) - static_cast<int64_t>(pendingBytes_));
+        pendingBytes_ = len;
+    }
+}
 
-        // 高水位回调函数highWaterMarkCallback_的作用：
-        // 1.）输出缓冲区outputBuffer_的作用：
-        //     (1)服务端，将需要发送给客户端的数据，存放到这里，然后发送给客户端
-        //     (2)客户端，将需要发送给服务端的数据，存放到这里，然后发送给服务端
-        // 2.）输出缓冲区outputBuffer_中的待发送数据的长度（可读数据的长度：outputBuffer_.readableBytes()的返回值），
-        //    超过用户指定的大小highWaterMark_，就会调用这个函数，提示发送的数据的数量太大
-        if (oldLen + remaining >= highWaterMark_
-                && oldLen < highWaterMark_
-                && highWaterMarkCallback_)
-        {
-            /// 将需要在IO线程中执行的用户回调函数highWaterMarkCallback_，放入到队列中保存，并在必要时唤醒IO线程，执行这个用户任务回调函数
-            loop_->queueInLoop(boost::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
-        }
-        // 将本次发送的数据data，保存到outputBuffer_中
-        outputBuffer_.append(static_cast<const char *>(data) + nwrote, remaining);
-        // !channel_->isWriting()：channel_上，此时并未正在进行发送数据
-        if (!channel_->isWriting())
-        {
-            /// 在epoll的内核事件监听表中，注册class Channel类，所管理的文件描述符fd_;
-            /// 并让epoll_wait关注其上是否有写事件发生
-            channel_->enableWriting();
-        }
+// 函数参数含义：
+//    size_t oldLen：追加数据之前，outputBuffer_中待发送的数据的长度
+// 函数功能：
+//  （1）outputBuffer_中的待发送数据的长度，超过用户指定的大小highWaterMark_，就调用highWaterMarkCallback_
+//  （2）关注channel_上的写事件，在handleWrite中继续发送outputBuffer_中的数据
+void TcpConnection::outputQueued(size_t oldLen)
+{
+    updatePendingBytes();
+    size_t newLen = outputBuffer_.readableBytes();
+    // 高水位回调函数highWaterMarkCallback_的作用：
+    // 输出缓冲区outputBuffer_中的待发送数据的长度（可读数据的长度：outputBuffer_.readableBytes()的返回值），
+    // 超过用户指定的大小highWaterMark_，就会调用这个函数，提示发送的数据的数量太大
+    if (newLen >= highWaterMark_
+            && oldLen < highWaterMark_
+            && highWaterMarkCallback_)
+    {
+        /// 将需要在IO线程中执行的用户回调函数highWaterMarkCallback_，放入到队列中保存，并在必要时唤醒IO线程，执行这个用户任务回调函数
+        getLoop()->queueInLoop(boost::bind(&TcpConnection::callHighWaterMark, shared_from_this(), newLen));
+    }
+    // !channel_->isWriting()：channel_上，此时并未正在进行发送数据
+    // 正在攒数据时，等uncork再发送
+    if (!channel_->isWriting() && corkDepth_ == 0)
+    {
+        /// 在epoll的内核事件监听表中，注册class Channel类，所管理的文件描述符fd_;
+        /// 并让epoll_wait关注其上是否有写事件发生
+        channel_->enableWriting();
     }
 }
 
@@ -304,7 +717,7 @@ void TcpConnection::shutdown()
         setState(kDisconnecting);
         // FIXME: shared_from_this()?
         // 在IO线程中，执行TcpConnection::shutdownInLoop
-        loop_->runInLoop(boost::bind(&TcpConnection::shutdownInLoop, this));
+        getLoop()->runInLoop(boost::bind(&TcpConnection::shutdownInLoop, this));
     }
 }
 
@@ -317,9 +730,13 @@ void TcpConnection::shutdown()
 // socket_的作用，就是管理（用其内部成员变量保存）服务端进程新创建的套接字的socket文件描述符
 void TcpConnection::shutdownInLoop()
 {
-    // 确保：执行事件循环（EventLoop::loop()）的线程，是IO线程
-    // 即：确保，执行void TcpConnection::shutdownInLoop()函数的线程，是IO线程
-    loop_->assertInLoopThread();
+    // 确保：执行void TcpConnection::shutdownInLoop()函数的线程，是IO线程
+    // 连接迁移到了另一个IO线程时，在旧的IO线程中排队的调用，转交给新的IO线程执行
+    if (!getLoop()->isInLoopThread())
+    {
+        getLoop()->queueInLoop(boost::bind(&TcpConnection::shutdownInLoop, shared_from_this()));
+        return;
+    }
     // （1）socket_的作用：
     // 服务端进程，调用accept函数从处于监听状态的套接字的客户端进程连接请求队列中取出排在最前面的一个客户连接请求，
     // 并且服务端进程，会创建一个新的套接字，来与客户端进程的套接字，创建连接通道
@@ -333,7 +750,8 @@ void TcpConnection::shutdownInLoop()
     // 即：服务端进程，不再向客户端进程，发送数据
     // 2.客户端进程，准备向服务端进程发送数据
     // 即：客户端进程，不再向服务端进程，发送数据
-    if (!channel_->isWriting())
+    // outputBuffer_.empty()：正在攒数据时，outputBuffer_中可能有数据，却没有关注写事件，等uncork发送完再关闭
+    if (!channel_->isWriting() && outputBuffer_.empty())
     {
         // we are not writing
         // 见，游双P81：关闭socket_上的写的这一半，应用程序不可再对该socket_执行写操作
@@ -378,7 +796,7 @@ void TcpConnection::forceClose()
         // 将服务端进程与客户端进程，所建立的连接的连接状态，改为kDisconnecting状态（连接已关闭）
         setState(kDisconnecting);
         /// 将需要在IO线程中执行的用户回调函数TcpConnection::forceCloseInLoop，放入到队列中保存，并在必要时唤醒IO线程，执行这个用户任务回调函数
-        loop_->queueInLoop(boost::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+        getLoop()->queueInLoop(boost::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
     }
 }
 
@@ -403,7 +821,7 @@ void TcpConnection::forceCloseWithDelay(double seconds)
         /// TimerCallback &&cb：定时器的回调函数
         /// 函数功能：
         /// 以当前时间Timestamp::now()为起点，经过delay这么长的时间后，定时器超时，并调用定时器回调函数
-        loop_->runAfter(
+        getLoop()->runAfter(
             seconds,
             makeWeakCallback(shared_from_this(),
                              // TcpConnection::forceClose函数功能：
@@ -417,9 +835,13 @@ void TcpConnection::forceCloseWithDelay(double seconds)
 // 客户端执行此函数：客户端主动关闭，和，服务端建立的连接
 void TcpConnection::forceCloseInLoop()
 {
-    // 确保：执行事件循环（EventLoop::loop()）的线程，是IO线程
-    // 即：确保，执行void TcpConnection::forceCloseInLoop()函数的线程，是IO线程
-    loop_->assertInLoopThread();
+    // 确保：执行void TcpConnection::forceCloseInLoop()函数的线程，是IO线程
+    // 连接迁移到了另一个IO线程时，在旧的IO线程中排队的调用，转交给新的IO线程执行
+    if (!getLoop()->isInLoopThread())
+    {
+        getLoop()->queueInLoop(boost::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+        return;
+    }
 
     /// 客户端与服务端之间，所建立的连接的，状态，为：
     // kConnected：服务端和客户端之间的连接已经建立完毕
@@ -461,14 +883,24 @@ void TcpConnection::setTcpNoDelay(bool on)
     socket_->setTcpNoDelay(on);
 }
 
+bool TcpConnection::setBusyPoll(int usec)
+{
+    return socket_->setBusyPoll(usec);
+}
+
 void TcpConnection::startRead()
 {
-    loop_->runInLoop(boost::bind(&TcpConnection::startReadInLoop, this));
+    getLoop()->runInLoop(boost::bind(&TcpConnection::startReadInLoop, this));
 }
 
 void TcpConnection::startReadInLoop()
 {
-    loop_->assertInLoopThread();
+    // 连接迁移到了另一个IO线程时，在旧的IO线程中排队的调用，转交给新的IO线程执行
+    if (!getLoop()->isInLoopThread())
+    {
+        getLoop()->queueInLoop(boost::bind(&TcpConnection::startReadInLoop, shared_from_this()));
+        return;
+    }
     if (!reading_ || !channel_->isReading())
     {
         channel_->enableReading();
@@ -478,12 +910,17 @@ void TcpConnection::startReadInLoop()
 
 void TcpConnection::stopRead()
 {
-    loop_->runInLoop(boost::bind(&TcpConnection::stopReadInLoop, this));
+    getLoop()->runInLoop(boost::bind(&TcpConnection::stopReadInLoop, this));
 }
 
 void TcpConnection::stopReadInLoop()
 {
-    loop_->assertInLoopThread();
+    // 连接迁移到了另一个IO线程时，在旧的IO线程中排队的调用，转交给新的IO线程执行
+    if (!getLoop()->isInLoopThread())
+    {
+        getLoop()->queueInLoop(boost::bind(&TcpConnection::stopReadInLoop, shared_from_this()));
+        return;
+    }
     if (reading_ || channel_->isReading())
     {
         channel_->disableReading();
@@ -500,13 +937,17 @@ void TcpConnection::connectEstablished()
 {
     // 确保：执行事件循环（EventLoop::loop()）的线程，是IO线程
     // 即：确保，执行void TcpConnection::connectEstablished()函数的线程，是IO线程
-    loop_->assertInLoopThread();
+    getLoop()->assertInLoopThread();
     // 服务端进程与客户端进程，所建立的连接的连接状态，在连接建立之前，为kConnecting正在建立连接状态
     assert(state_ == kConnecting);
 
     // 将服务端进程与客户端进程，所建立的连接的连接状态，改为kConnected状态（连接已建立）
     setState(kConnected);
     channel_->tie(shared_from_this());
+    if (idleWheel_)
+    {
+        idleWheel_->add(this);
+    }
 
     /// 在epoll的内核事件监听表中，注册class Channel类，所管理的文件描述符fd_;
     /// 并让epoll_wait关注其上是否有读事件发生
@@ -541,14 +982,22 @@ void TcpConnection::connectEstablished()
 // （2）客户端进程，执行此函数：彻底断开客户端与服务端建立的TCP连接
 void TcpConnection::connectDestroyed()
 {
-    // 确保：执行事件循环（EventLoop::loop()）的线程，是IO线程
-    // 即：确保，执行void TcpConnection::connectDestroyed()函数的线程，是IO线程
-    loop_->assertInLoopThread();
+    // 确保：执行void TcpConnection::connectDestroyed()函数的线程，是IO线程
+    // 连接迁移到了另一个IO线程时，在旧的IO线程中排队的调用，转交给新的IO线程执行
+    if (!getLoop()->isInLoopThread())
+    {
+        getLoop()->queueInLoop(boost::bind(&TcpConnection::connectDestroyed, shared_from_this()));
+        return;
+    }
     // 服务端进程与客户端进程，所建立的连接的连接状态，在连接断开之前，为kConnected已连接状态
     if (state_ == kConnected)
     {
         // 将服务端进程与客户端进程，所建立的连接的连接状态，改为kDisconnected状态（连接已断开）
         setState(kDisconnected);
+        if (idleWheel_)
+        {
+            idleWheel_->remove(this);
+        }
 
         // （1）socket_的作用：
         //      1.1）第一个作用
@@ -581,6 +1030,16 @@ void TcpConnection::connectDestroyed()
         connectionCallback_(shared_from_this());
     }
 
+    // 连接已断开，不会再收发数据了，把租用的缓冲区都归还给缓冲区池
+    // 析构函数可能在其他线程中执行，不能在那里归还
+    outputBuffer_.retrieveAll();
+    updatePendingBytes();
+    if (inputBuffer_)
+    {
+        inputBuffer_->retrieveAll();
+        releaseInputBuffer();
+    }
+
     /// ====================================================================================================
     /// 在，class PollPoller IO复用的封装：封装了poll，中的功能
     /// ====================================================================================================
@@ -611,6 +1070,117 @@ void TcpConnection::connectDestroyed()
     channel_->remove();
 }
 
+// 有读写时，只记下IdleWheel当前的秒数，不移动链表，到期检查时再按这个秒数移动
+void TcpConnection::touchIdle()
+{
+    if (idleWheel_)
+    {
+        idleTouched_ = idleWheel_->now();
+    }
+}
+
+bool TcpConnection::migrateInLoop(EventLoop *newLoop, const ConnectionCallback &migratedCb)
+{
+    EventLoop *oldLoop = getLoop();
+    oldLoop->assertInLoopThread();
+    if (newLoop == oldLoop || state_ != kConnected || migrating_)
+    {
+        return false;
+    }
+    // 从旧的IO线程的IdleWheel中取出，由migratedCb放入新的IO线程的IdleWheel
+    if (idleWheel_)
+    {
+        idleWheel_->remove(this);
+    }
+    bool writing = channel_->isWriting();
+    // 从旧的Poller中删除，就绪链表中的channel_也一起删除，新的Poller注册时会重新报告就绪的事件
+    channel_->disableAll();
+    channel_->remove();
+    channel_->setOwnerLoop(newLoop);
+    // 缓冲区池不是线程安全的：loop_一旦指向newLoop，其他线程就可能在newLoop中执行sendInLoop，
+    // 所以在这之前换成newLoop的缓冲区池，已经租用的数据块、输入缓冲区，转给newLoop的缓冲区池，以后还给它
+    BufferPool *newPool = newLoop->bufferPool();
+    outputBuffer_.setBufferPool(newPool);
+    if (inputBuffer_)
+    {
+        oldLoop->bufferPool()->transfer(inputBuffer_, newPool);
+    }
+    // 负载计数跟着连接走
+    oldLoop->addConnectionCount(-1);
+    oldLoop->addPendingOutputBytes(-static_cast<int64_t>(pendingBytes_));
+    newLoop->addConnectionCount(1);
+    newLoop->addPendingOutputBytes(static_cast<int64_t>(pendingBytes_));
+    LOG_DEBUG << "TcpConnection::migrateInLoop [" << name_ << "] fd=" << channel_->fd()
+              << " pending=" << pendingBytes_;
+    migrating_ = true;
+    // 先修改loop_，再排队attachInLoop，attachInLoop执行时一定能看到newLoop，不需要等待
+    // 修改loop_之后，在旧的IO线程中排队的、本连接的操作，都会转交给newLoop，
+    // 之后旧的IO线程不能再访问本连接的状态
+    // 其他线程看到newLoop之后放入的操作，可能先于attachInLoop执行：send的数据由attachInLoop检查，
+    // startRead()/stopRead()修改的reading_由attachInLoop恢复，再次迁移由migrating_拒绝
+    TcpConnectionPtr self(shared_from_this());
+    __atomic_store_n(&loop_, newLoop, __ATOMIC_RELEASE);
+    newLoop->queueInLoop(
+        boost::bind(&TcpConnection::attachInLoop, self, newLoop, writing, migratedCb));
+    return true;
+}
+
+void TcpConnection::attachInLoop(EventLoop *newLoop, bool writing, const ConnectionCallback &migratedCb)
+{
+    newLoop->assertInLoopThread();
+    // 迁移完成之前不会再次迁移，loop_还是newLoop
+    assert(getLoop() == newLoop);
+    migrating_ = false;
+    // 迁移途中，连接可能已经在新的IO线程中被关闭了
+    if (state_ != kDisconnected)
+    {
+        // 迁移途中，新的IO线程中的startRead()/stopRead()可能已经修改了reading_
+        if (reading_ && !channel_->isReading())
+        {
+            channel_->enableReading();
+        }
+        // 迁移途中，新的IO线程中的send可能已经把数据发完了，或者已经关注了写事件
+        if (writing && !outputBuffer_.empty() && !channel_->isWriting())
+        {
+            channel_->enableWriting();
+        }
+        if (!channel_->isReading() && !channel_->isWriting())
+        {
+            // 也注册到新的Poller中，connectDestroyed()时才能remove()
+            channel_->disableAll();
+        }
+    }
+    migratedCb(shared_from_this());
+}
+
+int64_t TcpConnection::sampleWakeups()
+{
+    getLoop()->assertInLoopThread();
+    int64_t n = readStats_.wakeups - sampledWakeups_;
+    sampledWakeups_ = readStats_.wakeups;
+    return n;
+}
+
+void TcpConnection::callWriteComplete()
+{
+    if (!getLoop()->isInLoopThread())
+    {
+        getLoop()->queueInLoop(boost::bind(&TcpConnection::callWriteComplete, shared_from_this()));
+        return;
+    }
+    writeCompleteCallback_(shared_from_this());
+}
+
+void TcpConnection::callHighWaterMark(size_t len)
+{
+    if (!getLoop()->isInLoopThread())
+    {
+        getLoop()->queueInLoop(boost::bind(&TcpConnection::callHighWaterMark, shared_from_this(), len));
+        return;
+    }
+    highWaterMarkCallback_(shared_from_this(), len);
+}
+
 // （1）第一个作用
 // 套接字socket_(其内部成员变量：sockfd_)，上有可读事件发生时，
 // 读事件的事件处理函数为void TcpConnection::handleRead()
@@ -625,50 +1195,183 @@ void TcpConnection::handleRead(Timestamp receiveTime)
 {
     // 确保：执行事件循环（EventLoop::loop()）的线程，是IO线程
     // 即：确保，执行void TcpConnection::handleRead()函数的线程，是IO线程
-    loop_->assertInLoopThread();
-    int savedErrno = 0;
-    // inputBuffer_输入缓冲区：
-    // (1)服务端，用于接收客户端发送过来的数据
-    // (2)客户端，用于接收服务端发送过来的数据
-    // （1）服务端进程，读取，接收到的客户端进程发来的数据，
-    //      并将读取到的数据，存放到inputBuffer_中
-    // （2）客户端进程，读取，接收到的服务端进程发来的数据，
-    //      并将读取到的数据，存放到inputBuffer_中
-    ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
-    if (n > 0)// （1）服务端进程，从channel_->fd中读取到，客户端进程发来的数据
-    {
-        // （2）客户端进程，从channel_->fd中读取到，服务端进程发来的数据
-        // （1）服务端进程，使用消息回调函数messageCallback_，处理inputBuffer_中存放的，
-        //      服务端进程，接收到的客户端进程发来的数据
-        // （2）客户端进程，使用消息回调函数messageCallback_，处理inputBuffer_中存放的，
-        //      客户端进程，接收到的服务端进程发来的数据
-        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
-    }
-    else if (n == 0)// （1）服务端进程，从channel_->fd中未读取到，客户端进程发来的数据
-    {
-        //      意味着：客户端进程，主动关闭了TCP连接，
-        //      因此，服务端进程，需要执行handleClose函数，进行被动关闭TCP连接
-        // （2）客户端进程，从channel_->fd中未读取到，服务端进程发来的数据
-        //      意味着：服务端进程，主动关闭了TCP连接，
-        //      因此，客户端进程，需要执行handleClose函数，进行被动关闭TCP连接
+    getLoop()->assertInLoopThread();
+    touchIdle();
+    ++readStats_.wakeups;
+    // messageCallback_中多次send的数据，攒起来，读完之后一次发送
+    bool corked = corkDuringRead_;
+    if (corked)
+    {
+        cork();
+    }
+    // total：记录本次可读事件中，总共读取了多少数据
+    size_t total = 0;
+    bool readAgain = true;
+    // 按照读策略readPolicy_，一次可读事件中，可能读取多次
+    while (readAgain)
+    {
+        int savedErrno = 0;
+        // inputBuffer_输入缓冲区：
+        // (1)服务端，用于接收客户端发送过来的数据
+        // (2)客户端，用于接收服务端发送过来的数据
+        // 延迟分配模式下，没有未处理完的数据时，读到IO线程共享的缓冲区中，
+        // 处理完之后，还剩下不完整的消息时，才让本连接拥有私有的输入缓冲区
+        bool useScratch = lazyInputBuffer_ && !inputBuffer_;
+        if (useScratch)
+        {
+            inputBuffer_ = getLoop()->bufferPool()->scratch();
+        }
+        else if (!inputBuffer_)
+        {
+            // 按照最近几次读取的数据量，租用大小合适的缓冲区
+            inputBuffer_ = getLoop()->bufferPool()->acquire(readSizeHint_);
+        }
+        else
+        {
+            inputBuffer_->ensureWritableBytes(readSizeHint_);
+        }
+        // writable：inputBuffer_中的可写空间，读取的数据超过它时，多出来的部分先读到栈上的extrabuf中，再拷贝过来
+        // capacity：本次最多能读取多少数据，可写空间不小于extrabuf时，readFd不使用extrabuf
+        size_t writable = inputBuffer_->writableBytes();
+        size_t capacity = writable < Buffer::kExtraBufSize ? writable + Buffer::kExtraBufSize : writable;
+        // （1）服务端进程，读取，接收到的客户端进程发来的数据，
+        //      并将读取到的数据，存放到inputBuffer_中
+        // （2）客户端进程，读取，接收到的服务端进程发来的数据，
+        //      并将读取到的数据，存放到inputBuffer_中
+        ssize_t n = inputBuffer_->readFd(channel_->fd(), &savedErrno);
+        if (n > 0)// （1）服务端进程，从channel_->fd中读取到，客户端进程发来的数据
+        {
+            // （2）客户端进程，从channel_->fd中读取到，服务端进程发来的数据
+            size_t nread = implicit_cast<size_t>(n);
+            ++readStats_.reads;
+            readStats_.bytes += n;
+            if (nread > writable)
+            {
+                ++readStats_.spills;
+            }
+            adjustReadSizeHint(nread);
+            total += nread;
+            // （1）服务端进程，使用消息回调函数messageCallback_，处理inputBuffer_中存放的，
+            //      服务端进程，接收到的客户端进程发来的数据
+            // （2）客户端进程，使用消息回调函数messageCallback_，处理inputBuffer_中存放的，
+            //      客户端进程，接收到的服务端进程发来的数据
+            messageCallback_(shared_from_this(), get_pointer(inputBuffer_), receiveTime);
+            if (!useScratch)
+            {
+                // 数据都处理完了，归还输入缓冲区
+                releaseInputBuffer();
+            }
+            // 没有读满capacity，说明内核接收缓冲区已经读空了，不必再读一次，等到EAGAIN
+            if (edgeTriggered_)
+            {
+                // 边沿触发：没有读空之前，不会再有可读事件，读满drainBudget_时，下一轮再读
+                readAgain = nread == capacity && state_ == kConnected && reading_;
+                if (readAgain && total >= drainBudget_)
+                {
+                    channel_->markReadReady();
+                    readAgain = false;
+                }
+            }
+            else
+            {
+                readAgain = readPolicy_ != kReadOnce
+                            && nread == capacity
+                            && (readPolicy_ != kReadBudget || total < readBudget_)
+                            && state_ == kConnected
+                            && reading_;
+            }
+        }
+        else if (n == 0)// （1）服务端进程，从channel_->fd中未读取到，客户端进程发来的数据
+        {
+            //      意味着：客户端进程，主动关闭了TCP连接，
+            //      因此，服务端进程，需要执行handleClose函数，进行被动关闭TCP连接
+            // （2）客户端进程，从channel_->fd中未读取到，服务端进程发来的数据
+            //      意味着：服务端进程，主动关闭了TCP连接，
+            //      因此，客户端进程，需要执行handleClose函数，进行被动关闭TCP连接
+            handleClose();
+            readAgain = false;
+        }
+        else
+        {
+            // 读了多次之后，内核接收缓冲区空了，不是错误，
+            // 边沿触发时，上一次正好读空了，从就绪链表中来的这一次也会读到EAGAIN
+            if ((total == 0 && !edgeTriggered_) || savedErrno != EWOULDBLOCK)
+            {
+                errno = savedErrno;
+                LOG_SYSERR << "TcpConnection::handleRead";
+                // （1）服务端进程，从channel_->fd中读取，客户端进程发来的数据时，出现了错误
+                // （2）客户端进程，从channel_->fd中读取，服务端进程发来的数据时，出现了错误
+                handleError();
+            }
+            readAgain = false;
+        }
 
-        // （1）第一个作用
-        // 服务端进程，从套接字socket_(其内部成员变量：sockfd_)中未读取到，客户端进程发来的数据
-        // 意味着：客户端进程，主动关闭了TCP连接，
-        // 因此，服务端进程，需要执行handleClose函数，进行被动关闭TCP连接
-        // （2）第二个作用
-        // 客户端进程，从套接字socket_(其内部成员变量：sockfd_)中未读取到，服务端进程发来的数据
-        // 意味着：服务端进程，主动关闭了TCP连接，
-        // 因此，客户端进程，需要执行handleClose函数，进行被动关闭TCP连接
-        handleClose();
+        if (useScratch)
+        {
+            detachScratchBuffer();
+        }
+    }
+
+    if (corked)
+    {
+        uncork();
+    }
+}
+
+// 函数参数含义：
+//    size_t nread：本次读取到的数据的长度
+// 函数功能：
+//  根据最近读取的数据量，调整下次读取之前，inputBuffer_中至少要预留的可写空间readSizeHint_
+//  （1）读满了，加倍，减少数据溢出到extrabuf中再拷贝的次数
+//  （2）连续两次读取的数据量不到一半，减半，空闲的连接不占用大缓冲区
+void TcpConnection::adjustReadSizeHint(size_t nread)
+{
+    if (nread >= readSizeHint_)
+    {
+        readSizeHint_ = std::min(readSizeHint_ * 2, kMaxReadSizeHint);
+        readSizeShrinking_ = false;
+    }
+    else if (nread < readSizeHint_ / 2)
+    {
+        if (readSizeShrinking_)
+        {
+            readSizeHint_ = std::max(readSizeHint_ / 2, kMinReadSizeHint);
+            readSizeShrinking_ = false;
+        }
+        else
+        {
+            readSizeShrinking_ = true;
+        }
     }
     else
     {
-        errno = savedErrno;
-        LOG_SYSERR << "TcpConnection::handleRead";
-        // （1）服务端进程，从channel_->fd中读取，客户端进程发来的数据时，出现了错误
-        // （2）客户端进程，从channel_->fd中读取，服务端进程发来的数据时，出现了错误
-        handleError();
+        readSizeShrinking_ = false;
+    }
+}
+
+// 延迟分配模式下，handleRead处理完共享缓冲区中的数据之后执行：
+//  （1）数据都处理完了，本连接不再持有任何输入缓冲区
+//  （2）剩下的不完整的消息很短，拷贝到从缓冲区池中租用的小缓冲区中
+//  （3）剩下的不完整的消息很长，直接拿走共享缓冲区，IO线程下次再租用一个新的
+void TcpConnection::detachScratchBuffer()
+{
+    BufferPool *pool = getLoop()->bufferPool();
+    assert(inputBuffer_ == pool->scratch());
+    size_t remaining = inputBuffer_->readableBytes();
+    if (remaining == 0)
+    {
+        inputBuffer_.reset();
+    }
+    else if (remaining <= kMaxCopyOnDetach)
+    {
+        BufferPtr buf = pool->acquire(remaining);
+        buf->append(inputBuffer_->peek(), remaining);
+        inputBuffer_->retrieveAll();
+        inputBuffer_.swap(buf);
+    }
+    else
+    {
+        inputBuffer_ = pool->takeScratch();
     }
 }
 
@@ -686,18 +1389,40 @@ void TcpConnection::handleWrite()
 {
     // 确保：执行事件循环（EventLoop::loop()）的线程，是IO线程
     // 即：确保，执行void TcpConnection::handleWrite()函数的线程，是IO线程
-    loop_->assertInLoopThread();
+    getLoop()->assertInLoopThread();
+    touchIdle();
     if (channel_->isWriting())// 可以发送数据
     {
         // outputBuffer_输出缓冲区：
         // (1)服务端，将需要发送给客户端的数据，存放到这里，然后发送给客户端
         // (2)客户端，将需要发送给服务端的数据，存放到这里，然后发送给服务端
-        ssize_t n = sockets::write(channel_->fd(),
-                                   outputBuffer_.peek(),
-                                   outputBuffer_.readableBytes());
+        // 使用writev，一次发送outputBuffer_中的多个数据块，已发送的数据块会被释放
+        int savedErrno = 0;
+        ssize_t n = outputBuffer_.writeFd(channel_->fd(), &savedErrno);
+        if (edgeTriggered_)
+        {
+            // 边沿触发：没有写到EAGAIN之前，不会再有可写事件，写满drainBudget_时，下一轮再写
+            size_t written = 0;
+            while (n > 0 && !outputBuffer_.empty())
+            {
+                written += implicit_cast<size_t>(n);
+                if (written >= drainBudget_)
+                {
+                    channel_->markWriteReady();
+                    break;
+                }
+                n = outputBuffer_.writeFd(channel_->fd(), &savedErrno);
+            }
+            updatePendingBytes();
+            if (n < 0 && savedErrno == EWOULDBLOCK)
+            {
+                // 内核发送缓冲区满了，等下一次可写事件
+                return;
+            }
+        }
+        updatePendingBytes();
         if (n > 0)// outputBuffer_中存放的剩余数据（sendInLoop函数执行后，未发送完成的数据），发送成功
         {
-            outputBuffer_.retrieve(n);
             // outputBuffer_中的所有的数据，都发送完毕
             if (outputBuffer_.readableBytes() == 0)
             {
@@ -712,7 +1437,7 @@ void TcpConnection::handleWrite()
                 if (writeCompleteCallback_)
                 {
                     /// 将需要在IO线程中执行的用户回调函数writeCompleteCallback_，放入到队列中保存，并在必要时唤醒IO线程，执行这个用户任务回调函数
-                    loop_->queueInLoop(boost::bind(writeCompleteCallback_, shared_from_this()));
+                    getLoop()->queueInLoop(boost::bind(&TcpConnection::callWriteComplete, shared_from_this()));
                 }
                 // 正在关闭服务端和客户端之间的TCP连接
                 if (state_ == kDisconnecting)
@@ -722,9 +1447,19 @@ void TcpConnection::handleWrite()
                 }
             }
         }
+        else if (savedErrno == EIO)
+        {
+            abortOutput("TcpConnection::handleWrite");
+        }
         else
         {
+            errno = savedErrno;
             LOG_SYSERR << "TcpConnection::handleWrite";
+            // 文件比sendFile声明的短，剩余部分已被丢弃，没有数据可发送了
+            if (outputBuffer_.empty())
+            {
+                channel_->disableWriting();
+            }
             // if (state_ == kDisconnecting)
             // {
             //   shutdownInLoop();
@@ -750,11 +1485,15 @@ void TcpConnection::handleClose()
 {
     // 确保：执行事件循环（EventLoop::loop()）的线程，是IO线程
     // 即：确保，执行void TcpConnection::handleClose()函数的线程，是IO线程
-    loop_->assertInLoopThread();
+    getLoop()->assertInLoopThread();
     LOG_TRACE << "fd = " << channel_->fd() << " state = " << stateToString();
     assert(state_ == kConnected || state_ == kDisconnecting);
     // we don't close fd, leave it to dtor, so we can find leaks easily.
     setState(kDisconnected);
+    if (idleWheel_)
+    {
+        idleWheel_->remove(this);
+    }
     // （1）socket_的作用：
     //      1.1）第一个作用
     //           服务端进程，调用accept函数从处于监听状态的套接字的客户端进程连接请求队列中取出排在最前面的一个客户连接请求，
@@ -11,10 +11,13 @@
 #ifndef MUDUO_NET_TCPCONNECTION_H
 #define MUDUO_NET_TCPCONNECTION_H
 
+#include <muduo/base/Atomic.h>
+#include <muduo/base/MpscQueue.h>
 #include <muduo/base/StringPiece.h>
 #include <muduo/base/Types.h>
 #include <muduo/net/Callbacks.h>
 #include <muduo/net/Buffer.h>
+#include <muduo/net/BufferChain.h>
 #include <muduo/net/InetAddress.h>
 
 #include <boost/any.hpp>
@@ -33,6 +36,7 @@ namespace muduo
 
         class Channel;
         class EventLoop;
+        class IdleWheel;
         class Socket;
 
         ///
@@ -56,9 +60,10 @@ namespace muduo
                           const InetAddress &peerAddr);
             ~TcpConnection();
 
+            // 连接可能被迁移到别的IO线程，loop_用__atomic访问，其他线程也能读到完整的、最新的值
             EventLoop *getLoop() const
             {
-                return loop_;
+                return __atomic_load_n(&loop_, __ATOMIC_ACQUIRE);
             }
             const string &name() const
             {
@@ -107,7 +112,28 @@ namespace muduo
             // 函数功能：
             //  （1）客户端执行这个函数，将buf中的数据，发送给服务端
             //  （2）服务端执行这个函数，将buf中的数据，发送给客户端
-            void send(Buffer *message);  // this one will swap data
+            //  （3）不拷贝数据：没有立即发送完的数据，通过swap交给输出缓冲区，buf被清空，
+            //      在IO线程中调用时，buf换到一块从缓冲区池租来的、容量差不多的缓冲区，容量不变，
+            //      在其他线程中调用时，buf换到一个空的缓冲区
+            void send(Buffer *message);
+
+            // 函数参数含义：
+            //    const BufferPtr &message：需要发送的数据，都存放都这里了
+            // 函数功能：
+            //  （1）不拷贝数据，直接把message挂到输出缓冲区outputBuffer_的链表末尾
+            //  （2）message可以同时发送给多个连接，发送完成之前，调用者不可以再修改message
+            void send(const BufferPtr &message);
+
+            // 函数参数含义：
+            //    int fd：需要发送的文件（普通文件）的文件描述符
+            //    off_t offset：从文件的这个位置开始发送
+            //    size_t length：需要发送的字节数
+            // 函数功能：
+            //  （1）与其他send按调用顺序排队，由sendfile(2)在内核中直接发送，不经过用户空间
+            //  （2）内部会dup一份fd，调用者返回后即可关闭fd，但在发送完成之前，不可截断文件，
+            //       文件比length短时，对端收到的数据接不上了，连接会被强制关闭（forceClose），不调用写完成回调
+            //  （3）length计入outputBuffer_的待发送数据长度，高水位回调和写完成回调照常触发
+            void sendFile(int fd, off_t offset, size_t length);
 
             // （1）设置：服务端进程与客户端进程，所建立的连接的连接状态
             // 为：kDisconnecting，正在关闭服务端和客户端之间的TCP连接，状态
@@ -132,6 +158,22 @@ namespace muduo
             // （2）以当前时间Timestamp::now()为起点，经过delay这么长的时间后，调用TcpConnection::forceClose函数
             void forceCloseWithDelay(double seconds);
             void setTcpNoDelay(bool on);
+            // 设置SO_BUSY_POLL，与EventLoop::setBusyPollUsec配合使用，降低接收延迟
+            bool setBusyPoll(int usec);
+
+            // 攒数据：cork之后，send的数据都只追加到outputBuffer_中，uncork时用一次writev全部发送，
+            // 例如先后send消息头、消息体、消息尾，只需要一次系统调用
+            // 可以嵌套调用，只能在IO线程中调用
+            void cork();
+            void uncork();
+
+            // 打开之后，handleRead在调用messageCallback_之前cork，读完之后uncork，
+            // messageCallback_中的多次send，合并为一次writev，只能在IO线程中调用
+            void setCorkDuringRead(bool on);
+
+            // 打开之后，cork期间同时设置TCP_CORK，
+            // 适合sendFile和其他send混合使用时，让内核也只发送满的报文段，只能在IO线程中调用
+            void setKernelCork(bool on);
             // reading or not
             void startRead();
             void stopRead();
@@ -140,6 +182,58 @@ namespace muduo
                 return reading_;
             }; // NOT thread safe, may race with start/stopReadInLoop
 
+            // 延迟分配输入缓冲区模式，只能在IO线程中调用，例如在connectionCallback_中
+            // 打开之后，没有未处理完的数据时，数据读到IO线程共享的缓冲区中，交给messageCallback_处理，
+            // 处理完之后，还剩下不完整的消息时，本连接才拥有私有的输入缓冲区，
+            // 适合长时间空闲、每次只收到完整短消息的连接（长轮询、推送）
+            void setLazyInputBuffer(bool on);
+
+            // 读策略：一次可读事件中，读取几次
+            enum ReadPolicy
+            {
+                // 只读一次，没读完的数据，等下一次可读事件
+                kReadOnce,
+                // 一直读，直到内核接收缓冲区读空，适合大量传输数据的连接
+                kReadUntilEmpty,
+                // 一直读，直到读空，或者读取的数据量达到budget
+                kReadBudget,
+            };
+
+            // 设置读策略，只能在IO线程中调用，例如在connectionCallback_中
+            void setReadPolicy(ReadPolicy policy, size_t budget = 0);
+
+            // 边沿触发模式，只能在IO线程中调用，例如在connectionCallback_中，只有EPollPoller支持
+            // 打开之后，每次可读（可写）事件都读（写）到EAGAIN为止，读策略不再起作用，
+            // 一次事件中读或写的数据量达到drainBudget时，先让给其他连接，
+            // 剩下的在下一轮事件循环中继续，不用等epoll_wait再次返回
+            static const size_t kDefaultDrainBudget = 256 * 1024;
+            void setEdgeTriggered(bool on, size_t drainBudget = kDefaultDrainBudget);
+
+            // 读数据的统计信息，NOT thread safe
+            struct ReadStats
+            {
+                ReadStats()
+                    : wakeups(0),
+                      reads(0),
+                      bytes(0),
+                      spills(0)
+                {
+                }
+
+                // 可读事件的次数
+                int64_t wakeups;
+                // 调用readv的次数
+                int64_t reads;
+                int64_t bytes;
+                // inputBuffer_的可写空间不够，数据溢出到extrabuf中，再拷贝到inputBuffer_中的次数
+                int64_t spills;
+            };
+
+            const ReadStats &readStats() const
+            {
+                return readStats_;
+            }
+
             void setContext(const boost::any &context)
             {
                 context_ = context;
@@ -177,12 +271,15 @@ namespace muduo
             }
 
             /// Advanced interface
-            Buffer *inputBuffer()
-            {
-                return &inputBuffer_;
-            }
-
-            Buffer *outputBuffer()
+            // 输入缓冲区是从IO线程的缓冲区池中租用的，没有数据时不占内存，
+            // 调用这个函数时，如果还没有租用，就租用一个，只能在IO线程中调用
+            Buffer *inputBuffer();
+
+            // 不兼容的修改：以前返回Buffer*，现在返回BufferChain*
+            // 输出缓冲区改成了多个chunk的链表之后，不能再得到一段连续的内存，没有peek()，
+            // readableBytes()、retrieve()、retrieveAll()、append()的含义不变，
+            // 需要查看待发送数据内容的代码，要改成在send之前自己保存一份
+            BufferChain *outputBuffer()
             {
                 return &outputBuffer_;
             }
@@ -193,6 +290,25 @@ namespace muduo
                 closeCallback_ = cb;
             }
 
+            /// Internal use only.
+            // TcpServer设置了空闲超时时，在connectEstablished()之前设置，连接建立后放入这个IO线程的IdleWheel
+            void setIdleWheel(IdleWheel *wheel)
+            {
+                idleWheel_ = wheel;
+            }
+
+            /// Internal use only.
+            // 把已建立的连接迁移到newLoop，在当前的IO线程中调用，不能在本连接的回调函数中调用
+            // channel_从当前的Poller中删除，交给newLoop重新注册，输入、输出缓冲区和context_都不变，
+            // 迁移之后，还在旧的IO线程中排队的、本连接的操作，会转交给newLoop执行，不会丢失数据
+            // 在newLoop中重新关注读写事件之后，调用migratedCb
+            // 连接不是kConnected状态、newLoop就是当前的IO线程、或者上一次迁移还没有在新的IO线程中完成时，返回false
+            bool migrateInLoop(EventLoop *newLoop, const ConnectionCallback &migratedCb);
+
+            /// Internal use only.
+            // 上次调用以来，可读事件的次数，TcpServer的rebalancer用来找最活跃的连接，在IO线程中调用
+            int64_t sampleWakeups();
+
             // called when TcpServer accepts a new connection
             // 服务端执行这个函数：使客户端和服务端，真正建立起连接
             void connectEstablished();   // should be called only once
@@ -280,6 +396,32 @@ namespace muduo
             //  （1）客户端执行这个函数，将data中的数据，发送给服务端
             //  （2）服务端执行这个函数，将data中的数据，发送给客户端
             void sendInLoop(const void *message, size_t len);
+            void sendBufferInLoop(const BufferPtr &message);
+            void sendFileInLoop(int fd, off_t offset, size_t length,
+                                const boost::shared_ptr<void> &file);
+
+            // outputBuffer_中没有待发送的数据时，直接调用write发送数据，
+            // 返回：本次直接发送出去的数据的长度
+            size_t writeDirectly(const void *data, size_t len, bool *faultError);
+            // 数据追加到outputBuffer_之后调用：检查高水位，并关注channel_上的写事件
+            void outputQueued(size_t oldLen);
+            // outputBuffer_的长度变化后，更新loop_->pendingOutputBytes()
+            void updatePendingBytes();
+            void flushOutput();
+            // sendFile的文件比声明的短（writeFd返回EIO），后面的数据已经接不上了，
+            // 丢弃outputBuffer_，强制关闭连接，而不是让对端收到一个被截断的数据流
+            void abortOutput(const char *where);
+            struct PendingSend;
+            void queueSend(const PendingSend &pending);
+            void drainSendQueue();
+
+            // 有读写时，记下IdleWheel当前的秒数，只是一次赋值，不移动链表
+            void touchIdle();
+            // 迁移之后，在新的IO线程中重新关注读写事件
+            void attachInLoop(EventLoop *newLoop, bool writing, const ConnectionCallback &migratedCb);
+            // queueInLoop的writeCompleteCallback_和highWaterMarkCallback_，连接迁移之后，在新的IO线程中调用
+            void callWriteComplete();
+            void callHighWaterMark(size_t len);
 
             // （1）设置：服务端进程与客户端进程，所建立的连接的连接状态
             // 为：kDisconnecting，正在关闭服务端和客户端之间的TCP连接，状态
@@ -300,13 +442,42 @@ namespace muduo
             const char *stateToString() const;
             void startReadInLoop();
             void stopReadInLoop();
+            // 输入缓冲区inputBuffer_中没有数据时，把它归还给loop_->bufferPool()
+            void releaseInputBuffer();
+            void detachScratchBuffer();
+
+            // 剩下的不完整的消息不超过这么长时，拷贝出来，而不是拿走整个共享缓冲区
+            static const size_t kMaxCopyOnDetach = 4096;
+            void adjustReadSizeHint(size_t nread);
+            static const size_t kMinReadSizeHint = 1024;
+            static const size_t kMaxReadSizeHint = 65536;
 
+            // 只在migrateInLoop中修改（release），其他地方都通过getLoop()读取（acquire）
             EventLoop *loop_;
+            // migrateInLoop之后、attachInLoop之前为true，这期间不能再次迁移
+            bool migrating_;
             const string name_;
 
             /// 记录：客户端与服务端之间，所建立的连接的，状态
             StateE state_;  // FIXME: use atomic variable
             bool reading_;
+            bool lazyInputBuffer_;
+            ReadPolicy readPolicy_;
+            size_t readBudget_;
+            // 下次读取之前，inputBuffer_中至少要预留的可写空间，根据最近读取的数据量调整
+            size_t readSizeHint_;
+            bool readSizeShrinking_;
+            ReadStats readStats_;
+            // cork的嵌套层数，大于0时，send的数据只追加到outputBuffer_中
+            int corkDepth_;
+            bool corkDuringRead_;
+            bool kernelCork_;
+            bool edgeTriggered_;
+            size_t drainBudget_;
+            // 非IO线程send的数据，先放到这里，IO线程每次事件循环一次性取走
+            MpscQueue<PendingSend> sendQueue_;
+            // 是否已经queueInLoop了drainSendQueue
+            AtomicInt32 sendQueueScheduled_;
 
             // we don't expose those classes to client.
             // （1）第一个作用
@@ -407,17 +578,33 @@ namespace muduo
             // 输入缓冲区：
             // (1)服务端，用于接收客户端发送过来的数据
             // (2)客户端，用于接收服务端发送过来的数据
-            Buffer inputBuffer_;
+            // 读数据之前，从loop_->bufferPool()中租用，数据被处理完（变空）后，立即归还，
+            // 所以，空闲的连接，inputBuffer_为NULL，不占用缓冲区内存
+            BufferPtr inputBuffer_;
 
             // 输出缓冲区：
             // (1)服务端，将需要发送给客户端的数据，存放到这里，然后发送给客户端
             // (2)客户端，将需要发送给服务端的数据，存放到这里，然后发送给服务端
-            Buffer outputBuffer_; // FIXME: use list<Buffer> as output buffer.
+            // 由多个数据块组成的链表，在handleWrite中使用writev一次发送多个数据块
+            BufferChain outputBuffer_;
 
             // 相当于java netty中的ChannelHandlerContext
             // 在这里，实现对，收到的数据，进行进一步处理
             // 可以看下http文件夹中的代码，进行理解
             boost::any context_;
+
+            // 空闲连接检查，见IdleWheel，由IdleWheel维护
+            friend class IdleWheel;
+            IdleWheel *idleWheel_;
+            TcpConnection *idlePrev_;
+            TcpConnection *idleNext_;
+            int idleBucket_;        // 所在的桶，-1表示不在IdleWheel中
+            int64_t idleTouched_;   // 最后一次读写时，IdleWheel的秒数
+
+            // 已经计入loop_->pendingOutputBytes()的，outputBuffer_的长度
+            size_t pendingBytes_;
+            // 上次sampleWakeups()时，readStats_.wakeups的值
+            int64_t sampledWakeups_;
         };
 
         typedef boost::shared_ptr<TcpConnection> TcpConnectionPtr;
@@ -8,19 +8,49 @@
 
 #include <muduo/net/TcpServer.h>
 
+#include <muduo/base/CountDownLatch.h>
 #include <muduo/base/Logging.h>
+#include <muduo/base/Mutex.h>
 #include <muduo/net/Acceptor.h>
 #include <muduo/net/EventLoop.h>
 #include <muduo/net/EventLoopThreadPool.h>
+#include <muduo/net/IdleWheel.h>
 #include <muduo/net/SocketsOps.h>
 
 #include <boost/bind.hpp>
 
+#include <algorithm>
+#include <functional>
 #include <stdio.h>  // snprintf
 
 using namespace muduo;
 using namespace muduo::net;
 
+struct TcpServer::LoopAcceptor
+{
+    LoopAcceptor(EventLoop *ioLoop, const InetAddress &listenAddr)
+        : loop(ioLoop),
+          acceptor(new Acceptor(ioLoop, listenAddr, true))
+    {
+    }
+
+    EventLoop *loop;
+    boost::scoped_ptr<Acceptor> acceptor;
+    // 这个Acceptor接受的连接，只在loop中使用
+    ConnectionMap connections;
+};
+
+struct TcpServer::Lifeline
+{
+    explicit Lifeline(TcpServer *s)
+        : server(s)
+    {
+    }
+
+    MutexLock mutex;
+    TcpServer *server;  // guarded by mutex，析构时置为NULL
+};
+
 TcpServer::TcpServer(EventLoop *loop,
                      const InetAddress &listenAddr,
                      const string &nameArg,
@@ -28,14 +58,22 @@ TcpServer::TcpServer(EventLoop *loop,
     : loop_(CHECK_NOTNULL(loop)),
       ipPort_(listenAddr.toIpPort()),
       name_(nameArg),
-      acceptor_(new Acceptor(loop, listenAddr, option == kReusePort)),
+      acceptor_(new Acceptor(loop, listenAddr, option != kNoReusePort)),
       threadPool_(new EventLoopThreadPool(loop, name_)),
       connectionCallback_(defaultConnectionCallback),
       messageCallback_(defaultMessageCallback),
-      nextConnId_(1)
+      acceptorPerLoop_(option == kReusePortPerLoop),
+      listenAddr_(listenAddr),
+      acceptBudget_(Acceptor::kDefaultAcceptBudget),
+      idleTimeout_(0),
+      rebalanceInterval_(0.0),
+      rebalanceThreshold_(0.0),
+      rebalanceBudget_(0),
+      lastBusyLoop_(NULL),
+      lifeline_(new Lifeline(this))
 {
-    acceptor_->setNewConnectionCallback(
-        boost::bind(&TcpServer::newConnection, this, _1, _2));
+    acceptor_->setNewConnectionBatchCallback(
+        boost::bind(&TcpServer::newConnections, this, _1));
 }
 
 TcpServer::~TcpServer()
@@ -43,6 +81,16 @@ TcpServer::~TcpServer()
     loop_->assertInLoopThread();
     LOG_TRACE << "TcpServer::~TcpServer [" << name_ << "] destructing";
 
+    if (rebalanceInterval_ > 0 && started_.get())
+    {
+        loop_->cancel(rebalanceTimer_);
+    }
+    // 等正在其他IO线程中执行的迁移、rebalance完成，之后排队的不再执行
+    {
+        MutexLockGuard lock(lifeline_->mutex);
+        lifeline_->server = NULL;
+    }
+
     for (ConnectionMap::iterator it(connections_.begin());
             it != connections_.end(); ++it)
     {
@@ -51,6 +99,26 @@ TcpServer::~TcpServer()
         conn->getLoop()->runInLoop(
             boost::bind(&TcpConnection::connectDestroyed, conn));
     }
+
+    // 各个IO线程的Acceptor可能正在accept，会调用newConnectionInLoop，
+    // 要等它们在自己的IO线程中关闭之后，才能继续析构
+    if (!loopAcceptors_.empty())
+    {
+        CountDownLatch latch(static_cast<int>(loopAcceptors_.size()));
+        for (size_t i = 0; i < loopAcceptors_.size(); ++i)
+        {
+            loopAcceptors_[i]->loop->runInLoop(
+                boost::bind(&TcpServer::destroyLoopAcceptor, loopAcceptors_[i], &latch));
+        }
+        latch.wait();
+    }
+
+    // IdleWheel在它的IO线程中停止、销毁，连接都已经从中取出了
+    for (IdleWheelMap::iterator it(idleWheels_.begin());
+            it != idleWheels_.end(); ++it)
+    {
+        it->first->runInLoop(boost::bind(&IdleWheel::stop, it->second));
+    }
 }
 
 // 设置，事件循环线程池class EventLoopThreadPool中，线程的个数
@@ -72,17 +140,324 @@ void TcpServer::start()
         // 并将多线程共享的EventLoop对象，放入到EventLoop对象缓冲区loops_中
         threadPool_->start(threadInitCallback_);
 
+        if (rebalanceInterval_ > 0)
+        {
+            std::vector<EventLoop *> loops(threadPool_->getAllLoops());
+            for (size_t i = 0; i < loops.size(); ++i)
+            {
+                lastHandlerUsec_.push_back(loops[i]->handlerUsec().sum());
+            }
+            rebalanceTimer_ = loop_->runEvery(rebalanceInterval_, boost::bind(&TcpServer::rebalance, this));
+        }
+
+        if (idleTimeout_ > 0)
+        {
+            std::vector<EventLoop *> loops(threadPool_->getAllLoops());
+            for (size_t i = 0; i < loops.size(); ++i)
+            {
+                boost::shared_ptr<IdleWheel> wheel(new IdleWheel(loops[i], idleTimeout_));
+                idleWheels_[loops[i]] = wheel;
+                loops[i]->runInLoop(boost::bind(&IdleWheel::start, wheel));
+            }
+        }
+
         // 套接字acceptSocket_(其内部成员变量：sockfd_)，未处于监听状态
         assert(!acceptor_->listenning());
 
-        // 在IO线程（创建了EventLoop对象的线程）中，执行Acceptor::listen函数,
-        // 实现：服务端进程，开始监听服务端socket -- acceptSocket_，即：
-        // 在acceptSocket_（acceptor_对象的成员变量）上注册读事件，并在pollfds_表（相当于epoll的内核事件表）中新增一个表项
-        // 实现：服务端进程，使用poll函数，监测acceptSocket_（acceptor_对象的成员变量）上是否有读事件发生
-        // 读事件：服务端进程，接收到客户端进程发来的数据
-        loop_->runInLoop(
-            boost::bind(&Acceptor::listen, get_pointer(acceptor_)));
+        if (acceptorPerLoop_)
+        {
+            // 每个IO线程监听自己的SO_REUSEPORT套接字，acceptor_只是占着端口
+            std::vector<EventLoop *> loops(threadPool_->getAllLoops());
+            for (size_t i = 0; i < loops.size(); ++i)
+            {
+                LoopAcceptorPtr acceptor(new LoopAcceptor(loops[i], listenAddr_));
+                // IO线程绑定了CPU时，内核优先把这个CPU（网卡接收队列的中断）收到的连接，交给它的Acceptor
+                int cpu = threadPool_->cpuOf(loops[i]);
+                if (cpu >= 0)
+                {
+                    acceptor->acceptor->setIncomingCpu(cpu);
+                }
+                acceptor->acceptor->setAcceptBudget(acceptBudget_);
+                acceptor->acceptor->setNewConnectionCallback(
+                    boost::bind(&TcpServer::newConnectionInLoop, this, get_pointer(acceptor), _1, _2));
+                loopAcceptors_.push_back(acceptor);
+                loops[i]->runInLoop(
+                    boost::bind(&Acceptor::listen, get_pointer(acceptor->acceptor)));
+            }
+        }
+        else
+        {
+            // 在IO线程（创建了EventLoop对象的线程）中，执行Acceptor::listen函数,
+            // 实现：服务端进程，开始监听服务端socket -- acceptSocket_，即：
+            // 在acceptSocket_（acceptor_对象的成员变量）上注册读事件，并在pollfds_表（相当于epoll的内核事件表）中新增一个表项
+            // 实现：服务端进程，使用poll函数，监测acceptSocket_（acceptor_对象的成员变量）上是否有读事件发生
+            // 读事件：服务端进程，接收到客户端进程发来的数据
+            loop_->runInLoop(
+                boost::bind(&Acceptor::listen, get_pointer(acceptor_)));
+        }
+    }
+}
+
+void TcpServer::setIdleTimeout(int seconds)
+{
+    assert(0 <= seconds);
+    assert(started_.get() == 0);
+    idleTimeout_ = seconds;
+}
+
+void TcpServer::setAcceptBudget(int budget)
+{
+    assert(0 < budget);
+    assert(started_.get() == 0);
+    acceptBudget_ = budget;
+    acceptor_->setAcceptBudget(budget);
+}
+
+int64_t TcpServer::idleClosedCount() const
+{
+    int64_t closed = 0;
+    for (IdleWheelMap::const_iterator it(idleWheels_.begin());
+            it != idleWheels_.end(); ++it)
+    {
+        closed += it->second->closedCount();
+    }
+    return closed;
+}
+
+void TcpServer::setRebalance(double interval, double busyThreshold, int maxMoves)
+{
+    assert(0 <= interval);
+    assert(0 < busyThreshold && busyThreshold < 1);
+    assert(0 < maxMoves);
+    assert(started_.get() == 0);
+    rebalanceInterval_ = interval;
+    rebalanceThreshold_ = busyThreshold;
+    rebalanceBudget_ = maxMoves;
+}
+
+boost::function<void()> TcpServer::guard(const boost::function<void()> &f) const
+{
+    return boost::bind(&TcpServer::runIfAlive, lifeline_, f);
+}
+
+void TcpServer::runIfAlive(const LifelinePtr &lifeline, const boost::function<void()> &f)
+{
+    MutexLockGuard lock(lifeline->mutex);
+    if (lifeline->server)
+    {
+        f();
+    }
+}
+
+void TcpServer::connectionMigratedIfAlive(const LifelinePtr &lifeline, bool perLoop,
+                                          const TcpConnectionPtr &conn)
+{
+    MutexLockGuard lock(lifeline->mutex);
+    if (lifeline->server)
+    {
+        lifeline->server->connectionMigrated(conn);
+    }
+    else if (perLoop && !conn->disconnected())
+    {
+        // 其他连接已经由destroyLoopAcceptor销毁；kNoReusePort的连接在connections_中，由析构函数销毁
+        conn->connectDestroyed();
+    }
+}
+
+void TcpServer::migrateConnection(const TcpConnectionPtr &conn, EventLoop *ioLoop)
+{
+    // 不用runInLoop：在连接自己的回调函数中调用时，也要等回调函数返回之后再迁移
+    conn->getLoop()->queueInLoop(
+        guard(boost::bind(&TcpServer::migrateConnectionInLoop, this, conn, ioLoop)));
+}
+
+void TcpServer::migrateConnectionInLoop(const TcpConnectionPtr &conn, EventLoop *ioLoop)
+{
+    EventLoop *oldLoop = conn->getLoop();
+    if (!oldLoop->isInLoopThread())
+    {
+        // 排队期间，连接已经迁移到了别的IO线程
+        oldLoop->queueInLoop(
+            guard(boost::bind(&TcpServer::migrateConnectionInLoop, this, conn, ioLoop)));
+        return;
+    }
+    LoopAcceptor *oldAcceptor = NULL;
+    if (acceptorPerLoop_)
+    {
+        oldAcceptor = findLoopAcceptor(oldLoop);
+        // 迁移途中，连接在新的IO线程中关闭时，从新的IO线程的Acceptor中删除，不能再访问旧的
+        conn->setCloseCallback(
+            boost::bind(&TcpServer::removeLocalConnection, this, findLoopAcceptor(ioLoop), _1));
+    }
+    if (conn->migrateInLoop(ioLoop,
+                            boost::bind(&TcpServer::connectionMigratedIfAlive, lifeline_, acceptorPerLoop_, _1)))
+    {
+        if (oldAcceptor)
+        {
+            oldAcceptor->connections.erase(conn->name());
+        }
+        migrations_.increment();
+        LOG_INFO << "TcpServer::migrateConnection [" << name_
+                 << "] - connection " << conn->name();
+    }
+    else if (oldAcceptor)
+    {
+        conn->setCloseCallback(
+            boost::bind(&TcpServer::removeLocalConnection, this, oldAcceptor, _1));
+    }
+}
+
+void TcpServer::connectionMigrated(const TcpConnectionPtr &conn)
+{
+    EventLoop *ioLoop = conn->getLoop();
+    ioLoop->assertInLoopThread();
+    if (conn->disconnected())
+    {
+        // 迁移途中已经关闭了
+        return;
+    }
+    if (idleTimeout_ > 0)
+    {
+        IdleWheelMap::const_iterator it = idleWheels_.find(ioLoop);
+        assert(it != idleWheels_.end());
+        it->second->add(get_pointer(conn));
+    }
+    if (acceptorPerLoop_)
+    {
+        LoopAcceptor *acceptor = findLoopAcceptor(ioLoop);
+        assert(acceptor != NULL);
+        acceptor->connections[conn->name()] = conn;
+    }
+}
+
+void TcpServer::rebalance()
+{
+    loop_->assertInLoopThread();
+    std::vector<EventLoop *> loops(threadPool_->getAllLoops());
+    if (loops.size() < 2)
+    {
+        return;
+    }
+    // 各个IO线程这段时间中，处理事件的时间所占的比例
+    std::vector<double> busy(loops.size());
+    size_t busiest = 0;
+    size_t idlest = 0;
+    for (size_t i = 0; i < loops.size(); ++i)
+    {
+        int64_t sum = loops[i]->handlerUsec().sum();
+        busy[i] = static_cast<double>(sum - lastHandlerUsec_[i]) / (rebalanceInterval_ * 1000 * 1000);
+        lastHandlerUsec_[i] = sum;
+        if (busy[i] > busy[busiest])
+        {
+            busiest = i;
+        }
+        if (busy[i] < busy[idlest])
+        {
+            idlest = i;
+        }
+    }
+    if (busy[busiest] < rebalanceThreshold_ || busy[busiest] < 2 * busy[idlest])
+    {
+        lastBusyLoop_ = NULL;
+        return;
+    }
+
+    EventLoop *busyLoop = loops[busiest];
+    // 连续两次都是这个IO线程最忙，才迁移，迁移之后重新开始确认
+    bool migrate = busyLoop == lastBusyLoop_;
+    lastBusyLoop_ = migrate ? NULL : busyLoop;
+    // 按可读事件估计处理时间，迁移走这么大比例的可读事件，两个IO线程就一样忙了
+    double share = (busy[busiest] - busy[idlest]) / (2 * busy[busiest]);
+    LOG_DEBUG << "TcpServer::rebalance [" << name_ << "] - busiest loop " << busiest
+              << " " << busy[busiest] << ", idlest loop " << idlest << " " << busy[idlest];
+
+    // kReusePortPerLoop时，连接只在各自的IO线程中记录，由rebalanceInLoop去找
+    std::vector<TcpConnectionPtr> candidates;
+    if (!acceptorPerLoop_)
+    {
+        for (ConnectionMap::iterator it(connections_.begin());
+                it != connections_.end(); ++it)
+        {
+            if (it->second->getLoop() == busyLoop)
+            {
+                candidates.push_back(it->second);
+            }
+        }
+    }
+    busyLoop->queueInLoop(
+        guard(boost::bind(&TcpServer::rebalanceInLoop, this, busyLoop, loops[idlest], candidates, migrate, share)));
+}
+
+void TcpServer::rebalanceInLoop(EventLoop *busyLoop, EventLoop *ioLoop,
+                                const std::vector<TcpConnectionPtr> &candidates, bool migrate, double share)
+{
+    busyLoop->assertInLoopThread();
+    std::vector<TcpConnectionPtr> conns(candidates);
+    if (acceptorPerLoop_)
+    {
+        LoopAcceptor *acceptor = findLoopAcceptor(busyLoop);
+        for (ConnectionMap::iterator it(acceptor->connections.begin());
+                it != acceptor->connections.end(); ++it)
+        {
+            conns.push_back(it->second);
+        }
+    }
+
+    // 这段时间中各个连接的可读事件次数
+    typedef std::pair<int64_t, TcpConnectionPtr> Sample;
+    std::vector<Sample> samples;
+    int64_t total = 0;
+    for (size_t i = 0; i < conns.size(); ++i)
+    {
+        const TcpConnectionPtr &conn = conns[i];
+        // 已经迁移走了的，跳过
+        if (conn->getLoop() != busyLoop || !conn->connected())
+        {
+            continue;
+        }
+        int64_t wakeups = conn->sampleWakeups();
+        if (wakeups > 0)
+        {
+            samples.push_back(Sample(wakeups, conn));
+            total += wakeups;
+        }
+    }
+    if (!migrate)
+    {
+        return;
+    }
+
+    // 从可读事件最多的连接开始迁移，迁移后会超过目标的跳过：
+    // 只有一个活跃的连接时，迁移它只是把忙碌换到另一个IO线程
+    std::sort(samples.begin(), samples.end(), std::greater<Sample>());
+    double target = share * static_cast<double>(total);
+    int64_t moved = 0;
+    int moves = 0;
+    for (size_t i = 0; i < samples.size() && moves < rebalanceBudget_; ++i)
+    {
+        if (static_cast<double>(moved + samples[i].first) > target)
+        {
+            continue;
+        }
+        migrateConnectionInLoop(samples[i].second, ioLoop);
+        moved += samples[i].first;
+        ++moves;
+    }
+    LOG_DEBUG << "TcpServer::rebalanceInLoop [" << name_ << "] - moved " << moves
+              << " connections, " << moved << " of " << total << " wakeups";
+}
+
+TcpServer::LoopAcceptor *TcpServer::findLoopAcceptor(EventLoop *ioLoop) const
+{
+    // start()之后loopAcceptors_不再改变，可以在多个IO线程中查找
+    for (size_t i = 0; i < loopAcceptors_.size(); ++i)
+    {
+        if (loopAcceptors_[i]->loop == ioLoop)
+        {
+            return get_pointer(loopAcceptors_[i]);
+        }
     }
+    return NULL;
 }
 
 /// ===============================================================================================================
@@ -110,16 +485,76 @@ void TcpServer::start()
 ///      实现：服务端进程，使用poll函数，监测channel_（conn对象的成员变量）管理的socket文件描述符上是否有读事件发生
 ///      读事件：服务端进程，接收到客户端进程发来的数据
 ///      并执行，连接回调函数connectionCallback_（conn对象的成员变量），通知客户端进程，连接建立成功
-void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
+///      这一步由newConnections()按IO线程分组后，在IO线程中执行
+TcpConnectionPtr TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
 {
     // 确保：执行事件循环（EventLoop::loop()）的线程，是IO线程
     // 即：确保，执行void TcpServer::newConnection函数的线程，是IO线程
     // 也就是确保，执行void TcpServer::newConnection函数的线程，是服务端线程
     loop_->assertInLoopThread();
-    EventLoop *ioLoop = threadPool_->getNextLoop();
+    // kIncomingCpu：交给绑定在收到这个连接的CPU（网卡接收队列的中断）上的IO线程，数据包和处理在同一个CPU的缓存中
+    EventLoop *ioLoop = threadPool_->placement() == EventLoopThreadPool::kIncomingCpu
+                        ? threadPool_->getLoopForCpu(sockets::getIncomingCpu(sockfd))
+                        : threadPool_->getNextLoop();
+    // 创建TCP连接管理对象conn，管理服务端进程与客户端进程新建立的连接
+    TcpConnectionPtr conn(createConnection(ioLoop, sockfd, peerAddr));
+
+    // connections_记录：服务端进程和客户端进程建立的连接信息：
+    // （1）连接的名字
+    // （2）TCP连接管理对象TcpConnection
+    // 将connName，此连接的信息保存到connections_中
+    connections_[conn->name()] = conn;
+    // 设置关闭连接回到函数
+    conn->setCloseCallback(
+        boost::bind(&TcpServer::removeConnection, this, _1)); // FIXME: unsafe
+    return conn;
+}
+
+void TcpServer::newConnections(const ConnectionBatch &batch)
+{
+    loop_->assertInLoopThread();
+    // 按IO线程分组，一批连接中分给同一个IO线程的，只queueInLoop一次，只唤醒它一次
+    typedef std::map<EventLoop *, std::vector<TcpConnectionPtr> > ConnectionsByLoop;
+    ConnectionsByLoop byLoop;
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+        TcpConnectionPtr conn(newConnection(batch[i].first, batch[i].second));
+        byLoop[conn->getLoop()].push_back(conn);
+    }
+    for (ConnectionsByLoop::iterator it = byLoop.begin(); it != byLoop.end(); ++it)
+    {
+        /// 使客户端进程与服务端进程，真正建立起连接：
+        /// 在channel_（conn对象的成员变量）管理的socket文件描述符上注册读事件，并在pollfds_表（相当于epoll的内核事件表）中新增一个表项
+        /// 实现：服务端进程，使用poll函数，监测channel_（conn对象的成员变量）管理的socket文件描述符上是否有读事件发生
+        /// 读事件：服务端进程，接收到客户端进程发来的数据
+        /// 并执行，连接回调函数connectionCallback_（conn对象的成员变量），通知客户端进程，连接建立成功
+        it->first->runInLoop(boost::bind(&TcpServer::establishConnections, it->second));
+    }
+}
+
+void TcpServer::establishConnections(const std::vector<TcpConnectionPtr> &conns)
+{
+    for (size_t i = 0; i < conns.size(); ++i)
+    {
+        conns[i]->connectEstablished();
+    }
+}
+
+// kReusePortPerLoop：连接在accept它的IO线程中创建、建立，不需要唤醒其他线程
+void TcpServer::newConnectionInLoop(LoopAcceptor *acceptor, int sockfd, const InetAddress &peerAddr)
+{
+    acceptor->loop->assertInLoopThread();
+    TcpConnectionPtr conn(createConnection(acceptor->loop, sockfd, peerAddr));
+    acceptor->connections[conn->name()] = conn;
+    conn->setCloseCallback(
+        boost::bind(&TcpServer::removeLocalConnection, this, acceptor, _1)); // FIXME: unsafe
+    conn->connectEstablished();
+}
+
+TcpConnectionPtr TcpServer::createConnection(EventLoop *ioLoop, int sockfd, const InetAddress &peerAddr)
+{
     char buf[64];
-    snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_);
-    ++nextConnId_;
+    snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_.incrementAndGet());
     // 创建：服务端进程与客户端进程，所建立的连接的名字
     string connName = name_ + buf;
 
@@ -130,34 +565,23 @@ void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
     InetAddress localAddr(sockets::getLocalAddr(sockfd));
     // FIXME poll with zero timeout to double confirm the new connection
     // FIXME use make_shared if necessary
-    // 创建TCP连接管理对象conn，管理服务端进程与客户端进程新建立的连接
     TcpConnectionPtr conn(new TcpConnection(ioLoop,
                                             connName,
                                             sockfd,
                                             localAddr,
                                             peerAddr));
-
-    // connections_记录：服务端进程和客户端进程建立的连接信息：
-    // （1）连接的名字
-    // （2）TCP连接管理对象TcpConnection
-    // 将connName，此连接的信息保存到connections_中
-    connections_[connName] = conn;
     // 设置连接回调函数
     conn->setConnectionCallback(connectionCallback_);
     // 设置消息回调函数
     conn->setMessageCallback(messageCallback_);
     // 设置写完成回调函数
     conn->setWriteCompleteCallback(writeCompleteCallback_);
-    // 设置关闭连接回到函数
-    conn->setCloseCallback(
-        boost::bind(&TcpServer::removeConnection, this, _1)); // FIXME: unsafe
-
-    /// 使客户端进程与服务端进程，真正建立起连接：
-    /// 在channel_（conn对象的成员变量）管理的socket文件描述符上注册读事件，并在pollfds_表（相当于epoll的内核事件表）中新增一个表项
-    /// 实现：服务端进程，使用poll函数，监测channel_（conn对象的成员变量）管理的socket文件描述符上是否有读事件发生
-    /// 读事件：服务端进程，接收到客户端进程发来的数据
-    /// 并执行，连接回调函数connectionCallback_（conn对象的成员变量），通知客户端进程，连接建立成功
-    ioLoop->runInLoop(boost::bind(&TcpConnection::connectEstablished, conn));
+    if (idleTimeout_ > 0)
+    {
+        // start()之后idleWheels_不再改变，可以在多个IO线程中查找
+        conn->setIdleWheel(get_pointer(idleWheels_.find(ioLoop)->second));
+    }
+    return conn;
 }
 
 // 关闭（销毁）服务端和客户端建立的连接
@@ -199,4 +623,30 @@ void TcpServer::removeConnectionInLoop(const TcpConnectionPtr &conn)
     // 将需要在IO线程中执行的用户回调函数TcpConnection::connectDestroyed，放入到队列中保存，并在必要时唤醒IO线程，执行这个用户任务回调函数
     ioLoop->queueInLoop(
         boost::bind(&TcpConnection::connectDestroyed, conn));
-}
\ No newline at end of file
+}
+
+void TcpServer::removeLocalConnection(LoopAcceptor *acceptor, const TcpConnectionPtr &conn)
+{
+    acceptor->loop->assertInLoopThread();
+    LOG_INFO << "TcpServer::removeLocalConnection [" << name_
+             << "] - connection " << conn->name();
+    // 迁移途中关闭的连接，还没有放入新的IO线程的connections，见connectionMigrated
+    acceptor->connections.erase(conn->name());
+    // 和removeConnectionInLoop一样，等handleClose返回后再销毁
+    acceptor->loop->queueInLoop(
+        boost::bind(&TcpConnection::connectDestroyed, conn));
+}
+
+void TcpServer::destroyLoopAcceptor(const LoopAcceptorPtr &acceptor, CountDownLatch *latch)
+{
+    acceptor->loop->assertInLoopThread();
+    for (ConnectionMap::iterator it(acceptor->connections.begin());
+            it != acceptor->connections.end(); ++it)
+    {
+        it->second->connectDestroyed();
+    }
+    acceptor->connections.clear();
+    // Acceptor要在它的IO线程中析构
+    acceptor->acceptor.reset();
+    latch->countDown();
+}
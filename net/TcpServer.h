@@ -14,20 +14,26 @@
 #include <muduo/base/Atomic.h>
 #include <muduo/base/Types.h>
 #include <muduo/net/TcpConnection.h>
+#include <muduo/net/TimerId.h>
 
 #include <map>
+#include <utility>
+#include <vector>
 #include <boost/noncopyable.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
 
 namespace muduo
 {
+    class CountDownLatch;
+
     namespace net
     {
 
         class Acceptor;
         class EventLoop;
         class EventLoopThreadPool;
+        class IdleWheel;
 
         ///
         /// TCP server, supports single-threaded and thread-pool models.
@@ -42,6 +48,11 @@ namespace muduo
             {
                 kNoReusePort,
                 kReusePort,
+                // 线程池中的每个IO线程，都有自己的SO_REUSEPORT Acceptor，由内核分发新连接，
+                // 在本线程中accept并处理，不再经过loop这个线程转交
+                // IO线程绑定了CPU（EventLoopThreadPool::setCpuAffinity()）时，还设置SO_INCOMING_CPU，
+                // 内核优先把一个CPU收到的连接，交给绑定在这个CPU上的IO线程
+                kReusePortPerLoop,
             };
 
             //TcpServer(EventLoop* loop, const InetAddress& listenAddr);
@@ -73,7 +84,10 @@ namespace muduo
             ///   this is the default value.
             /// - 1 means all I/O in another thread.
             /// - N means a thread pool with N threads, new connections
-            ///   are assigned on a round-robin basis.
+            ///   are assigned on a round-robin basis, or by load, see
+            ///   EventLoopThreadPool::setPlacement().
+            ///   The threads can be pinned to CPUs, see
+            ///   EventLoopThreadPool::setCpuAffinity().
             // 设置，事件循环线程池class EventLoopThreadPool中，线程的个数
             void setThreadNum(int numThreads);
             void setThreadInitCallback(const ThreadInitCallback &cb)
@@ -96,6 +110,50 @@ namespace muduo
             /// 读事件：服务端进程，接收到客户端进程发来的数据
             void start();
 
+            /// Close connections which have nothing read or written for
+            /// @c seconds, with TcpConnection::forceClose().
+            ///
+            /// Must be called before @c start. 0 (the default) disables it.
+            /// 每个IO线程一个IdleWheel，连接有读写时只记下当前的秒数，不分配内存，
+            /// 每秒检查一个桶，平均是连接数 / seconds个连接
+            void setIdleTimeout(int seconds);
+
+            /// Accept at most @c budget connections per readable event of a
+            /// listening socket, with kReusePortPerLoop as well.
+            ///
+            /// Must be called before @c start. Defaults to Acceptor::kDefaultAcceptBudget.
+            /// 连接风暴时，一次可读事件accept一批连接，按IO线程分组，每个IO线程只唤醒一次；
+            /// budget限制每次占用acceptor所在IO线程的时间，1就是以前一次accept一个连接
+            void setAcceptBudget(int budget);
+
+            /// 因为空闲而关闭的连接数，Thread safe.
+            int64_t idleClosedCount() const;
+
+            /// Move an established connection to loop @c ioLoop, which must be
+            /// one of threadPool()->getAllLoops(). Thread safe.
+            /// 在连接当前的IO线程中执行，之前已经在那里排队的操作先执行，
+            /// channel_在新的IO线程中重新注册，缓冲区、context都跟着连接走，不会丢失或者打乱数据，
+            /// 迁移之后，连接的回调函数都在新的IO线程中调用
+            /// 连接自己在旧的IO线程中设置的定时器，不会跟着迁移
+            void migrateConnection(const TcpConnectionPtr &conn, EventLoop *ioLoop);
+
+            /// Every @c interval seconds, if the busiest IO loop spent more than
+            /// @c busyThreshold (0 ~ 1) of the time handling events, and more than
+            /// twice as much as the idlest one, move connections off it, at most
+            /// @c maxMoves per round.
+            ///
+            /// Must be called before @c start, needs setThreadNum(n), n > 1.
+            /// 处理事件的时间，来自EventLoop::handlerUsec()；最忙的IO线程连续两次超过阈值，才迁移连接，
+            /// 第一次记下它的每个连接的可读事件次数，第二次按这期间的可读事件次数从多到少选出连接，迁移到最闲的IO线程，
+            /// 直到迁移的可读事件，估计能让两个IO线程一样忙为止；超过这个量的连接（例如唯一活跃的连接）跳过
+            void setRebalance(double interval, double busyThreshold, int maxMoves = 16);
+
+            /// 迁移的连接数，包括migrateConnection()和rebalancer，Thread safe.
+            int64_t migrationCount() const
+            {
+                return migrations_.get();
+            }
+
             /// Set connection callback.
             /// Not thread safe.
             void setConnectionCallback(const ConnectionCallback &cb)
@@ -144,7 +202,16 @@ namespace muduo
             ///      实现：服务端进程，使用poll函数，监测channel_（conn对象的成员变量）管理的socket文件描述符上是否有读事件发生
             ///      读事件：服务端进程，接收到客户端进程发来的数据
             ///      并执行，连接回调函数connectionCallback_（conn对象的成员变量），通知客户端进程，连接建立成功
-            void newConnection(int sockfd, const InetAddress &peerAddr);
+            ///      这一步由newConnections()按IO线程分组后，在IO线程中执行
+            TcpConnectionPtr newConnection(int sockfd, const InetAddress &peerAddr);
+            // 与Acceptor::ConnectionBatch是同一个类型，这里不暴露Acceptor
+            typedef std::vector<std::pair<int, InetAddress> > ConnectionBatch;
+            /// Not thread safe, but in loop
+            // acceptor_一次可读事件中accept的一批连接，逐个newConnection()，再按IO线程分组，
+            // 每个IO线程只queueInLoop一次（只唤醒一次），而不是每个连接一次
+            void newConnections(const ConnectionBatch &batch);
+            // 在IO线程中，建立分给这个IO线程的一批连接
+            static void establishConnections(const std::vector<TcpConnectionPtr> &conns);
 
             /// Thread safe.
             // 函数参数含义：
@@ -169,10 +236,46 @@ namespace muduo
             // （2）服务端进程，执行此函数：彻底断开客户端与服务端建立的TCP连接
             void removeConnectionInLoop(const TcpConnectionPtr &conn);
 
+            // kReusePortPerLoop：一个IO线程的Acceptor，以及它accept的连接，只在这个IO线程中使用
+            struct LoopAcceptor;
+            typedef boost::shared_ptr<LoopAcceptor> LoopAcceptorPtr;
+            // 创建连接，设置回调，不包括关闭连接回调函数
+            TcpConnectionPtr createConnection(EventLoop *ioLoop, int sockfd, const InetAddress &peerAddr);
+            // 在IO线程中，ioLoop的Acceptor接受了新连接
+            void newConnectionInLoop(LoopAcceptor *acceptor, int sockfd, const InetAddress &peerAddr);
+            // 在连接所在的IO线程中，从它的Acceptor的connections中删除
+            void removeLocalConnection(LoopAcceptor *acceptor, const TcpConnectionPtr &conn);
+            // 在IO线程中，关闭Acceptor，销毁它的连接，完成后latch减一
+            static void destroyLoopAcceptor(const LoopAcceptorPtr &acceptor, CountDownLatch *latch);
+            LoopAcceptor *findLoopAcceptor(EventLoop *ioLoop) const;
+
+            // 排队到IO线程中、会访问TcpServer的操作（迁移、rebalance）都通过Lifeline执行，
+            // 析构时在锁中把它的server置为NULL，之后这些操作不再执行，正在执行的，析构时等它完成
+            struct Lifeline;
+            typedef boost::shared_ptr<Lifeline> LifelinePtr;
+            // 返回的函数对象，TcpServer析构之后执行时，不调用f
+            boost::function<void()> guard(const boost::function<void()> &f) const;
+            static void runIfAlive(const LifelinePtr &lifeline, const boost::function<void()> &f);
+            // TcpServer析构之后才迁移完成的kReusePortPerLoop连接，不在任何Acceptor中，在这里销毁
+            static void connectionMigratedIfAlive(const LifelinePtr &lifeline, bool perLoop,
+                                                  const TcpConnectionPtr &conn);
+
+            // 在连接所在的IO线程中迁移，连接已经迁移走了的，转交给它现在的IO线程
+            void migrateConnectionInLoop(const TcpConnectionPtr &conn, EventLoop *ioLoop);
+            // 在新的IO线程中，把迁移来的连接放入这个IO线程的IdleWheel、Acceptor的connections
+            void connectionMigrated(const TcpConnectionPtr &conn);
+            // 在loop_中定时执行，找出最忙和最闲的IO线程
+            void rebalance();
+            // 在最忙的IO线程中，统计它的连接的可读事件次数，migrate为true时，从最多的开始迁移到ioLoop，
+            // 直到迁移的可读事件占share这么大的比例
+            void rebalanceInLoop(EventLoop *busyLoop, EventLoop *ioLoop,
+                                 const std::vector<TcpConnectionPtr> &candidates, bool migrate, double share);
+
             // class TcpConnection这个类的作用：
             // （1）管理客户端和服务端之间，建立的，TCP连接
             // （2）这个类所创建的一个对象，就是一个，TCP连接管理对象，这个对象中，保存着这个TCP连接的相关信息
             typedef std::map<string, TcpConnectionPtr> ConnectionMap;
+            typedef std::map<EventLoop *, boost::shared_ptr<IdleWheel> > IdleWheelMap;
 
             // 记录：TcpServer自己的EventLoop对象的地址
             EventLoop *loop_;  // the acceptor loop
@@ -214,13 +317,38 @@ namespace muduo
 
             // 记录：服务端进程，是否已经启动
             AtomicInt32 started_;
-            // always in loop thread
-            int nextConnId_;
+            // kReusePortPerLoop时，多个IO线程都会创建连接
+            AtomicInt32 nextConnId_;
 
             // 记录：服务端进程和客户端进程建立的连接信息：
             // （1）连接的名字
             // （2）TCP连接管理对象TcpConnection
             ConnectionMap connections_;
+
+            // kReusePortPerLoop时，acceptor_只占用端口，不监听，由这些Acceptor接受连接，start()之后不再改变
+            const bool acceptorPerLoop_;
+            std::vector<LoopAcceptorPtr> loopAcceptors_;
+            const InetAddress listenAddr_;
+            // 每次可读事件最多accept的连接数，start()时交给loopAcceptors_
+            int acceptBudget_;
+
+            // 空闲超时的秒数，0表示不检查
+            int idleTimeout_;
+            // 每个IO线程一个IdleWheel，start()之后不再改变
+            IdleWheelMap idleWheels_;
+
+            // rebalancer，interval为0表示不迁移，下面的成员只在loop_中使用
+            double rebalanceInterval_;
+            double rebalanceThreshold_;
+            // 每次最多迁移的连接数，start()之后不再改变，在IO线程中读取
+            int rebalanceBudget_;
+            TimerId rebalanceTimer_;
+            // 上次检查时，各个IO线程的handlerUsec().sum()
+            std::vector<int64_t> lastHandlerUsec_;
+            // 上次检查时超过阈值的IO线程，没有时为NULL
+            EventLoop *lastBusyLoop_;
+            mutable AtomicInt64 migrations_;
+            LifelinePtr lifeline_;
         };
     }
 }
@@ -11,7 +11,6 @@
 using namespace muduo;
 using namespace muduo::net;
 
-AtomicInt64 Timer::s_numCreated_;
 /// 以当前系统时间now为基准，重启定时器
 void Timer::restart(Timestamp now)
 {
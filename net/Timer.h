@@ -13,7 +13,6 @@
 
 #include <boost/noncopyable.hpp>
 
-#include <muduo/base/Atomic.h>
 #include <muduo/base/Timestamp.h>
 #include <muduo/net/Callbacks.h>
 
@@ -25,26 +24,65 @@ namespace muduo
         /// 定时器类：一个对象，就是一个定时器，定时器需要放到定时器容器class TimerQueue中进行管理
         /// Internal class for timer event.
         ///
+        /// 定时器对象由TimerQueue分配和回收：到期或注销的定时器，放回TimerQueue的空闲链表，
+        /// 下一次在IO线程中添加定时器时，调用reuse()重用，直到TimerQueue析构时才释放；
+        /// 在其他线程中添加的定时器，仍然用new分配
+        ///
         class Timer : boost::noncopyable
         {
         public:
-            Timer(const TimerCallback &cb, Timestamp when, double interval)
+            /// sequence：定时器的序号，由TimerQueue分配，同一个TimerQueue中不重复，
+            /// 用于区分重用了同一个对象的前后两个定时器
+            Timer(const TimerCallback &cb, Timestamp when, double interval, int64_t sequence)
                 : callback_(cb),
                   expiration_(when),
                   interval_(interval),
                   repeat_(interval > 0.0),
-                  sequence_(s_numCreated_.incrementAndGet())
+                  sequence_(sequence),
+                  slack_(0),
+                  wheelPrev_(NULL),
+                  wheelNext_(NULL),
+                  wheelSlot_(-1)
             { }
 
 #ifdef __GXX_EXPERIMENTAL_CXX0X__
-            Timer(TimerCallback &&cb, Timestamp when, double interval)
+            Timer(TimerCallback &&cb, Timestamp when, double interval, int64_t sequence)
                 : callback_(std::move(cb)),
                   expiration_(when),
                   interval_(interval),
                   repeat_(interval > 0.0),
-                  sequence_(s_numCreated_.incrementAndGet())
+                  sequence_(sequence),
+                  slack_(0),
+                  wheelPrev_(NULL),
+                  wheelNext_(NULL),
+                  wheelSlot_(-1)
             { }
 #endif
+            /// 重用一个空闲的定时器对象，换上新的回调函数、超时时间和序号
+            /// 省掉的只是Timer对象本身的分配，回调函数仍然要复制到callback_中：
+            /// boost::function只把不超过三个指针大小、可以按位复制的函数对象放在内部，
+            /// 例如函数指针、boost::bind(f, 1)、boost::bind(&C::f, this)，复制时不分配内存；
+            /// boost::bind(&C::f, this, 1)、绑定了shared_ptr的函数对象，调用方构造TimerCallback时
+            /// 分配一次，这里复制时再分配一次
+            void reuse(const TimerCallback &cb, Timestamp when, double interval, int64_t sequence)
+            {
+                callback_ = cb;
+                init(when, interval, sequence);
+            }
+
+#ifdef __GXX_EXPERIMENTAL_CXX0X__
+            void reuse(TimerCallback &&cb, Timestamp when, double interval, int64_t sequence)
+            {
+                callback_ = std::move(cb);
+                init(when, interval, sequence);
+            }
+#endif
+            /// 放回空闲链表之前调用：释放回调函数绑定的对象（例如TcpConnectionPtr）
+            void release()
+            {
+                callback_.clear();
+            }
+
             /// 执行定时器中的回调函数
             void run() const
             {
@@ -64,30 +102,59 @@ namespace muduo
             {
                 return sequence_;
             }
+            /// 允许晚于expiration()到期的时间，微秒；大于0时，TimerQueue会调整到期时间，和其他定时器合并
+            int64_t slack() const
+            {
+                return slack_;
+            }
+            void setSlack(int64_t slack)
+            {
+                slack_ = slack;
+            }
+            /// 合并时，在[expiration(), expiration() + slack()]之内调整到期时间
+            void setExpiration(Timestamp when)
+            {
+                expiration_ = when;
+            }
+            /// 是否在TimingWheel中
+            bool inWheel() const
+            {
+                return wheelSlot_ >= 0;
+            }
             /// 以当前系统时间now为基准，重启定时器
             void restart(Timestamp now);
 
-            static int64_t numCreated()
+        private:
+            friend class TimingWheel;
+
+            void init(Timestamp when, double interval, int64_t sequence)
             {
-                return s_numCreated_.get();
+                expiration_ = when;
+                interval_ = interval;
+                repeat_ = interval > 0.0;
+                sequence_ = sequence;
+                slack_ = 0;
             }
 
-        private:
             // 存放定时器中的回调函数
-            const TimerCallback callback_;
+            TimerCallback callback_;
 
             // 以下2个定时器超时时间，要配合使用，才能实现，定时器超时时间的准确设置
             // 例如：void restart(Timestamp now)，
             // 该函数的实现中：expiration_ = addTime(now, interval_);
             // 即：now + interval = expiration // 完成定时器超时时间（绝对时间）的准确设置
             Timestamp expiration_;// 定时器超时的绝对时间：指定在某个时间点，定时器超时
-            const double interval_;// 定时器超时的相对时间：以当前时间点，为起点，隔interval_时间后，定时器超时
+            double interval_;// 定时器超时的相对时间：以当前时间点，为起点，隔interval_时间后，定时器超时
 
             // 设置是否重启定时器
-            const bool repeat_;
-            const int64_t sequence_;
+            bool repeat_;
+            int64_t sequence_;
+            int64_t slack_;
 
-            static AtomicInt64 s_numCreated_;
+            // 在TimingWheel中时，同一个槽中的定时器，串成双向链表；不在时，wheelSlot_为-1
+            Timer *wheelPrev_;
+            Timer *wheelNext_;
+            int wheelSlot_;
         };
     }
 }
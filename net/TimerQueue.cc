@@ -16,9 +16,11 @@
 #include <muduo/net/EventLoop.h>
 #include <muduo/net/Timer.h>
 #include <muduo/net/TimerId.h>
+#include <muduo/net/TimingWheel.h>
 
 #include <boost/bind.hpp>
 
+#include <stdlib.h>
 #include <sys/timerfd.h>
 #include <unistd.h>
 
@@ -134,12 +136,17 @@ TimerQueue::TimerQueue(EventLoop *loop)
       timerfd_(createTimerfd()),
       timerfdChannel_(loop, timerfd_),
       timers_(),
-      callingExpiredTimers_(false)
+      callingExpiredTimers_(false),
+      sequence_(0)
 {
     timerfdChannel_.setReadCallback(
         boost::bind(&TimerQueue::handleRead, this));
     // we are always reading the timerfd, we disarm it with timerfd_settime.
     timerfdChannel_.enableReading();
+    if (::getenv("MUDUO_TIMER_WHEEL"))
+    {
+        wheel_.reset(new TimingWheel(Timestamp::now()));
+    }
 }
 
 TimerQueue::~TimerQueue()
@@ -153,6 +160,19 @@ TimerQueue::~TimerQueue()
     {
         delete it->second;
     }
+    if (wheel_)
+    {
+        std::vector<Timer *> timers;
+        wheel_->takeAll(&timers);
+        for (size_t i = 0; i < timers.size(); ++i)
+        {
+            delete timers[i];
+        }
+    }
+    for (size_t i = 0; i < freeTimers_.size(); ++i)
+    {
+        delete freeTimers_[i];
+    }
 }
 
 // 在定时器容器中，添加一个新的定时器：
@@ -160,40 +180,107 @@ TimerQueue::~TimerQueue()
 // （2）定时器的超时时间为：以when时间点为起点，隔interval这么长的时间后，定时器超时
 TimerId TimerQueue::addTimer(const TimerCallback &cb,
                              Timestamp when,
-                             double interval)
+                             double interval,
+                             double slack)
 {
+    int64_t slackUs = static_cast<int64_t>(slack * Timestamp::kMicroSecondsPerSecond);
+    if (loop_->isInLoopThread())
+    {
+        // IO线程中：重用空闲的定时器对象，直接放入定时器容器
+        int64_t sequence = ++sequence_;
+        Timer *timer;
+        if (freeTimers_.empty())
+        {
+            timer = new Timer(cb, when, interval, sequence);
+        }
+        else
+        {
+            timer = freeTimers_.back();
+            freeTimers_.pop_back();
+            timer->reuse(cb, when, interval, sequence);
+        }
+        timer->setSlack(slackUs);
+        addTimerInLoop(timer);
+        return TimerId(timer, sequence);
+    }
+
     // 创建一个新的定时器：
     // （1）定时器的回调函数为cb
     // （2）定时器的超时时间为：以when时间点为起点，隔interval这么长的时间后，定时器超时
-    Timer *timer = new Timer(cb, when, interval);
+    // 空闲链表只在IO线程中访问，这里不能重用其中的定时器对象，仍然用new分配
+    // 序号要在放入IO线程之前取出，之后定时器可能已经到期，被重用了
+    int64_t sequence = foreignSequence_.decrementAndGet();
+    Timer *timer = new Timer(cb, when, interval, sequence);
+    timer->setSlack(slackUs);
     loop_->runInLoop(
         boost::bind(&TimerQueue::addTimerInLoop, this, timer));
     // 返回新创建的定时器timer
-    return TimerId(timer, timer->sequence());
+    return TimerId(timer, sequence);
 }
 
 #ifdef __GXX_EXPERIMENTAL_CXX0X__
 TimerId TimerQueue::addTimer(TimerCallback &&cb,
                              Timestamp when,
-                             double interval)
+                             double interval,
+                             double slack)
 {
-    Timer *timer = new Timer(std::move(cb), when, interval);
+    int64_t slackUs = static_cast<int64_t>(slack * Timestamp::kMicroSecondsPerSecond);
+    if (loop_->isInLoopThread())
+    {
+        int64_t sequence = ++sequence_;
+        Timer *timer;
+        if (freeTimers_.empty())
+        {
+            timer = new Timer(std::move(cb), when, interval, sequence);
+        }
+        else
+        {
+            timer = freeTimers_.back();
+            freeTimers_.pop_back();
+            timer->reuse(std::move(cb), when, interval, sequence);
+        }
+        timer->setSlack(slackUs);
+        addTimerInLoop(timer);
+        return TimerId(timer, sequence);
+    }
+
+    int64_t sequence = foreignSequence_.decrementAndGet();
+    Timer *timer = new Timer(std::move(cb), when, interval, sequence);
+    timer->setSlack(slackUs);
     loop_->runInLoop(
         boost::bind(&TimerQueue::addTimerInLoop, this, timer));
-    return TimerId(timer, timer->sequence());
+    return TimerId(timer, sequence);
 }
 #endif
 
 void TimerQueue::addTimerInLoop(Timer *timer)
 {
     loop_->assertInLoopThread();
+    // 允许晚到期的定时器，先调整到期时间
+    bool wouldRearm = false;
+    if (timer->slack() > 0)
+    {
+        wouldRearm = isEarliest(timer->expiration());
+        coalesce(timer);
+    }
     // 向定时器容器timers_中，插入一个新的定时器timer
     bool earliestChanged = insert(timer);
 
+    // 正在执行到期的定时器的回调函数时，不设置，执行完后reset()统一设置
+    if (callingExpiredTimers_)
+    {
+        return;
+    }
+    bool rearmed = false;
     if (earliestChanged)
     {
         // 为系统定时器timerfd，指定新的绝对超时时间timer->expiration()
-        resetTimerfd(timerfd_, timer->expiration());
+        // 用时间轮时，是向上取整到tick的到期时间
+        rearmed = rearm(wheel_ ? TimingWheel::roundUp(timer->expiration()) : timer->expiration());
+    }
+    if (wouldRearm && !rearmed)
+    {
+        rearmsAvoided_.increment();
     }
 }
 
@@ -209,6 +296,22 @@ void TimerQueue::cancelInLoop(TimerId timerId)
     loop_->assertInLoopThread();
     assert(timers_.size() == activeTimers_.size());
     ActiveTimer timer(timerId.timer_, timerId.sequence_);
+    if (wheel_)
+    {
+        // 定时器对象在TimerQueue析构之前不会释放，可以直接访问；
+        // 序号不同，说明对象已经被新的定时器重用了
+        Timer *t = timerId.timer_;
+        if (t && t->inWheel() && t->sequence() == timerId.sequence_)
+        {
+            wheel_->remove(t);
+            freeTimer(t);
+        }
+        else if (callingExpiredTimers_)
+        {
+            cancelingTimers_.insert(timer);
+        }
+        return;
+    }
     ActiveTimerSet::iterator it = activeTimers_.find(timer);
     if (it != activeTimers_.end())
     {
@@ -216,7 +319,7 @@ void TimerQueue::cancelInLoop(TimerId timerId)
         size_t n = timers_.erase(Entry(it->first->expiration(), it->first));
         assert(n == 1);
         (void)n;
-        delete it->first; // FIXME: no delete please
+        freeTimer(it->first);
         activeTimers_.erase(it);
     }
     else if (callingExpiredTimers_)
@@ -234,6 +337,8 @@ void TimerQueue::handleRead()
     // 系统定时器timerfd，超时后，会向使用它的应用进程发送消息，来唤醒处于等待（睡眠）状态的进程
     // 这个函数的作用：读取系统定时器，向应用进程发来的消息
     readTimerfd(timerfd_, now);
+    // timerfd_是一次性的，已经到期了
+    armed_ = Timestamp::invalid();
     // 以系统当前时间now为基准，从定时器容器中，获取已超时的定时器
     std::vector<Entry> expired = getExpired(now);
 
@@ -257,6 +362,17 @@ std::vector<TimerQueue::Entry> TimerQueue::getExpired(Timestamp now)
 {
     assert(timers_.size() == activeTimers_.size());
     std::vector<Entry> expired;
+    if (wheel_)
+    {
+        std::vector<Timer *> timers;
+        wheel_->advance(now, &timers);
+        expired.reserve(timers.size());
+        for (size_t i = 0; i < timers.size(); ++i)
+        {
+            expired.push_back(Entry(timers[i]->expiration(), timers[i]));
+        }
+        return expired;
+    }
     Entry sentry(now, reinterpret_cast<Timer *>(UINTPTR_MAX));
     TimerList::iterator end = timers_.lower_bound(sentry);
     assert(end == timers_.end() || now < end->first);
@@ -296,12 +412,16 @@ void TimerQueue::reset(const std::vector<Entry> &expired, Timestamp now)
         }
         else// 不重启定时器
         {
-            // FIXME move to a free list
-            delete it->second; // FIXME: no delete please
+            freeTimer(it->second);
         }
     }
+    if (wheel_)
+    {
+        // 时间轮下一次需要走动的时间，可能只是为了把高层的定时器下移
+        nextExpire = wheel_->nextExpiration();
+    }
     // 定时器容器timers，不为空
-    if (!timers_.empty())
+    else if (!timers_.empty())
     {
         // 定时器容器timers中，第一个定时器的超时时间的绝对时间
         // 作为系统定时器timerfd_，指定新的绝对超时时间nextExpire
@@ -311,7 +431,7 @@ void TimerQueue::reset(const std::vector<Entry> &expired, Timestamp now)
     if (nextExpire.valid())
     {
         // 为系统定时器timerfd_，指定新的绝对超时时间nextExpire
-        resetTimerfd(timerfd_, nextExpire);
+        rearm(nextExpire);
     }
 }
 
@@ -320,13 +440,13 @@ bool TimerQueue::insert(Timer *timer)
 {
     loop_->assertInLoopThread();
     assert(timers_.size() == activeTimers_.size());
-    bool earliestChanged = false;
     /// 获取定时器超时的绝对时间
     Timestamp when = timer->expiration();
-    TimerList::iterator it = timers_.begin();
-    if (it == timers_.end() || when < it->first)
+    bool earliestChanged = isEarliest(when);
+    if (wheel_)
     {
-        earliestChanged = true;
+        wheel_->add(timer);
+        return earliestChanged;
     }
     {
         std::pair<TimerList::iterator, bool> result
@@ -345,3 +465,87 @@ bool TimerQueue::insert(Timer *timer)
     return earliestChanged;
 }
 
+
+bool TimerQueue::isEarliest(Timestamp when) const
+{
+    if (wheel_)
+    {
+        // 时间轮中的定时器，在向上取整到tick的时间到期
+        return !armed_.valid() || TimingWheel::roundUp(when) < armed_;
+    }
+    return timers_.empty() || when < timers_.begin()->first;
+}
+
+void TimerQueue::coalesce(Timer *timer)
+{
+    Timestamp earliest = timer->expiration();
+    Timestamp latest(earliest.microSecondsSinceEpoch() + timer->slack());
+    if (armed_.valid() && !(armed_ < earliest) && !(latest < armed_))
+    {
+        // timerfd_已经设置的超时时间在允许的范围内：和那些定时器一起到期，不需要重新设置timerfd_
+        timer->setExpiration(armed_);
+        return;
+    }
+    // 否则对齐到范围内的“整”时间：不超过slack的最大的2的幂（微秒）的整数倍，
+    // 到期时间相近的定时器，落到同一个时间上，一起到期
+    int64_t granularity = static_cast<int64_t>(1) << (63 - __builtin_clzll(static_cast<uint64_t>(timer->slack())));
+    int64_t when = (earliest.microSecondsSinceEpoch() + granularity - 1) / granularity * granularity;
+    timer->setExpiration(Timestamp(when));
+}
+
+bool TimerQueue::rearm(Timestamp when)
+{
+    if (when == armed_)
+    {
+        return false;
+    }
+    resetTimerfd(timerfd_, when);
+    armed_ = when;
+    rearms_.increment();
+    return true;
+}
+
+void TimerQueue::freeTimer(Timer *timer)
+{
+    timer->release();
+    freeTimers_.push_back(timer);
+}
+
+void TimerQueue::setTimingWheel(bool on)
+{
+    loop_->assertInLoopThread();
+    if (on == timingWheel())
+    {
+        return;
+    }
+
+    // 从旧的容器中取出所有的定时器
+    std::vector<Timer *> timers;
+    if (wheel_)
+    {
+        wheel_->takeAll(&timers);
+        wheel_.reset();
+    }
+    else
+    {
+        for (TimerList::iterator it = timers_.begin(); it != timers_.end(); ++it)
+        {
+            timers.push_back(it->second);
+        }
+        timers_.clear();
+        activeTimers_.clear();
+        wheel_.reset(new TimingWheel(Timestamp::now()));
+    }
+
+    // 放到新的容器中，并重新设置系统定时器timerfd_
+    for (size_t i = 0; i < timers.size(); ++i)
+    {
+        insert(timers[i]);
+    }
+    Timestamp nextExpire = wheel_ ? wheel_->nextExpiration()
+                                  : (timers_.empty() ? Timestamp::invalid() : timers_.begin()->first);
+    if (nextExpire.valid())
+    {
+        rearm(nextExpire);
+    }
+}
@@ -15,7 +15,9 @@
 #include <vector>
 
 #include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
 
+#include <muduo/base/Atomic.h>
 #include <muduo/base/Mutex.h>
 #include <muduo/base/Timestamp.h>
 #include <muduo/net/Callbacks.h>
@@ -28,6 +30,7 @@ namespace muduo
         class EventLoop;
         class Timer;
         class TimerId;
+        class TimingWheel;
 
         ///
         /// A best efforts timer queue.
@@ -47,17 +50,43 @@ namespace muduo
             /// 在定时器容器中，添加一个新的定时器：
             ///（1）定时器的回调函数为cb
             ///（2）定时器的超时时间为：以when时间点为起点，隔interval这么长的时间后，定时器超时
+            ///（3）slack > 0时，允许晚slack秒到期，到期时间会调整到[when, when + slack]之内，
+            ///    和其他定时器合并，少设置几次timerfd_，少唤醒几次IO线程
             TimerId addTimer(const TimerCallback &cb,
                              Timestamp when,
-                             double interval);
+                             double interval,
+                             double slack = 0.0);
 #ifdef __GXX_EXPERIMENTAL_CXX0X__
             TimerId addTimer(TimerCallback &&cb,
                              Timestamp when,
-                             double interval);
+                             double interval,
+                             double slack = 0.0);
 #endif
             // 注销定时器timerId：从定时器器容器timers_中，删除定时器timerId
             void cancel(TimerId timerId);
 
+            /// 切换定时器容器：on为true时，用分层时间轮TimingWheel，精度1毫秒，添加和注销是O(1)的；
+            /// 否则用按到期时间排序的std::set，添加和注销是O(log n)的
+            /// 已有的定时器，一起搬到新的容器中
+            /// 只能在IO线程中调用
+            void setTimingWheel(bool on);
+            bool timingWheel() const
+            {
+                return wheel_.get() != NULL;
+            }
+
+            /// 调用timerfd_settime()设置timerfd_的次数，可以在任何线程中调用
+            int64_t rearmCount() const
+            {
+                return rearms_.get();
+            }
+            /// 允许晚到期的定时器，因为合并到已经设置的超时时间上，省掉的timerfd_settime()次数，
+            /// 可以在任何线程中调用
+            int64_t rearmsAvoided() const
+            {
+                return rearmsAvoided_.get();
+            }
+
         private:
 
             // FIXME: use unique_ptr<Timer> instead of raw pointers.
@@ -86,6 +115,19 @@ namespace muduo
             // 向定时器容器timers_中，插入一个新的定时器
             bool insert(Timer *timer);
 
+            // 到期时间为when的定时器，是否比定时器容器中的都早，需要重新设置timerfd_
+            bool isEarliest(Timestamp when) const;
+
+            // 调整允许晚到期的定时器的到期时间：优先用timerfd_已经设置的超时时间，否则对齐到“整”的时间
+            void coalesce(Timer *timer);
+
+            // 为系统定时器timerfd_，指定新的绝对超时时间when，和已经设置的相同时不调用
+            // 返回是否调用了timerfd_settime()
+            bool rearm(Timestamp when);
+
+            // 定时器到期或注销后，放回空闲链表
+            void freeTimer(Timer *timer);
+
             EventLoop *loop_;
 
             // 系统定时器文件描述符
@@ -106,6 +148,24 @@ namespace muduo
             ActiveTimerSet activeTimers_;
             bool callingExpiredTimers_; /* atomic */
             ActiveTimerSet cancelingTimers_;
+
+            // 定时器容器之二：分层时间轮，不为空时，代替timers_和activeTimers_
+            // 默认用timers_，设置了环境变量MUDUO_TIMER_WHEEL时，用时间轮
+            boost::scoped_ptr<TimingWheel> wheel_;
+
+            // 系统定时器timerfd_已经设置的超时时间，timerfd_到期后为无效时间
+            Timestamp armed_;
+            mutable AtomicInt64 rearms_;
+            mutable AtomicInt64 rearmsAvoided_;
+
+            // 空闲的定时器对象，IO线程中添加定时器时重用，不再分配Timer对象
+            // 定时器对象在TimerQueue析构时才释放，所以cancel()可以直接访问TimerId中的定时器，
+            // 比较序号来判断它是否还有效；空闲链表的长度，是同时存在的定时器个数的最大值
+            std::vector<Timer *> freeTimers_;
+            // IO线程中添加的定时器的序号，只在IO线程中使用，不需要原子操作
+            int64_t sequence_;
+            // 其他线程中添加的定时器的序号，是负数，和IO线程中的不会重复
+            AtomicInt64 foreignSequence_;
         };
     }
 }
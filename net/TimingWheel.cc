@@ -0,0 +1,253 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#ifndef __STDC_LIMIT_MACROS
+#define __STDC_LIMIT_MACROS
+#endif
+
+#include <muduo/net/TimingWheel.h>
+
+#include <muduo/net/Timer.h>
+
+#include <algorithm>
+
+#include <assert.h>
+#include <stdint.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+    /// 从第cur位之后（循环）数起，第一个置位的位的距离，1到64，m不为0
+    inline int nextSetBit(uint64_t m, int cur)
+    {
+        int start = (cur + 1) & 63;
+        uint64_t rotated = start == 0 ? m : (m >> start) | (m << (64 - start));
+        return __builtin_ctzll(rotated) + 1;
+    }
+}
+
+const int64_t TimingWheel::kMicroSecondsPerTick;
+
+TimingWheel::TimingWheel(Timestamp now)
+    : currentTick_(now.microSecondsSinceEpoch() / kMicroSecondsPerTick),
+      size_(0)
+{
+    std::fill(slots_, slots_ + kNumSlots, static_cast<Timer *>(NULL));
+    std::fill(bitmap_, bitmap_ + kBitmapWords, 0);
+}
+
+void TimingWheel::add(Timer *timer)
+{
+    assert(timer->wheelSlot_ < 0);
+    // 当前tick的槽已经取出过了，到期的定时器放到下一个tick
+    place(timer, currentTick_ + 1);
+    ++size_;
+}
+
+void TimingWheel::remove(Timer *timer)
+{
+    assert(timer->wheelSlot_ >= 0);
+    unlink(timer);
+    --size_;
+}
+
+void TimingWheel::advance(Timestamp now, std::vector<Timer *> *expired)
+{
+    int64_t nowTick = now.microSecondsSinceEpoch() / kMicroSecondsPerTick;
+    while (size_ > 0)
+    {
+        // 跳到下一个有事可做的tick：第0层下一个非空的槽，或者高层下一个非空的槽需要下移的时候
+        int64_t next = nextTick();
+        if (next > nowTick)
+        {
+            break;
+        }
+        currentTick_ = next;
+        if ((currentTick_ & (kLevel0Slots - 1)) == 0)
+        {
+            cascade();
+        }
+
+        int slot = static_cast<int>(currentTick_ & (kLevel0Slots - 1));
+        size_t first = expired->size();
+        while (slots_[slot])
+        {
+            Timer *timer = slots_[slot];
+            unlink(timer);
+            --size_;
+            expired->push_back(timer);
+        }
+        // 槽中的链表是后进先出的，反过来，同一个tick到期的定时器，按放入的顺序执行
+        std::reverse(expired->begin() + first, expired->end());
+    }
+    // 中间的tick都没有定时器，直接跳过
+    currentTick_ = std::max(currentTick_, nowTick);
+}
+
+Timestamp TimingWheel::nextExpiration() const
+{
+    if (size_ == 0)
+    {
+        return Timestamp();
+    }
+    return Timestamp(nextTick() * kMicroSecondsPerTick);
+}
+
+void TimingWheel::takeAll(std::vector<Timer *> *timers)
+{
+    for (int slot = 0; slot < kNumSlots; ++slot)
+    {
+        while (slots_[slot])
+        {
+            Timer *timer = slots_[slot];
+            unlink(timer);
+            timers->push_back(timer);
+        }
+    }
+    size_ = 0;
+}
+
+int64_t TimingWheel::nextTick() const
+{
+    assert(size_ > 0);
+    int64_t best = INT64_MAX;
+
+    // 第0层：当前槽已经取出过了，从下一个槽开始找，转一圈
+    int cur = static_cast<int>(currentTick_ & (kLevel0Slots - 1));
+    int slot = cur + 1 < kLevel0Slots ? findLevel0(cur + 1) : -1;
+    if (slot >= 0)
+    {
+        best = currentTick_ + (slot - cur);
+    }
+    else if ((slot = findLevel0(0)) >= 0)
+    {
+        best = currentTick_ + (kLevel0Slots - cur + slot);
+    }
+
+    // 高层：下一个非空的槽，在它覆盖的第一个tick下移
+    for (int level = 1; level < kLevels; ++level)
+    {
+        uint64_t m = bitmap_[kLevel0Slots / 64 + level - 1];
+        if (m)
+        {
+            int shift = levelShift(level);
+            int64_t base = currentTick_ >> shift;
+            int64_t tick = (base + nextSetBit(m, static_cast<int>(base & (kLevelSlots - 1)))) << shift;
+            best = std::min(best, tick);
+        }
+    }
+    assert(best != INT64_MAX);
+    return best;
+}
+
+void TimingWheel::place(Timer *timer, int64_t minTick)
+{
+    int64_t tick = std::max(toTick(timer->expiration()), minTick);
+    int64_t delta = tick - currentTick_;
+    int slot;
+    if (delta < kLevel0Slots)
+    {
+        slot = static_cast<int>(tick & (kLevel0Slots - 1));
+    }
+    else
+    {
+        int level = 1;
+        while (level < kLevels - 1 && delta >= (static_cast<int64_t>(1) << levelShift(level + 1)))
+        {
+            ++level;
+        }
+        int64_t range = static_cast<int64_t>(1) << (levelShift(level) + kLevelBits);
+        if (delta >= range)
+        {
+            // 超出时间轮的范围，先放在最高层最远的槽，下移时再按实际的到期时间放置
+            tick = currentTick_ + range - 1;
+        }
+        slot = levelBase(level) + static_cast<int>((tick >> levelShift(level)) & (kLevelSlots - 1));
+    }
+    link(timer, slot);
+}
+
+void TimingWheel::link(Timer *timer, int slot)
+{
+    Timer *head = slots_[slot];
+    timer->wheelPrev_ = NULL;
+    timer->wheelNext_ = head;
+    timer->wheelSlot_ = slot;
+    if (head)
+    {
+        head->wheelPrev_ = timer;
+    }
+    slots_[slot] = timer;
+    bitmap_[slot / 64] |= static_cast<uint64_t>(1) << (slot % 64);
+}
+
+void TimingWheel::unlink(Timer *timer)
+{
+    int slot = timer->wheelSlot_;
+    if (timer->wheelPrev_)
+    {
+        timer->wheelPrev_->wheelNext_ = timer->wheelNext_;
+    }
+    else
+    {
+        slots_[slot] = timer->wheelNext_;
+    }
+    if (timer->wheelNext_)
+    {
+        timer->wheelNext_->wheelPrev_ = timer->wheelPrev_;
+    }
+    if (slots_[slot] == NULL)
+    {
+        bitmap_[slot / 64] &= ~(static_cast<uint64_t>(1) << (slot % 64));
+    }
+    timer->wheelPrev_ = NULL;
+    timer->wheelNext_ = NULL;
+    timer->wheelSlot_ = -1;
+}
+
+void TimingWheel::cascade()
+{
+    // 第level层转完一圈（当前槽的下标为0），才下移第level+1层
+    for (int level = 1; level < kLevels; ++level)
+    {
+        int index = static_cast<int>((currentTick_ >> levelShift(level)) & (kLevelSlots - 1));
+        int slot = levelBase(level) + index;
+        Timer *timer = slots_[slot];
+        slots_[slot] = NULL;
+        bitmap_[slot / 64] &= ~(static_cast<uint64_t>(1) << (slot % 64));
+        while (timer)
+        {
+            Timer *next = timer->wheelNext_;
+            place(timer, currentTick_);
+            timer = next;
+        }
+        if (index != 0)
+        {
+            break;
+        }
+    }
+}
+
+int TimingWheel::findLevel0(int from) const
+{
+    for (int word = from / 64; word < kLevel0Slots / 64; ++word)
+    {
+        uint64_t m = bitmap_[word];
+        if (word == from / 64)
+        {
+            m &= ~static_cast<uint64_t>(0) << (from % 64);
+        }
+        if (m)
+        {
+            return word * 64 + __builtin_ctzll(m);
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,130 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is an internal header file, you should not include this.
+
+#ifndef MUDUO_NET_TIMINGWHEEL_H
+#define MUDUO_NET_TIMINGWHEEL_H
+
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <muduo/base/Timestamp.h>
+
+namespace muduo
+{
+    namespace net
+    {
+        class Timer;
+
+        ///
+        /// 分层时间轮：TimerQueue的另一种定时器容器
+        /// Hierarchical timing wheel, an alternative timer container of TimerQueue.
+        ///
+        /// 精度为1毫秒（一个tick），到期时间向上取整到tick，定时器不会提前到期
+        /// 第0层256个槽，每槽1个tick；第1到4层各64个槽，每层的一个槽是下一层转一圈的时间，
+        /// 共覆盖2^32个tick（约49.7天），更远的定时器先放在最高层，下移时重新放置
+        /// add()和remove()是O(1)的；定时器用Timer中的指针串成双向链表，不另外分配内存
+        /// 时间每走到第0层转完一圈，把高层当前槽中的定时器下移（cascade）到低层
+        ///
+        /// 不是线程安全的，只在TimerQueue所属的IO线程中使用
+        class TimingWheel : boost::noncopyable
+        {
+        public:
+            /// 以now为时间轮的当前时间
+            explicit TimingWheel(Timestamp now);
+
+            /// 放入一个定时器，按timer->expiration()放到对应的槽中
+            /// 已经到期的定时器，放到下一个tick
+            void add(Timer *timer);
+
+            /// 取出一个在时间轮中的定时器
+            void remove(Timer *timer);
+
+            /// 时间轮走到now：到期时间不晚于now的定时器，从时间轮中取出，追加到expired中
+            /// 没有定时器的tick直接跳过
+            void advance(Timestamp now, std::vector<Timer *> *expired);
+
+            /// 下一次需要调用advance()的时间：最早的定时器到期的时间，
+            /// 或者更早的，高层的定时器需要下移的时间；时间轮为空时返回无效时间
+            Timestamp nextExpiration() const;
+
+            /// 取出所有的定时器，追加到timers中，用于切换定时器容器和析构
+            void takeAll(std::vector<Timer *> *timers);
+
+            size_t size() const
+            {
+                return size_;
+            }
+
+            bool empty() const
+            {
+                return size_ == 0;
+            }
+
+            static const int64_t kMicroSecondsPerTick = 1000;
+
+            /// 到期时间向上取整到tick，时间轮中的定时器在这个时间到期
+            static Timestamp roundUp(Timestamp when)
+            {
+                return Timestamp(toTick(when) * kMicroSecondsPerTick);
+            }
+
+        private:
+            static const int kLevels = 5;
+            static const int kLevel0Bits = 8;
+            static const int kLevel0Slots = 1 << kLevel0Bits;
+            static const int kLevelBits = 6;
+            static const int kLevelSlots = 1 << kLevelBits;
+            static const int kNumSlots = kLevel0Slots + (kLevels - 1) * kLevelSlots;
+            static const int kBitmapWords = kNumSlots / 64;
+
+            /// 第level层（level >= 1）的一个槽，覆盖的tick数的log2
+            static int levelShift(int level)
+            {
+                return kLevel0Bits + (level - 1) * kLevelBits;
+            }
+
+            /// 第level层（level >= 1）的第一个槽，在slots_中的下标
+            static int levelBase(int level)
+            {
+                return kLevel0Slots + (level - 1) * kLevelSlots;
+            }
+
+            /// 到期时间向上取整到tick
+            static int64_t toTick(Timestamp when)
+            {
+                return (when.microSecondsSinceEpoch() + kMicroSecondsPerTick - 1) / kMicroSecondsPerTick;
+            }
+
+            /// 按到期时间，把定时器放到对应的槽中，到期的tick不早于minTick
+            void place(Timer *timer, int64_t minTick);
+            void link(Timer *timer, int slot);
+            void unlink(Timer *timer);
+
+            /// 第0层转完一圈，把高层当前槽中的定时器下移
+            void cascade();
+
+            /// 下一个有事可做的tick，时间轮不为空
+            int64_t nextTick() const;
+
+            /// 第0层中，下标在[from, kLevel0Slots)内的第一个非空的槽，没有时返回-1
+            int findLevel0(int from) const;
+
+            // 时间轮的当前时间，这个tick及以前到期的定时器，已经取出
+            int64_t currentTick_;
+            // 每个槽中定时器链表的表头
+            Timer *slots_[kNumSlots];
+            // 每个槽是否非空，用于快速查找下一个非空的槽
+            uint64_t bitmap_[kBitmapWords];
+            size_t size_;
+        };
+    }
+}
+#endif  // MUDUO_NET_TIMINGWHEEL_H
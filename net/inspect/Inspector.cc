@@ -14,6 +14,7 @@
 #include <muduo/net/EventLoop.h>
 #include <muduo/net/http/HttpRequest.h>
 #include <muduo/net/http/HttpResponse.h>
+#include <muduo/net/inspect/LoopInspector.h>
 #include <muduo/net/inspect/ProcessInspector.h>
 #include <muduo/net/inspect/PerformanceInspector.h>
 #include <muduo/net/inspect/SystemInspector.h>
@@ -65,7 +66,8 @@ Inspector::Inspector(EventLoop* loop,
                      const string& name)
     : server_(loop, httpAddr, "Inspector:"+name),
       processInspector_(new ProcessInspector),
-      systemInspector_(new SystemInspector)
+      systemInspector_(new SystemInspector),
+      loopInspector_(new LoopInspector)
 {
   assert(CurrentThread::isMainThread());
   assert(g_globalInspector == 0);
@@ -73,6 +75,7 @@ Inspector::Inspector(EventLoop* loop,
   server_.setHttpCallback(boost::bind(&Inspector::onRequest, this, _1, _2));
   processInspector_->registerCommands(this);
   systemInspector_->registerCommands(this);
+  loopInspector_->registerCommands(this);
 #ifdef HAVE_TCMALLOC
   performanceInspector_.reset(new PerformanceInspector);
   performanceInspector_->registerCommands(this);
@@ -107,6 +110,11 @@ void Inspector::remove(const string& module, const string& command)
   }
 }
 
+void Inspector::addEventLoop(EventLoop* loop)
+{
+  loopInspector_->addEventLoop(loop);
+}
+
 void Inspector::start()
 {
   server_.start();
@@ -25,6 +25,7 @@ namespace muduo
 namespace net
 {
 
+class LoopInspector;
 class ProcessInspector;
 class PerformanceInspector;
 class SystemInspector;
@@ -48,6 +49,10 @@ class Inspector : boost::noncopyable
            const string& help);
   void remove(const string& module, const string& command);
 
+  /// Reports statistics of loop under /loop/,
+  /// loop must outlive the inspector.
+  void addEventLoop(EventLoop* loop);
+
  private:
   typedef std::map<string, Callback> CommandList;
   typedef std::map<string, string> HelpList;
@@ -59,6 +64,7 @@ class Inspector : boost::noncopyable
   boost::scoped_ptr<ProcessInspector> processInspector_;
   boost::scoped_ptr<PerformanceInspector> performanceInspector_;
   boost::scoped_ptr<SystemInspector> systemInspector_;
+  boost::scoped_ptr<LoopInspector> loopInspector_;
   MutexLock mutex_;
   std::map<string, CommandList> modules_;
   std::map<string, HelpList> helps_;
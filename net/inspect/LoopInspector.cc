@@ -0,0 +1,153 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+
+#include <muduo/net/inspect/LoopInspector.h>
+
+#include <muduo/net/BufferPool.h>
+#include <muduo/net/EventLoop.h>
+
+#include <boost/bind.hpp>
+
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+void LoopInspector::registerCommands(Inspector* ins)
+{
+  ins->add("loop", "bufferpool",
+           boost::bind(&LoopInspector::bufferPool, this, _1, _2),
+           "print buffer pool of each loop");
+  ins->add("loop", "busypoll",
+           boost::bind(&LoopInspector::busyPoll, this, _1, _2),
+           "print busy poll hit rate of each loop");
+  ins->add("loop", "syscalls",
+           boost::bind(&LoopInspector::syscalls, this, _1, _2),
+           "print poller syscalls per iteration of each loop");
+  ins->add("loop", "iterations",
+           boost::bind(&LoopInspector::iterations, this, _1, _2),
+           "print histograms of events per poll, poll wait and handler time of each loop");
+  ins->add("loop", "timers",
+           boost::bind(&LoopInspector::timers, this, _1, _2),
+           "print timer backend and timerfd re-arms of each loop");
+  ins->add("loop", "load",
+           boost::bind(&LoopInspector::load, this, _1, _2),
+           "print connections and pending output bytes of each loop");
+}
+
+void LoopInspector::addEventLoop(EventLoop* loop)
+{
+  MutexLockGuard lock(mutex_);
+  loops_.push_back(loop);
+}
+
+string LoopInspector::bufferPool(HttpRequest::Method, const Inspector::ArgList&)
+{
+  string result;
+  MutexLockGuard lock(mutex_);
+  for (size_t i = 0; i < loops_.size(); ++i)
+  {
+    char buf[64];
+    snprintf(buf, sizeof buf, "loop %zu\n", i);
+    result += buf;
+    result += loops_[i]->bufferPool()->stats();
+  }
+  return result;
+}
+
+string LoopInspector::busyPoll(HttpRequest::Method, const Inspector::ArgList&)
+{
+  string result;
+  MutexLockGuard lock(mutex_);
+  for (size_t i = 0; i < loops_.size(); ++i)
+  {
+    EventLoop::BusyPollStats stats = loops_[i]->busyPollStats();
+    char buf[256];
+    snprintf(buf, sizeof buf, "loop %zu spins %lld hits %lld hit_rate %.2f%% polls %lld\n",
+             i,
+             static_cast<long long>(stats.spins),
+             static_cast<long long>(stats.hits),
+             stats.spins > 0 ? 100.0 * static_cast<double>(stats.hits) / static_cast<double>(stats.spins) : 0.0,
+             static_cast<long long>(stats.polls));
+    result += buf;
+  }
+  return result;
+}
+
+string LoopInspector::syscalls(HttpRequest::Method, const Inspector::ArgList&)
+{
+  string result;
+  MutexLockGuard lock(mutex_);
+  for (size_t i = 0; i < loops_.size(); ++i)
+  {
+    int64_t iterations = loops_[i]->iteration();
+    int64_t syscalls = loops_[i]->syscallCount();
+    char buf[256];
+    snprintf(buf, sizeof buf, "loop %zu iterations %lld syscalls %lld per_iteration %.2f wakeups %lld\n",
+             i,
+             static_cast<long long>(iterations),
+             static_cast<long long>(syscalls),
+             iterations > 0 ? static_cast<double>(syscalls) / static_cast<double>(iterations) : 0.0,
+             static_cast<long long>(loops_[i]->wakeupCount()));
+    result += buf;
+  }
+  return result;
+}
+
+string LoopInspector::iterations(HttpRequest::Method, const Inspector::ArgList&)
+{
+  string result;
+  MutexLockGuard lock(mutex_);
+  for (size_t i = 0; i < loops_.size(); ++i)
+  {
+    char buf[64];
+    snprintf(buf, sizeof buf, "loop %zu\n", i);
+    result += buf;
+    result += "events per poll: ";
+    result += loops_[i]->eventsPerPoll().toString();
+    result += "poll wait us: ";
+    result += loops_[i]->pollWaitUsec().toString();
+    result += "handler us: ";
+    result += loops_[i]->handlerUsec().toString();
+  }
+  return result;
+}
+
+string LoopInspector::timers(HttpRequest::Method, const Inspector::ArgList&)
+{
+  string result;
+  MutexLockGuard lock(mutex_);
+  for (size_t i = 0; i < loops_.size(); ++i)
+  {
+    char buf[256];
+    snprintf(buf, sizeof buf, "loop %zu backend %s rearms %lld rearms_avoided %lld\n",
+             i,
+             loops_[i]->timingWheel() ? "wheel" : "set",
+             static_cast<long long>(loops_[i]->timerRearmCount()),
+             static_cast<long long>(loops_[i]->timerRearmsAvoided()));
+    result += buf;
+  }
+  return result;
+}
+
+string LoopInspector::load(HttpRequest::Method, const Inspector::ArgList&)
+{
+  string result;
+  MutexLockGuard lock(mutex_);
+  for (size_t i = 0; i < loops_.size(); ++i)
+  {
+    char buf[256];
+    snprintf(buf, sizeof buf, "loop %zu connections %lld pending_bytes %lld\n",
+             i,
+             static_cast<long long>(loops_[i]->connectionCount()),
+             static_cast<long long>(loops_[i]->pendingOutputBytes()));
+    result += buf;
+  }
+  return result;
+}
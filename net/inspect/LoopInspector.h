@@ -0,0 +1,44 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is an internal header file, you should not include this.
+
+#ifndef MUDUO_NET_INSPECT_LOOPINSPECTOR_H
+#define MUDUO_NET_INSPECT_LOOPINSPECTOR_H
+
+#include <muduo/net/inspect/Inspector.h>
+#include <boost/noncopyable.hpp>
+
+namespace muduo
+{
+namespace net
+{
+
+// Per EventLoop statistics, for loops added by Inspector::addEventLoop().
+class LoopInspector : boost::noncopyable
+{
+ public:
+  void registerCommands(Inspector* ins);
+  void addEventLoop(EventLoop* loop);
+
+  string bufferPool(HttpRequest::Method, const Inspector::ArgList&);
+  string busyPoll(HttpRequest::Method, const Inspector::ArgList&);
+  string syscalls(HttpRequest::Method, const Inspector::ArgList&);
+  string iterations(HttpRequest::Method, const Inspector::ArgList&);
+  string timers(HttpRequest::Method, const Inspector::ArgList&);
+  string load(HttpRequest::Method, const Inspector::ArgList&);
+
+ private:
+  MutexLock mutex_;
+  std::vector<EventLoop*> loops_;
+};
+
+}
+}
+
+#endif  // MUDUO_NET_INSPECT_LOOPINSPECTOR_H
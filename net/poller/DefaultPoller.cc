@@ -9,6 +9,9 @@
 #include <muduo/net/Poller.h>
 #include <muduo/net/poller/PollPoller.h>
 #include <muduo/net/poller/EPollPoller.h>
+#include <muduo/net/poller/IoUringPoller.h>
+
+#include <muduo/base/Logging.h>
 
 #include <stdlib.h>
 
@@ -20,6 +23,17 @@ Poller* Poller::newDefaultPoller(EventLoop* loop)
   {
     return new PollPoller(loop);
   }
+  else if (::getenv("MUDUO_USE_IOURING"))
+  {
+    IoUringPoller* poller = new IoUringPoller(loop);
+    if (poller->valid())
+    {
+      return poller;
+    }
+    delete poller;
+    LOG_WARN << "io_uring is not available, fall back to epoll";
+    return new EPollPoller(loop);
+  }
   else
   {
     return new EPollPoller(loop);
@@ -58,7 +58,9 @@ EPollPoller::EPollPoller(EventLoop *loop)
     : Poller(loop),
       /// 创建epoll内核事件监听表epollfd_
       epollfd_(::epoll_create1(EPOLL_CLOEXEC)),
-      events_(kInitEventListSize)
+      events_(kInitEventListSize),
+      maxEventsInWindow_(0),
+      pollsInWindow_(0)
 {
     if (epollfd_ < 0)
     {
@@ -83,6 +85,10 @@ EPollPoller::~EPollPoller()
 Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
 {
     LOG_TRACE << "fd total count " << channels_.size();
+    if (!dirty_.empty())
+    {
+        flushDirty();
+    }
     /// numEvents：存放，有事件发生的文件描述符的总数
     /// 监听epoll的内核事件监听表epollfd_中，存放的文件描述符上，是否有相应的事件发生
     /// 将有事件发生的文件描述符，所在的表项内容，填入到，记录实际发生的事件的表events_中保存
@@ -91,6 +97,7 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
                                  static_cast<int>(events_.size()),
                                  timeoutMs);
     int savedErrno = errno;
+    syscalls_.increment();
     Timestamp now(Timestamp::now());
     if (numEvents > 0)
     {
@@ -105,6 +112,12 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
         if (implicit_cast<size_t>(numEvents) == events_.size())
         {
             events_.resize(events_.size() * 2);
+            maxEventsInWindow_ = 0;
+            pollsInWindow_ = 0;
+        }
+        else if (numEvents > maxEventsInWindow_)
+        {
+            maxEventsInWindow_ = numEvents;
         }
     }
     else if (numEvents == 0)
@@ -120,6 +133,18 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
             LOG_SYSERR << "EPollPoller::poll()";
         }
     }
+    if (++pollsInWindow_ >= kResizeWindow)
+    {
+        /// 负载下降之后，归还用不到的events_
+        if (events_.size() > static_cast<size_t>(kInitEventListSize)
+                && implicit_cast<size_t>(maxEventsInWindow_) * 4 < events_.size())
+        {
+            LOG_DEBUG << "shrink events from " << events_.size() << " to " << events_.size() / 2;
+            EventList(events_.size() / 2).swap(events_);
+        }
+        maxEventsInWindow_ = 0;
+        pollsInWindow_ = 0;
+    }
     return now;
 }
 
@@ -231,10 +256,42 @@ void EPollPoller::updateChannel(Channel *channel)
         }
         else
         {
-            /// 实施，修改epoll的内核事件监听表epollfd_中的，表项channel
+            /// 记下来，下一次epoll_wait之前，再修改epoll的内核事件监听表epollfd_中的，表项channel
+            Interest &interest = interests_[fd];
+            if (!interest.dirty)
+            {
+                interest.dirty = true;
+                dirty_.push_back(fd);
+            }
+        }
+    }
+}
+
+void EPollPoller::flushDirty()
+{
+    for (size_t i = 0; i < dirty_.size(); ++i)
+    {
+        int fd = dirty_[i];
+        Interest &interest = interests_[fd];
+        interest.dirty = false;
+        /// 记下之后，可能已经删除了，或者又重新ADD了
+        ChannelMap::const_iterator it = channels_.find(fd);
+        if (it == channels_.end() || it->second->index() != kAdded)
+        {
+            continue;
+        }
+        Channel *channel = it->second;
+        uint32_t events = channel->events();
+        if (channel->isEdgeTriggered())
+        {
+            events |= EPOLLET;
+        }
+        if (events != interest.registered)
+        {
             update(EPOLL_CTL_MOD, channel);
         }
     }
+    dirty_.clear();
 }
 
 /// 函数参数含义：
@@ -287,11 +344,21 @@ void EPollPoller::update(int operation, Channel *channel)
     bzero(&event, sizeof event);
     /// 获得：关心的IO事件（用户注册的事件）events_
     event.events = channel->events();
+    if (channel->isEdgeTriggered())
+    {
+        event.events |= EPOLLET;
+    }
     event.data.ptr = channel;
     /// 获得：class Channel类，所管理的文件描述符fd_
     int fd = channel->fd();
     LOG_TRACE << "epoll_ctl op = " << operationToString(operation)
               << " fd = " << fd << " event = { " << channel->eventsToString() << " }";
+    if (implicit_cast<size_t>(fd) >= interests_.size())
+    {
+        interests_.resize(fd + 1);
+    }
+    interests_[fd].registered = operation == EPOLL_CTL_DEL ? 0 : event.events;
+    syscalls_.increment();
     if (::epoll_ctl(epollfd_, operation, fd, &event) < 0)
     {
         if (operation == EPOLL_CTL_DEL)
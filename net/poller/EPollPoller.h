@@ -26,6 +26,10 @@ namespace muduo
         /// IO Multiplexing with epoll(4).
         ///
         /// class EPollPoller IO复用的封装：封装了epoll
+        /// 已经注册的fd，修改关注的事件时（例如每次写不完时enableWriting，写完时disableWriting），
+        /// 不立即调用epoll_ctl(MOD)，只是记下这个fd，下一次epoll_wait之前，
+        /// 和epoll中已经注册的事件比较，不同时才调用一次epoll_ctl，同一轮中的多次修改合并成一次，
+        /// 改回原样的，不调用；新增（ADD）和删除（DEL）仍然立即调用，fd关闭之前一定已经从epoll中删除
         class EPollPoller : public Poller
         {
         public:
@@ -68,6 +72,9 @@ namespace muduo
             /// 记录实际发生的事件的表
             /// 也就是传入epoll_wait函数的参数，用于记录实际发生的事件的表，的，初始的大小
             static const int kInitEventListSize = 16;
+            /// 每kResizeWindow次epoll_wait，检查一次events_是否太大：
+            /// 这期间一次返回的事件个数的最大值，不到events_大小的1/4时，减半
+            static const int kResizeWindow = 1024;
 
             static const char *operationToString(int op);
 
@@ -86,6 +93,24 @@ namespace muduo
             /// 在epoll的内核事件监听表epollfd_中，对表项内容channel，实施operation操作
             void update(int operation, Channel *channel);
 
+            /// 把记下的修改，提交到epoll中
+            void flushDirty();
+
+            /// 每个fd在epoll中注册的事件
+            struct Interest
+            {
+                Interest()
+                    : registered(0),
+                      dirty(false)
+                {
+                }
+
+                uint32_t registered;
+                bool dirty;
+            };
+            std::vector<Interest> interests_;  // indexed by fd
+            std::vector<int> dirty_;
+
             /// 用于定义：
             /// 记录实际发生的事件的表
             /// 也就是传入epoll_wait函数的参数，用于记录实际发生的事件的表
@@ -93,6 +118,8 @@ namespace muduo
             /// 记录实际发生的事件的表
             /// 也就是传入epoll_wait函数的参数，用于记录实际发生的事件的表
             EventList events_;
+            int maxEventsInWindow_;
+            int pollsInWindow_;
 
             /// 指向epoll_create1创建的，epoll内核事件监听表
             /// 也可以说，epollfd_就代表epoll内核事件监听表
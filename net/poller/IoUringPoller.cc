@@ -0,0 +1,432 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include <muduo/net/poller/IoUringPoller.h>
+
+#include <muduo/base/Logging.h>
+#include <muduo/net/Channel.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+    const int kNew = -1;
+    const int kAdded = 1;
+
+    /// user_data: 高32位是请求的序号gen，低32位是fd
+    /// 取消poll请求的IORING_OP_POLL_REMOVE，完成事件没有用，使用kRemoveTag
+    const uint64_t kRemoveTag = ~static_cast<uint64_t>(0);
+    /// 析构时，最多等待IORING_OP_POLL_REMOVE完成这么久
+    const int kRemoveTimeoutMs = 1000;
+
+    uint64_t makeUserData(int fd, uint32_t gen)
+    {
+        return (static_cast<uint64_t>(gen) << 32) | static_cast<uint32_t>(fd);
+    }
+
+    int sysIoUringSetup(unsigned entries, struct io_uring_params *p)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_setup, entries, p));
+    }
+
+    int sysIoUringEnter(int fd, unsigned toSubmit, unsigned minComplete,
+                        unsigned flags, const void *arg, size_t argsz)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete,
+                                          flags, arg, argsz));
+    }
+}
+
+const unsigned IoUringPoller::kRingEntries;
+
+IoUringPoller::IoUringPoller(EventLoop *loop)
+    : Poller(loop),
+      ringfd_(-1),
+      ring_(MAP_FAILED),
+      ringSize_(0),
+      sqes_(NULL),
+      sqesSize_(0),
+      sqHead_(NULL),
+      sqTail_(NULL),
+      sqArray_(NULL),
+      sqMask_(0),
+      sqEntries_(0),
+      sqLocalTail_(0),
+      toSubmit_(0),
+      cqHead_(NULL),
+      cqTail_(NULL),
+      cqMask_(0),
+      cqes_(NULL),
+      pendingRemoves_(0)
+{
+    if (!setupRing() && ringfd_ >= 0)
+    {
+        ::close(ringfd_);
+        ringfd_ = -1;
+    }
+}
+
+IoUringPoller::~IoUringPoller()
+{
+    if (ringfd_ >= 0)
+    {
+        // 提交还没有提交的IORING_OP_POLL_REMOVE，并等它们完成（最多等kRemoveTimeoutMs），
+        // 否则，poll请求持有的文件（例如监听socket），要等io_uring在后台销毁之后才能关闭
+        flushDirty();
+        Timestamp deadline(addTime(Timestamp::now(), kRemoveTimeoutMs / 1000.0));
+        while (pendingRemoves_ > 0)
+        {
+            int timeoutMs = static_cast<int>(timeDifference(deadline, Timestamp::now()) * 1000);
+            if (timeoutMs <= 0)
+            {
+                break;
+            }
+            // CQ中其他的完成事件也计入minComplete，所以可能提前返回，清理之后接着等
+            if (enter(pendingRemoves_, IORING_ENTER_GETEVENTS, timeoutMs) < 0 && errno != EINTR)
+            {
+                break;
+            }
+            reapRemoves();
+        }
+        if (pendingRemoves_ > 0)
+        {
+            LOG_WARN << "IoUringPoller " << pendingRemoves_ << " POLL_REMOVE not completed";
+        }
+    }
+    if (sqes_ != NULL)
+    {
+        ::munmap(sqes_, sqesSize_);
+    }
+    if (ring_ != MAP_FAILED)
+    {
+        ::munmap(ring_, ringSize_);
+    }
+    if (ringfd_ >= 0)
+    {
+        ::close(ringfd_);
+    }
+}
+
+bool IoUringPoller::setupRing()
+{
+    struct io_uring_params params;
+    bzero(&params, sizeof params);
+    ringfd_ = sysIoUringSetup(kRingEntries, &params);
+    if (ringfd_ < 0)
+    {
+        LOG_SYSERR << "IoUringPoller io_uring_setup";
+        return false;
+    }
+
+    // 需要：SQ和CQ共用一次mmap，io_uring_enter可以带超时，完成事件不会丢失
+    const unsigned kRequired = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_EXT_ARG | IORING_FEAT_NODROP;
+    if ((params.features & kRequired) != kRequired)
+    {
+        LOG_ERROR << "IoUringPoller kernel lacks features, has " << params.features;
+        return false;
+    }
+
+    size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ringSize_ = sqSize > cqSize ? sqSize : cqSize;
+    ring_ = ::mmap(NULL, ringSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   ringfd_, IORING_OFF_SQ_RING);
+    if (ring_ == MAP_FAILED)
+    {
+        LOG_SYSERR << "IoUringPoller mmap ring";
+        return false;
+    }
+    sqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    void *sqes = ::mmap(NULL, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ringfd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+    {
+        LOG_SYSERR << "IoUringPoller mmap sqes";
+        return false;
+    }
+    sqes_ = static_cast<struct io_uring_sqe *>(sqes);
+
+    char *ring = static_cast<char *>(ring_);
+    sqHead_ = reinterpret_cast<unsigned *>(ring + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned *>(ring + params.sq_off.tail);
+    sqArray_ = reinterpret_cast<unsigned *>(ring + params.sq_off.array);
+    sqMask_ = *reinterpret_cast<unsigned *>(ring + params.sq_off.ring_mask);
+    sqEntries_ = params.sq_entries;
+    sqLocalTail_ = *sqTail_;
+    cqHead_ = reinterpret_cast<unsigned *>(ring + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned *>(ring + params.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned *>(ring + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe *>(ring + params.cq_off.cqes);
+    return true;
+}
+
+Timestamp IoUringPoller::poll(int timeoutMs, ChannelList *activeChannels)
+{
+    LOG_TRACE << "fd total count " << channels_.size();
+    flushDirty();
+    int ret = 0;
+    if (timeoutMs == 0)
+    {
+        ret = enter(0, IORING_ENTER_GETEVENTS, 0);
+    }
+    else
+    {
+        unsigned head = *cqHead_;
+        bool ready = head != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+        ret = enter(ready ? 0 : 1, IORING_ENTER_GETEVENTS, timeoutMs);
+    }
+    int savedErrno = errno;
+    Timestamp now(Timestamp::now());
+    if (ret < 0 && savedErrno != ETIME && savedErrno != EINTR && savedErrno != EBUSY)
+    {
+        errno = savedErrno;
+        LOG_SYSERR << "IoUringPoller::poll()";
+    }
+    size_t before = activeChannels->size();
+    reapCompletions(activeChannels);
+    if (activeChannels->size() > before)
+    {
+        LOG_TRACE << activeChannels->size() - before << " events happened";
+    }
+    else
+    {
+        LOG_TRACE << "nothing happened";
+    }
+    return now;
+}
+
+int IoUringPoller::enter(unsigned minComplete, unsigned flags, int timeoutMs)
+{
+    __atomic_store_n(sqTail_, sqLocalTail_, __ATOMIC_RELEASE);
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    bzero(&arg, sizeof arg);
+    if (minComplete > 0 && timeoutMs >= 0)
+    {
+        ts.tv_sec = timeoutMs / 1000;
+        ts.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000 * 1000;
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+    }
+    arg.sigmask_sz = _NSIG / 8;
+    syscalls_.increment();
+    int ret = sysIoUringEnter(ringfd_, toSubmit_, minComplete,
+                              flags | IORING_ENTER_EXT_ARG, &arg, sizeof arg);
+    if (ret > 0)
+    {
+        toSubmit_ -= static_cast<unsigned>(ret);
+    }
+    return ret;
+}
+
+struct io_uring_sqe *IoUringPoller::getSqe()
+{
+    unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    if (sqLocalTail_ - head >= sqEntries_)
+    {
+        // 提交队列满了，先提交一次，不等待
+        if (enter(0, 0, 0) < 0)
+        {
+            LOG_SYSFATAL << "IoUringPoller::getSqe()";
+        }
+        head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+        assert(sqLocalTail_ - head < sqEntries_);
+    }
+    unsigned index = sqLocalTail_ & sqMask_;
+    struct io_uring_sqe *sqe = &sqes_[index];
+    bzero(sqe, sizeof *sqe);
+    sqArray_[index] = index;
+    ++sqLocalTail_;
+    ++toSubmit_;
+    return sqe;
+}
+
+/// 单次的poll请求：不设置IORING_POLL_ADD_MULTI，触发一次就结束，
+/// 由reapCompletions标记为dirty，下一次poll时重新提交
+void IoUringPoller::submitPollAdd(int fd, PollEntry *entry)
+{
+    assert(!entry->armed);
+    ++entry->gen;
+    struct io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = static_cast<uint32_t>(entry->channel->events());
+    sqe->user_data = makeUserData(fd, entry->gen);
+    entry->armed = true;
+    entry->armedEvents = entry->channel->events();
+}
+
+void IoUringPoller::submitPollRemove(int fd, PollEntry *entry)
+{
+    assert(entry->armed);
+    struct io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = makeUserData(fd, entry->gen);
+    sqe->user_data = kRemoveTag;
+    ++pendingRemoves_;
+    entry->armed = false;
+    // 被取消的请求，完成事件带着旧的gen，会被丢弃
+    ++entry->gen;
+}
+
+void IoUringPoller::markDirty(int fd)
+{
+    PollEntry &entry = entries_[fd];
+    if (!entry.dirty)
+    {
+        entry.dirty = true;
+        dirty_.push_back(fd);
+    }
+}
+
+/// 为关注的事件变化了的、或者上次的poll请求已经触发的fd，提交新的poll请求
+void IoUringPoller::flushDirty()
+{
+    for (size_t i = 0; i < dirty_.size(); ++i)
+    {
+        int fd = dirty_[i];
+        PollEntry &entry = entries_[fd];
+        entry.dirty = false;
+        if (entry.channel == NULL)
+        {
+            continue;
+        }
+        int events = entry.channel->events();
+        if (entry.armed && entry.armedEvents == events)
+        {
+            continue;
+        }
+        if (entry.armed)
+        {
+            submitPollRemove(fd, &entry);
+        }
+        if (!entry.channel->isNoneEvent())
+        {
+            submitPollAdd(fd, &entry);
+        }
+    }
+    dirty_.clear();
+}
+
+void IoUringPoller::reapCompletions(ChannelList *activeChannels)
+{
+    unsigned head = *cqHead_;
+    unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head)
+    {
+        const struct io_uring_cqe *cqe = &cqes_[head & cqMask_];
+        if (cqe->user_data == kRemoveTag)
+        {
+            --pendingRemoves_;
+            continue;
+        }
+        int fd = static_cast<int>(cqe->user_data & 0xffffffff);
+        uint32_t gen = static_cast<uint32_t>(cqe->user_data >> 32);
+        if (fd < 0 || static_cast<size_t>(fd) >= entries_.size())
+        {
+            continue;
+        }
+        PollEntry &entry = entries_[fd];
+        if (entry.channel == NULL || entry.gen != gen || !entry.armed)
+        {
+            // 已经取消或者移除了的请求
+            continue;
+        }
+        entry.armed = false;
+        markDirty(fd);
+        int revents = cqe->res;
+        if (revents < 0)
+        {
+            LOG_ERROR << "IoUringPoller poll fd = " << fd << " failed: " << strerror_tl(-revents);
+            revents = POLLERR;
+        }
+#ifndef NDEBUG
+        ChannelMap::const_iterator it = channels_.find(fd);
+        assert(it != channels_.end());
+        assert(it->second == entry.channel);
+#endif
+        entry.channel->set_revents(revents);
+        activeChannels->push_back(entry.channel);
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+}
+
+/// 析构时使用：只清点IORING_OP_POLL_REMOVE的完成事件，其他的完成事件直接丢弃
+void IoUringPoller::reapRemoves()
+{
+    unsigned head = *cqHead_;
+    unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head)
+    {
+        if (cqes_[head & cqMask_].user_data == kRemoveTag)
+        {
+            --pendingRemoves_;
+        }
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+}
+
+void IoUringPoller::updateChannel(Channel *channel)
+{
+    Poller::assertInLoopThread();
+    const int index = channel->index();
+    int fd = channel->fd();
+    LOG_TRACE << "fd = " << fd
+              << " events = " << channel->events() << " index = " << index;
+    if (index == kNew)
+    {
+        assert(channels_.find(fd) == channels_.end());
+        channels_[fd] = channel;
+        if (static_cast<size_t>(fd) >= entries_.size())
+        {
+            entries_.resize(static_cast<size_t>(fd) + 1);
+        }
+        assert(entries_[fd].channel == NULL);
+        entries_[fd].channel = channel;
+        channel->set_index(kAdded);
+    }
+    else
+    {
+        assert(channels_.find(fd) != channels_.end());
+        assert(channels_[fd] == channel);
+        assert(index == kAdded);
+    }
+    markDirty(fd);
+}
+
+void IoUringPoller::removeChannel(Channel *channel)
+{
+    Poller::assertInLoopThread();
+    int fd = channel->fd();
+    LOG_TRACE << "fd = " << fd;
+    assert(channels_.find(fd) != channels_.end());
+    assert(channels_[fd] == channel);
+    assert(channel->isNoneEvent());
+    assert(channel->index() == kAdded);
+    size_t n = channels_.erase(fd);
+    (void)n;
+    assert(n == 1);
+    PollEntry &entry = entries_[fd];
+    if (entry.armed)
+    {
+        submitPollRemove(fd, &entry);
+    }
+    entry.channel = NULL;
+    channel->set_index(kNew);
+}
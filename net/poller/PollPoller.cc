@@ -46,6 +46,7 @@ Timestamp PollPoller::poll(int timeoutMs, ChannelList* activeChannels)
   /// 监听pollfds_表（相当于epoll的内核事件监听表）中，存放的文件描述符上，是否有相应的事件发生
   int numEvents = ::poll(&*pollfds_.begin(), pollfds_.size(), timeoutMs);
   int savedErrno = errno;
+  syscalls_.increment();
   Timestamp now(Timestamp::now());
   if (numEvents > 0)
   {
@@ -141,6 +142,11 @@ void PollPoller::updateChannel(Channel* channel)
     pfd.events = static_cast<short>(channel->events());
     /// 赋值为0，表示未发生任何事件
     pfd.revents = 0;
+    // 迁移来的连接可能不关注任何事件就注册，和修改时一样忽略这个pollfd
+    if (channel->isNoneEvent())
+    {
+      pfd.fd = -channel->fd()-1;
+    }
     /// 在pollfds_表（相当于epoll的内核事件监听表）中，新增一个表项
     pollfds_.push_back(pfd);
     /// 计算：class Channel类，所管理的文件描述符，在pollfds表（相当于epoll的内核事件监听表）中的位置
@@ -152,7 +158,7 @@ void PollPoller::updateChannel(Channel* channel)
     channel->set_index(idx);
     /// (1)网络库中，所有的文件描述符fd，其上注册的事件events，以及其上实际发生的事件revents，都保存在了，ChannelMap表channels_中
     /// (2)将新增的文件描述符管理类对象channel，添加到ChannelMap表channels_中
-    channels_[pfd.fd] = channel;
+    channels_[channel->fd()] = channel;
   }
   else/// 修改pollfds_表（相当于epoll的内核事件监听表）中的，某个表项
   {   /// 相当于epoll_ctl函数参数选项中的EPOLL_CTL_MOD
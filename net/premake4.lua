@@ -8,12 +8,15 @@ project "net"
     headersdir('muduo/net')
     headers {
         'Buffer.h',
+        'BufferChain.h',
+        'BufferPool.h',
         'Callbacks.h',
         'Channel.h',
         'Endian.h',
         'EventLoop.h',
         'EventLoopThread.h',
         'EventLoopThreadPool.h',
+        'Histogram.h',
         'InetAddress.h',
         'TcpClient.h',
         'TcpConnection.h',
@@ -24,15 +27,20 @@ project "net"
     files {
         'Acceptor.cc',
         'Buffer.cc',
+        'BufferChain.cc',
+        'BufferPool.cc',
         'Channel.cc',
         'Connector.cc',
         'EventLoop.cc',
         'EventLoopThread.cc',
         'EventLoopThreadPool.cc',
+        'Histogram.cc',
+        'IdleWheel.cc',
         'InetAddress.cc',
         'Poller.cc',
         'poller/DefaultPoller.cc',
         'poller/EPollPoller.cc',
+        'poller/IoUringPoller.cc',
         'poller/PollPoller.cc',
         'Socket.cc',
         'SocketsOps.cc',
@@ -41,5 +49,6 @@ project "net"
         'TcpServer.cc',
         'Timer.cc',
         'TimerQueue.cc',
+        'TimingWheel.cc',
      }
 
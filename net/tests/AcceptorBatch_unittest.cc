@@ -0,0 +1,172 @@
+#include <muduo/base/Mutex.h>
+#include <muduo/net/Acceptor.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/SocketsOps.h>
+#include <muduo/net/TcpServer.h>
+
+#include <boost/bind.hpp>
+
+//#define BOOST_TEST_MODULE AcceptorBatchTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <map>
+#include <vector>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using muduo::MutexLock;
+using muduo::MutexLockGuard;
+using muduo::net::Acceptor;
+using muduo::net::EventLoop;
+using muduo::net::InetAddress;
+using muduo::net::TcpConnectionPtr;
+using muduo::net::TcpServer;
+
+namespace
+{
+
+const uint16_t kPort = 20250;
+const int kClients = 10;
+
+// blocking connects complete in the listen backlog before anything is accepted
+std::vector<int> connectClients(const InetAddress& addr, int n)
+{
+  std::vector<int> fds;
+  for (int i = 0; i < n; ++i)
+  {
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+    BOOST_REQUIRE(fd >= 0);
+    BOOST_REQUIRE_EQUAL(::connect(fd, addr.getSockAddr(), sizeof(struct sockaddr_in)), 0);
+    fds.push_back(fd);
+  }
+  return fds;
+}
+
+void closeAll(std::vector<int>* fds)
+{
+  for (size_t i = 0; i < fds->size(); ++i)
+  {
+    ::close((*fds)[i]);
+  }
+  fds->clear();
+}
+
+std::vector<size_t> g_batches;
+int g_single = 0;
+
+void onBatch(EventLoop* loop, const Acceptor::ConnectionBatch& batch)
+{
+  g_batches.push_back(batch.size());
+  for (size_t i = 0; i < batch.size(); ++i)
+  {
+    muduo::net::sockets::close(batch[i].first);
+  }
+  size_t accepted = 0;
+  for (size_t i = 0; i < g_batches.size(); ++i)
+  {
+    accepted += g_batches[i];
+  }
+  if (accepted == kClients)
+  {
+    loop->quit();
+  }
+}
+
+void onSingle(EventLoop* loop, int sockfd, const InetAddress&)
+{
+  muduo::net::sockets::close(sockfd);
+  if (++g_single == kClients)
+  {
+    loop->quit();
+  }
+}
+
+MutexLock g_mutex;
+std::map<EventLoop*, int> g_accepted;  // guarded by g_mutex
+
+void onServerConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    MutexLockGuard lock(g_mutex);
+    ++g_accepted[conn->getLoop()];
+  }
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(testAcceptBudget)
+{
+  EventLoop loop;
+  InetAddress addr(kPort, true);
+  Acceptor acceptor(&loop, addr, false);
+  acceptor.setAcceptBudget(4);
+  acceptor.setNewConnectionBatchCallback(boost::bind(onBatch, &loop, _1));
+  acceptor.listen();
+
+  std::vector<int> fds(connectClients(addr, kClients));
+  loop.runAfter(5.0, boost::bind(&EventLoop::quit, &loop));
+  loop.loop();
+
+  // one readable event per budget, the rest stays in the backlog
+  BOOST_REQUIRE_EQUAL(g_batches.size(), 3U);
+  BOOST_CHECK_EQUAL(g_batches[0], 4U);
+  BOOST_CHECK_EQUAL(g_batches[1], 4U);
+  BOOST_CHECK_EQUAL(g_batches[2], 2U);
+  closeAll(&fds);
+}
+
+BOOST_AUTO_TEST_CASE(testPerConnectionCallback)
+{
+  EventLoop loop;
+  InetAddress addr(kPort, true);
+  Acceptor acceptor(&loop, addr, false);
+  acceptor.setNewConnectionCallback(boost::bind(onSingle, &loop, _1, _2));
+  acceptor.listen();
+
+  std::vector<int> fds(connectClients(addr, kClients));
+  loop.runAfter(5.0, boost::bind(&EventLoop::quit, &loop));
+  loop.loop();
+
+  BOOST_CHECK_EQUAL(g_single, kClients);
+  closeAll(&fds);
+}
+
+BOOST_AUTO_TEST_CASE(testServerBatch)
+{
+  EventLoop loop;
+  InetAddress addr(kPort, true);
+  TcpServer server(&loop, addr, "AcceptorBatchServer");
+  server.setThreadNum(3);
+  server.setAcceptBudget(8);
+  server.setConnectionCallback(onServerConnection);
+  server.start();
+  // listen() runs in loop_
+  loop.runAfter(0.05, boost::bind(&EventLoop::quit, &loop));
+  loop.loop();
+
+  std::vector<int> fds(connectClients(addr, kClients));
+  loop.runAfter(0.5, boost::bind(&EventLoop::quit, &loop));
+  loop.loop();
+
+  {
+    MutexLockGuard lock(g_mutex);
+    int accepted = 0;
+    for (std::map<EventLoop*, int>::iterator it = g_accepted.begin();
+         it != g_accepted.end(); ++it)
+    {
+      accepted += it->second;
+    }
+    BOOST_CHECK_EQUAL(accepted, kClients);
+    // round robin still spreads a batch over the loops
+    BOOST_CHECK_EQUAL(g_accepted.size(), 3U);
+  }
+
+  closeAll(&fds);
+  loop.runAfter(0.2, boost::bind(&EventLoop::quit, &loop));
+  loop.loop();
+}
@@ -0,0 +1,202 @@
+#include <muduo/net/BufferChain.h>
+
+//#define BOOST_TEST_MODULE BufferChainTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <errno.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using muduo::string;
+using muduo::net::Buffer;
+using muduo::net::BufferChain;
+using muduo::net::BufferPtr;
+
+namespace
+{
+
+string readAll(int fd, size_t len)
+{
+  string result;
+  char buf[65536];
+  while (result.size() < len)
+  {
+    ssize_t n = ::read(fd, buf, sizeof buf);
+    if (n <= 0)
+      break;
+    result.append(buf, n);
+  }
+  return result;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(testBufferChainAppendRetrieve)
+{
+  BufferChain chain;
+  BOOST_CHECK_EQUAL(chain.readableBytes(), 0);
+  BOOST_CHECK(chain.empty());
+
+  chain.append(string(200, 'x'));
+  chain.append(string(300, 'y'));
+  BOOST_CHECK_EQUAL(chain.readableBytes(), 500);
+  BOOST_CHECK_EQUAL(chain.numChunks(), 1);
+
+  chain.append(string(BufferChain::kChunkSize, 'z'));
+  BOOST_CHECK_EQUAL(chain.readableBytes(), 500 + BufferChain::kChunkSize);
+  BOOST_CHECK_EQUAL(chain.numChunks(), 2);
+
+  // tail chunk is filled up before a new one is allocated
+  chain.retrieve(600);
+  BOOST_CHECK_EQUAL(chain.readableBytes(), BufferChain::kChunkSize - 100);
+  BOOST_CHECK_EQUAL(chain.numChunks(), 2);
+
+  chain.retrieve(BufferChain::kChunkSize - 600);
+  BOOST_CHECK_EQUAL(chain.readableBytes(), 500);
+  BOOST_CHECK_EQUAL(chain.numChunks(), 1);
+
+  chain.retrieveAll();
+  BOOST_CHECK_EQUAL(chain.readableBytes(), 0);
+  BOOST_CHECK(chain.empty());
+}
+
+BOOST_AUTO_TEST_CASE(testBufferChainNoCopy)
+{
+  BufferChain chain;
+  chain.append("head", 4);
+
+  Buffer swapped;
+  swapped.append(string(1000, 'a'));
+  chain.append(&swapped);
+  BOOST_CHECK_EQUAL(swapped.readableBytes(), 0);
+  BOOST_CHECK_EQUAL(chain.numChunks(), 2);
+
+  BufferPtr shared(new Buffer);
+  shared->append(string(2000, 'b'));
+  chain.append(shared);
+  chain.append(shared);
+  BOOST_CHECK_EQUAL(chain.numChunks(), 4);
+  BOOST_CHECK_EQUAL(chain.readableBytes(), 4 + 1000 + 2000 + 2000);
+
+  chain.retrieve(4 + 500);
+  BOOST_CHECK_EQUAL(chain.numChunks(), 3);
+
+  // shared buffer is never touched by the chain
+  chain.retrieve(500 + 1000);
+  BOOST_CHECK_EQUAL(shared->readableBytes(), 2000);
+  BOOST_CHECK_EQUAL(chain.readableBytes(), 1000 + 2000);
+}
+
+BOOST_AUTO_TEST_CASE(testBufferChainWriteFd)
+{
+  int fds[2];
+  BOOST_REQUIRE_EQUAL(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+  BufferChain chain;
+  string expected;
+  chain.append("hello ", 6);
+  expected += "hello ";
+
+  BufferPtr shared(new Buffer);
+  shared->append(string(3000, 'c'));
+  chain.append(shared);
+  expected += string(3000, 'c');
+
+  static const char kTail[] = "world\n";
+  chain.append(kTail, sizeof kTail - 1, boost::shared_ptr<void>());
+  expected += kTail;
+
+  chain.append(string(100, 'd'));
+  expected += string(100, 'd');
+  BOOST_CHECK_EQUAL(chain.numChunks(), 4);
+
+  int savedErrno = 0;
+  ssize_t n = chain.writeFd(fds[0], &savedErrno);
+  BOOST_CHECK_EQUAL(n, static_cast<ssize_t>(expected.size()));
+  BOOST_CHECK(chain.empty());
+  BOOST_CHECK_EQUAL(readAll(fds[1], expected.size()), expected);
+
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+BOOST_AUTO_TEST_CASE(testBufferChainManyChunks)
+{
+  int fds[2];
+  BOOST_REQUIRE_EQUAL(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+  BufferChain chain;
+  BufferPtr shared(new Buffer);
+  shared->append("0123456789", 10);
+  const int kChunks = BufferChain::kMaxIovecs + 10;
+  for (int i = 0; i < kChunks; ++i)
+  {
+    chain.append(shared);
+  }
+
+  int savedErrno = 0;
+  ssize_t n = chain.writeFd(fds[0], &savedErrno);
+  BOOST_CHECK_EQUAL(n, BufferChain::kMaxIovecs * 10);
+  BOOST_CHECK_EQUAL(chain.numChunks(), 10);
+  n = chain.writeFd(fds[0], &savedErrno);
+  BOOST_CHECK_EQUAL(n, 100);
+  BOOST_CHECK(chain.empty());
+  BOOST_CHECK_EQUAL(readAll(fds[1], kChunks * 10).size(), kChunks * 10);
+
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+BOOST_AUTO_TEST_CASE(testBufferChainFile)
+{
+  int fds[2];
+  BOOST_REQUIRE_EQUAL(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+  FILE* fp = ::tmpfile();
+  BOOST_REQUIRE(fp != NULL);
+  string content;
+  for (int i = 0; i < 1000; ++i)
+  {
+    content += "0123456789";
+  }
+  BOOST_REQUIRE_EQUAL(::fwrite(content.data(), 1, content.size(), fp), content.size());
+  ::fflush(fp);
+  int filefd = ::fileno(fp);
+
+  BufferChain chain;
+  chain.append("head", 4);
+  chain.appendFile(filefd, 100, 5000, boost::shared_ptr<void>());
+  chain.append("tail", 4);
+  BOOST_CHECK_EQUAL(chain.readableBytes(), 4 + 5000 + 4);
+  BOOST_CHECK_EQUAL(chain.numChunks(), 3);
+
+  // writev stops in front of the file chunk
+  int savedErrno = 0;
+  ssize_t n = chain.writeFd(fds[0], &savedErrno);
+  BOOST_CHECK_EQUAL(n, 4);
+  n = chain.writeFd(fds[0], &savedErrno);
+  BOOST_CHECK_EQUAL(n, 5000);
+  n = chain.writeFd(fds[0], &savedErrno);
+  BOOST_CHECK_EQUAL(n, 4);
+  BOOST_CHECK(chain.empty());
+
+  string expected = "head" + content.substr(100, 5000) + "tail";
+  BOOST_CHECK_EQUAL(readAll(fds[1], expected.size()), expected);
+
+  // file shorter than promised
+  chain.appendFile(filefd, content.size() - 10, 100, boost::shared_ptr<void>());
+  n = chain.writeFd(fds[0], &savedErrno);
+  BOOST_CHECK_EQUAL(n, 10);
+  n = chain.writeFd(fds[0], &savedErrno);
+  BOOST_CHECK_EQUAL(n, -1);
+  BOOST_CHECK_EQUAL(savedErrno, EIO);
+  BOOST_CHECK(chain.empty());
+  BOOST_CHECK_EQUAL(chain.readableBytes(), 0);
+
+  ::fclose(fp);
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
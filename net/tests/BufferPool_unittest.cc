@@ -0,0 +1,184 @@
+#include <muduo/net/BufferChain.h>
+#include <muduo/net/BufferPool.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/TcpClient.h>
+#include <muduo/net/TcpServer.h>
+
+#include <boost/bind.hpp>
+
+//#define BOOST_TEST_MODULE BufferPoolTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using muduo::string;
+using muduo::Timestamp;
+using muduo::net::Buffer;
+using muduo::net::BufferChain;
+using muduo::net::BufferPool;
+using muduo::net::BufferPtr;
+using muduo::net::EventLoop;
+using muduo::net::InetAddress;
+using muduo::net::TcpClient;
+using muduo::net::TcpConnectionPtr;
+using muduo::net::TcpServer;
+
+BOOST_AUTO_TEST_CASE(testBufferPoolReuse)
+{
+  BufferPool pool;
+  BufferPtr buf = pool.acquire();
+  BOOST_CHECK_EQUAL(buf->readableBytes(), 0);
+  BOOST_CHECK_EQUAL(buf->writableBytes(), 1024);
+  BOOST_CHECK_EQUAL(pool.leased(), 1);
+  const Buffer* raw = get_pointer(buf);
+
+  buf->append(string(100, 'x'));
+  pool.release(&buf);
+  BOOST_CHECK(!buf);
+  BOOST_CHECK_EQUAL(pool.leased(), 0);
+  BOOST_CHECK_EQUAL(pool.cachedBytes(), 1024);
+
+  BufferPtr again = pool.acquire(1000);
+  BOOST_CHECK_EQUAL(get_pointer(again), raw);
+  BOOST_CHECK_EQUAL(again->readableBytes(), 0);
+  BOOST_CHECK_EQUAL(pool.cachedBytes(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(testBufferPoolSizeClasses)
+{
+  BufferPool pool;
+  BufferPtr small = pool.acquire(100);
+  BOOST_CHECK_EQUAL(small->writableBytes(), 1024);
+  BufferPtr medium = pool.acquire(2000);
+  BOOST_CHECK_EQUAL(medium->writableBytes(), 4096);
+  BufferPtr huge = pool.acquire(1000000);
+  BOOST_CHECK_EQUAL(huge->writableBytes(), 1000000);
+  BOOST_CHECK_EQUAL(pool.leased(), 3);
+
+  // a slightly grown buffer goes back to the class it fits
+  small->append(string(1500, 'x'));
+  pool.release(&small);
+  BOOST_CHECK_EQUAL(pool.cachedBytes(), 1024);
+  // a much grown one is freed
+  medium->append(string(10000, 'x'));
+  pool.release(&medium);
+  BOOST_CHECK_EQUAL(pool.cachedBytes(), 1024);
+
+  // oversized buffer is freed
+  pool.release(&huge);
+  BOOST_CHECK_EQUAL(pool.cachedBytes(), 1024);
+  BOOST_CHECK_EQUAL(pool.leased(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(testBufferPoolLimit)
+{
+  BufferPool pool(8192);
+  BufferPtr a = pool.acquire(4096);
+  BufferPtr b = pool.acquire(4096);
+  BufferPtr c = pool.acquire(4096);
+  BufferPtr shared = b;
+  pool.release(&a);
+  pool.release(&b);
+  BOOST_CHECK_EQUAL(pool.cachedBytes(), 4096);
+  pool.release(&c);
+  BOOST_CHECK_EQUAL(pool.cachedBytes(), 8192);
+  BufferPtr d = pool.acquire(4096);
+  pool.release(&d);
+  pool.release(&shared);
+  BOOST_CHECK_EQUAL(pool.cachedBytes(), 8192);
+  BOOST_CHECK(!pool.stats().empty());
+}
+
+BOOST_AUTO_TEST_CASE(testBufferPoolScratch)
+{
+  BufferPool pool;
+  BufferPtr scratch = pool.scratch();
+  BOOST_CHECK_EQUAL(scratch->writableBytes(), BufferPool::kScratchSize);
+  BOOST_CHECK_EQUAL(pool.scratch(), scratch);
+  BOOST_CHECK_EQUAL(pool.leased(), 1);
+
+  BufferPtr taken = pool.takeScratch();
+  BOOST_CHECK_EQUAL(taken, scratch);
+  BOOST_CHECK(pool.scratch() != taken);
+  BOOST_CHECK_EQUAL(pool.leased(), 2);
+
+  scratch.reset();
+  pool.release(&taken);
+  BOOST_CHECK_EQUAL(pool.leased(), 1);
+  BOOST_CHECK_EQUAL(pool.cachedBytes(), static_cast<int64_t>(BufferPool::kScratchSize));
+}
+
+BOOST_AUTO_TEST_CASE(testBufferPoolChainAdoptsBuffer)
+{
+  BufferPool pool;
+  BufferChain chain;
+  chain.setBufferPool(&pool);
+  chain.append("hello", 5);
+  BOOST_CHECK_EQUAL(pool.leased(), 1);
+
+  // what send(Buffer*) does, buf gets a pooled buffer in exchange
+  Buffer buf;
+  buf.append(string(5000, 'x'));
+  chain.append(&buf);
+  BOOST_CHECK_EQUAL(pool.leased(), 2);
+  BOOST_CHECK_EQUAL(buf.readableBytes(), 0);
+  BOOST_CHECK_GE(buf.writableBytes(), 5000);
+  chain.append(string(5000, 'y'));
+
+  // the adopted storage goes back to the pool too
+  chain.retrieveAll();
+  BOOST_CHECK_EQUAL(pool.leased(), 0);
+  BOOST_CHECK_GT(pool.cachedBytes(), 16384);
+}
+
+namespace
+{
+
+const uint16_t kPort = 20260;
+int g_echoed = 0;
+
+void onServerMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  g_echoed += static_cast<int>(buf->readableBytes());
+  conn->send(buf);
+}
+
+void onClientConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->send(string(10000, 'x'));
+  }
+}
+
+void onClientMessage(TcpClient* client, Buffer* buf)
+{
+  buf->retrieveAll();
+  if (g_echoed == 10000)
+  {
+    client->disconnect();
+  }
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(testBufferPoolLeasedAfterSendBuffer)
+{
+  EventLoop loop;
+  InetAddress addr(kPort, true);
+  TcpServer server(&loop, addr, "BufferPoolServer");
+  server.setMessageCallback(onServerMessage);
+  server.start();
+
+  TcpClient client(&loop, addr, "BufferPoolClient");
+  client.setConnectionCallback(onClientConnection);
+  client.setMessageCallback(boost::bind(onClientMessage, &client, _2));
+  client.connect();
+  loop.runAfter(1.0, boost::bind(&EventLoop::quit, &loop));
+  loop.loop();
+
+  BOOST_CHECK_EQUAL(g_echoed, 10000);
+  // every buffer leased by either side is back
+  BOOST_CHECK_EQUAL(loop.bufferPool()->leased(), 0);
+}
@@ -5,6 +5,8 @@
 #define BOOST_TEST_DYN_LINK
 #include <boost/test/unit_test.hpp>
 
+#include <stdlib.h>
+
 using muduo::string;
 using muduo::net::Buffer;
 
@@ -152,6 +154,62 @@ BOOST_AUTO_TEST_CASE(testBufferFindEOL)
   BOOST_CHECK_EQUAL(buf.findEOL(buf.peek()+90000), null);
 }
 
+BOOST_AUTO_TEST_CASE(testBufferFindCRLF)
+{
+  Buffer buf;
+  const char* null = NULL;
+  BOOST_CHECK(buf.findCRLF() == null);
+  buf.append("GET / HTTP/1.1\r\nHost: x\r\n\r\nbody\r");
+  BOOST_CHECK(buf.findCRLF() == buf.peek() + 14);
+  BOOST_CHECK(buf.findCRLF(buf.peek() + 15) == buf.peek() + 23);
+  BOOST_CHECK(buf.findCRLFCRLF() == buf.peek() + 23);
+  BOOST_CHECK(buf.findCRLFCRLF(buf.peek() + 24) == null);
+  BOOST_CHECK(buf.findCRLF(buf.peek() + 27) == null);
+  BOOST_CHECK(buf.find(":") == buf.peek() + 20);
+  BOOST_CHECK(buf.find(buf.peek() + 21, " x") == buf.peek() + 21);
+  BOOST_CHECK(buf.find("\r\r") == null);
+}
+
+BOOST_AUTO_TEST_CASE(testBufferFindRandom)
+{
+  // every length and alignment around the vector widths,
+  // against a plain std::search.
+  const char* needles[] = { "", "\n", "\r\n", "\r\n\r\n", "||", "abc", "\r\n\r\n\r\n\r\n" };
+  const int kNumNeedles = static_cast<int>(sizeof needles / sizeof needles[0]);
+  srand(42);
+  for (int round = 0; round < 200; ++round)
+  {
+    string data;
+    int len = rand() % 300;
+    for (int i = 0; i < len; ++i)
+    {
+      static const char kAlphabet[] = "\r\n|abcx";
+      data += kAlphabet[rand() % (sizeof kAlphabet - 1)];
+    }
+    for (int offset = 0; offset < 40 && offset <= len; ++offset)
+    {
+      Buffer buf;
+      buf.append(data);
+      buf.retrieve(offset);
+      const char* end = buf.peek() + buf.readableBytes();
+      for (int n = 0; n < kNumNeedles; ++n)
+      {
+        const char* needle = needles[n];
+        const char* expected = std::search(buf.peek(), end,
+                                           needle, needle + strlen(needle));
+        // an empty needle is found even in an empty buffer
+        if (expected == end && needle[0] != '\0')
+        {
+          expected = NULL;
+        }
+        BOOST_CHECK(buf.find(needle) == expected);
+      }
+      const char* crlf = std::search(buf.peek(), end, "\r\n", "\r\n" + 2);
+      BOOST_CHECK(buf.findCRLF() == (crlf == end ? NULL : crlf));
+    }
+  }
+}
+
 #ifdef __GXX_EXPERIMENTAL_CXX0X__
 void output(Buffer&& buf, const void* inner)
 {
@@ -0,0 +1,204 @@
+// Bulk transfer with many connections, level vs edge triggered epoll.
+//
+// "level" reads once per readable event (the default read policy), so
+// a connection with data left in the kernel comes back from every
+// epoll_wait.
+// "edge" is TcpConnection::setEdgeTriggered(), which drains to EAGAIN
+// within a budget, and carries the rest over in the loop's ready list.
+// "upload": clients stream to the server, the server discards.
+// "download": the server keeps the output buffer of every connection
+// non-empty, clients discard.
+//
+// usage: edgetriggered_bench [connections] [drain budget KiB] [seconds]
+
+#include <muduo/base/Thread.h>
+#include <muduo/base/Timestamp.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/TcpServer.h>
+
+#include <boost/bind.hpp>
+#include <vector>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+const uint16_t kPort = 2018;
+const size_t kChunkSize = 256 * 1024;
+
+bool g_edge = false;
+bool g_download = false;
+size_t g_budget = TcpConnection::kDefaultDrainBudget;
+int64_t g_received = 0;
+int64_t g_readEvents = 0;
+string g_chunk(kChunkSize, 'x');
+
+void onConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    if (g_edge)
+    {
+      conn->setEdgeTriggered(true, g_budget);
+    }
+    if (g_download)
+    {
+      conn->send(g_chunk);
+    }
+  }
+  else
+  {
+    g_readEvents += conn->readStats().wakeups;
+  }
+}
+
+void onMessage(const TcpConnectionPtr&, Buffer* buf, Timestamp)
+{
+  g_received += buf->readableBytes();
+  buf->retrieveAll();
+}
+
+void onWriteComplete(const TcpConnectionPtr& conn)
+{
+  conn->send(g_chunk);
+}
+
+double threadCpuSeconds()
+{
+  struct rusage usage;
+  ::getrusage(RUSAGE_THREAD, &usage);
+  return static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+         + static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+struct Result
+{
+  int64_t bytes;
+  double seconds;
+};
+
+void runClient(EventLoop* loop, const InetAddress& serverAddr,
+               int connections, double seconds, Result* result)
+{
+  int epfd = ::epoll_create1(EPOLL_CLOEXEC);
+  std::vector<int> fds;
+  for (int i = 0; i < connections; ++i)
+  {
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+    if (fd < 0 || (::connect(fd, serverAddr.getSockAddr(), sizeof(struct sockaddr_in)) < 0
+                   && errno != EINPROGRESS))
+    {
+      perror("connect");
+      exit(1);
+    }
+    struct epoll_event ev;
+    ev.events = g_download ? EPOLLIN : EPOLLOUT;
+    ev.data.fd = fd;
+    ::epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+    fds.push_back(fd);
+  }
+
+  std::vector<struct epoll_event> events(1024);
+  std::vector<char> buf(65536, 'x');
+  int64_t bytes = 0;
+  Timestamp start(Timestamp::now());
+  double elapsed = 0;
+  while (elapsed < seconds)
+  {
+    int n = ::epoll_wait(epfd, &events[0], static_cast<int>(events.size()), 100);
+    for (int i = 0; i < n; ++i)
+    {
+      int fd = events[i].data.fd;
+      ssize_t nr = g_download ? ::read(fd, &buf[0], buf.size())
+                              : ::write(fd, &buf[0], buf.size());
+      if (nr > 0)
+      {
+        bytes += nr;
+      }
+    }
+    elapsed = timeDifference(Timestamp::now(), start);
+  }
+
+  for (size_t i = 0; i < fds.size(); ++i)
+  {
+    ::close(fds[i]);
+  }
+  ::close(epfd);
+  result->bytes = bytes;
+  result->seconds = elapsed;
+  loop->runAfter(0.5, boost::bind(&EventLoop::quit, loop));
+}
+
+void bench(const char* name, bool edge, bool download,
+           int connections, double seconds)
+{
+  g_edge = edge;
+  g_download = download;
+  g_received = 0;
+  g_readEvents = 0;
+
+  Result result = { 0, 0 };
+  double cpu = 0;
+  int64_t iterations = 0;
+  int64_t ready = 0;
+  int64_t syscalls = 0;
+  {
+    EventLoop loop;
+    InetAddress listenAddr(kPort, true);
+    TcpServer server(&loop, listenAddr, "EdgeBench");
+    server.setConnectionCallback(onConnection);
+    server.setMessageCallback(onMessage);
+    if (download)
+    {
+      server.setWriteCompleteCallback(onWriteComplete);
+    }
+    server.start();
+
+    Thread client(boost::bind(runClient, &loop, listenAddr,
+                              connections, seconds, &result), "client");
+    double cpuStart = threadCpuSeconds();
+    client.start();
+    loop.loop();
+    cpu = threadCpuSeconds() - cpuStart;
+    client.join();
+    iterations = loop.iteration();
+    ready = loop.readyChannelCount();
+    syscalls = loop.syscallCount();
+  }
+
+  double mib = static_cast<double>(result.bytes) / 1024 / 1024;
+  printf("%-6s %-8s %d connections: %.2f MiB/s, server %.1f ms/GiB, "
+         "%lld loop iterations, %lld read events, %lld from ready list, "
+         "%lld poller syscalls\n",
+         name, download ? "download" : "upload", connections,
+         mib / result.seconds, cpu * 1e3 / (mib / 1024),
+         static_cast<long long>(iterations),
+         static_cast<long long>(g_readEvents),
+         static_cast<long long>(ready),
+         static_cast<long long>(syscalls));
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+  int connections = argc > 1 ? atoi(argv[1]) : 100;
+  g_budget = argc > 2 ? atoi(argv[2]) * 1024 : TcpConnection::kDefaultDrainBudget;
+  double seconds = argc > 3 ? atof(argv[3]) : 3.0;
+
+  bench("level", false, false, connections, seconds);
+  bench("edge", true, false, connections, seconds);
+  bench("level", false, true, connections, seconds);
+  bench("edge", true, true, connections, seconds);
+}
@@ -0,0 +1,181 @@
+// Benchmark of EventLoop::queueInLoop() with many producer threads.
+//
+// "mutex" replays the old path: a mutex-guarded std::vector of functors
+// and one eventfd write per functor.
+// "mpsc" is EventLoop::queueInLoop() itself.
+//
+// usage: eventloopqueue_bench [threads] [functors per thread]
+
+#include <muduo/base/CountDownLatch.h>
+#include <muduo/base/Mutex.h>
+#include <muduo/base/Thread.h>
+#include <muduo/base/Timestamp.h>
+#include <muduo/net/Channel.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/EventLoopThread.h>
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+// The pending functor queue as it was before the lock-free one.
+class MutexQueue : boost::noncopyable
+{
+ public:
+  explicit MutexQueue(EventLoop* loop)
+    : loop_(loop),
+      wakeupFd_(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+      wakeupChannel_(loop, wakeupFd_),
+      wakeups_(0)
+  {
+    wakeupChannel_.setReadCallback(boost::bind(&MutexQueue::handleRead, this));
+    CountDownLatch latch(1);
+    loop_->runInLoop(boost::bind(&MutexQueue::start, this, &latch));
+    latch.wait();
+  }
+
+  ~MutexQueue()
+  {
+    CountDownLatch latch(1);
+    loop_->runInLoop(boost::bind(&MutexQueue::stop, this, &latch));
+    latch.wait();
+    ::close(wakeupFd_);
+  }
+
+  void queueInLoop(const EventLoop::Functor& cb)
+  {
+    {
+      MutexLockGuard lock(mutex_);
+      pendingFunctors_.push_back(cb);
+    }
+    uint64_t one = 1;
+    if (::write(wakeupFd_, &one, sizeof one) == sizeof one)
+    {
+      __sync_fetch_and_add(&wakeups_, 1);
+    }
+  }
+
+  int64_t wakeupCount() const { return wakeups_; }
+
+ private:
+  void start(CountDownLatch* latch)
+  {
+    wakeupChannel_.enableReading();
+    latch->countDown();
+  }
+
+  void stop(CountDownLatch* latch)
+  {
+    wakeupChannel_.disableAll();
+    wakeupChannel_.remove();
+    latch->countDown();
+  }
+
+  void handleRead()
+  {
+    uint64_t one = 0;
+    ssize_t n = ::read(wakeupFd_, &one, sizeof one);
+    (void)n;
+    std::vector<EventLoop::Functor> functors;
+    {
+      MutexLockGuard lock(mutex_);
+      functors.swap(pendingFunctors_);
+    }
+    for (size_t i = 0; i < functors.size(); ++i)
+    {
+      functors[i]();
+    }
+  }
+
+  EventLoop* loop_;
+  int wakeupFd_;
+  Channel wakeupChannel_;
+  int64_t wakeups_;
+  MutexLock mutex_;
+  std::vector<EventLoop::Functor> pendingFunctors_;
+};
+
+int64_t g_done = 0;  // loop thread only
+int64_t g_total = 0;
+CountDownLatch* g_finished = NULL;
+
+void work()
+{
+  if (++g_done == g_total)
+  {
+    g_finished->countDown();
+  }
+}
+
+void produce(EventLoop* loop, MutexQueue* queue, int functors)
+{
+  for (int i = 0; i < functors; ++i)
+  {
+    if (queue)
+    {
+      queue->queueInLoop(work);
+    }
+    else
+    {
+      loop->queueInLoop(work);
+    }
+  }
+}
+
+void bench(const char* name, EventLoop* loop, MutexQueue* queue,
+           int threads, int functors)
+{
+  CountDownLatch finished(1);
+  g_done = 0;
+  g_total = static_cast<int64_t>(threads) * functors;
+  g_finished = &finished;
+  int64_t wakeupsBefore = queue ? queue->wakeupCount() : loop->wakeupCount();
+
+  boost::ptr_vector<Thread> producers;
+  for (int i = 0; i < threads; ++i)
+  {
+    producers.push_back(new Thread(boost::bind(produce, loop, queue, functors)));
+  }
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < threads; ++i)
+  {
+    producers[i].start();
+  }
+  finished.wait();
+  double seconds = timeDifference(Timestamp::now(), start);
+  for (int i = 0; i < threads; ++i)
+  {
+    producers[i].join();
+  }
+
+  int64_t wakeups = (queue ? queue->wakeupCount() : loop->wakeupCount()) - wakeupsBefore;
+  printf("%-6s %2d threads x %d: %.3f seconds, %.0f functors/s, %lld eventfd writes\n",
+         name, threads, functors, seconds,
+         static_cast<double>(g_total) / seconds, static_cast<long long>(wakeups));
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+  int threads = argc > 1 ? atoi(argv[1]) : 32;
+  int functors = argc > 2 ? atoi(argv[2]) : 100000;
+
+  EventLoopThread loopThread;
+  EventLoop* loop = loopThread.startLoop();
+  {
+    MutexQueue queue(loop);
+    bench("mutex", loop, &queue, threads, functors);
+  }
+  bench("mpsc", loop, NULL, threads, functors);
+}
@@ -4,6 +4,7 @@
 
 #include <boost/bind.hpp>
 
+#include <sched.h>
 #include <stdio.h>
 #include <unistd.h>
 
@@ -22,6 +23,14 @@ void init(EventLoop* p)
          getpid(), CurrentThread::tid(), p);
 }
 
+void printCpu(EventLoop* p)
+{
+  int cpu = sched_getcpu();
+  printf("printCpu(): tid = %d, loop = %p, cpu = %d\n",
+         CurrentThread::tid(), p, cpu);
+  assert(cpu == 0);
+}
+
 int main()
 {
   print();
@@ -65,6 +74,71 @@ int main()
     assert(nextLoop == model.getNextLoop());
   }
 
+  {
+    printf("Placement:\n");
+    EventLoopThreadPool model(&loop, "placement");
+    model.setThreadNum(3);
+    model.start(init);
+    std::vector<EventLoop*> loops = model.getAllLoops();
+    loops[0]->addConnectionCount(5);
+    loops[1]->addConnectionCount(1);
+    loops[2]->addConnectionCount(3);
+    loops[2]->addPendingOutputBytes(100);
+
+    model.setPlacement(EventLoopThreadPool::kLeastConnections);
+    assert(model.getNextLoop() == loops[1]);
+    loops[1]->addConnectionCount(4);
+    assert(model.getNextLoop() == loops[2]);
+
+    // no bytes pending on 0 and 1, the one with fewer connections wins
+    model.setPlacement(EventLoopThreadPool::kLeastPendingBytes);
+    assert(model.getNextLoop() == loops[0]);
+    loops[0]->addPendingOutputBytes(200);
+    assert(model.getNextLoop() == loops[1]);
+
+    // never picks the busiest of three
+    loops[0]->addConnectionCount(2);
+    model.setPlacement(EventLoopThreadPool::kPowerOfTwoChoices);
+    for (int i = 0; i < 100; ++i)
+    {
+      assert(model.getNextLoop() != loops[0]);
+    }
+
+    loops[0]->addConnectionCount(-7);
+    loops[1]->addConnectionCount(-5);
+    loops[2]->addConnectionCount(-3);
+    loops[0]->addPendingOutputBytes(-200);
+    loops[2]->addPendingOutputBytes(-100);
+  }
+
+  {
+    printf("Cpu affinity:\n");
+    EventLoopThreadPool model(&loop, "affinity");
+    model.setThreadNum(2);
+    std::vector<int> cpus(1, 0);
+    model.setCpuAffinity(cpus);
+    model.start(init);
+    std::vector<EventLoop*> loops = model.getAllLoops();
+    for (size_t i = 0; i < loops.size(); ++i)
+    {
+      assert(model.cpuOf(loops[i]) == 0);
+      loops[i]->runInLoop(boost::bind(printCpu, loops[i]));
+    }
+    assert(model.cpuOf(&loop) == -1);
+    // the first loop pinned to a cpu, round robin for others
+    assert(model.getLoopForCpu(0) == loops[0]);
+    assert(model.getLoopForCpu(0) == loops[0]);
+    assert(model.getLoopForCpu(-1) != model.getLoopForCpu(-1));
+
+    std::vector<int> node0 = EventLoopThreadPool::cpusOfNode(0);
+    printf("cpus of node 0:");
+    for (size_t i = 0; i < node0.size(); ++i)
+    {
+      printf(" %d", node0[i]);
+    }
+    printf("\n");
+  }
+
   loop.loop();
 }
 
@@ -0,0 +1,61 @@
+#include <muduo/net/Histogram.h>
+
+//#define BOOST_TEST_MODULE HistogramTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using muduo::net::Histogram;
+
+BOOST_AUTO_TEST_CASE(testHistogramBuckets)
+{
+  BOOST_CHECK_EQUAL(Histogram::bucketLow(0), 0);
+  BOOST_CHECK_EQUAL(Histogram::bucketHigh(0), 0);
+  BOOST_CHECK_EQUAL(Histogram::bucketLow(1), 1);
+  BOOST_CHECK_EQUAL(Histogram::bucketHigh(1), 1);
+  BOOST_CHECK_EQUAL(Histogram::bucketLow(4), 8);
+  BOOST_CHECK_EQUAL(Histogram::bucketHigh(4), 15);
+
+  Histogram h;
+  h.add(0);
+  h.add(1);
+  h.add(8);
+  h.add(15);
+  h.add(16);
+  BOOST_CHECK_EQUAL(h.count(), 5);
+  BOOST_CHECK_EQUAL(h.sum(), 40);
+  BOOST_CHECK_EQUAL(h.max(), 16);
+  BOOST_CHECK_EQUAL(h.bucketCount(0), 1);
+  BOOST_CHECK_EQUAL(h.bucketCount(1), 1);
+  BOOST_CHECK_EQUAL(h.bucketCount(4), 2);
+  BOOST_CHECK_EQUAL(h.bucketCount(5), 1);
+}
+
+BOOST_AUTO_TEST_CASE(testHistogramPercentile)
+{
+  Histogram h;
+  BOOST_CHECK_EQUAL(h.percentile(50), 0);
+  for (int i = 0; i < 90; ++i)
+  {
+    h.add(3);
+  }
+  for (int i = 0; i < 10; ++i)
+  {
+    h.add(1000);
+  }
+  BOOST_CHECK_EQUAL(h.percentile(50), 3);
+  BOOST_CHECK_EQUAL(h.percentile(90), 3);
+  // bucket 512-1023, capped by the maximum
+  BOOST_CHECK_EQUAL(h.percentile(99), 1000);
+  BOOST_CHECK_EQUAL(h.percentile(100), 1000);
+}
+
+BOOST_AUTO_TEST_CASE(testHistogramOverflow)
+{
+  Histogram h;
+  h.add(-5);
+  h.add(static_cast<int64_t>(1) << 50);
+  BOOST_CHECK_EQUAL(h.bucketCount(0), 1);
+  BOOST_CHECK_EQUAL(h.bucketCount(Histogram::kNumBuckets - 1), 1);
+  BOOST_CHECK_EQUAL(h.percentile(100), static_cast<int64_t>(1) << 50);
+}
@@ -0,0 +1,134 @@
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/TcpClient.h>
+#include <muduo/net/TcpServer.h>
+#include <muduo/net/poller/IoUringPoller.h>
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+//#define BOOST_TEST_MODULE IoUringEchoTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+using muduo::string;
+using muduo::Timestamp;
+using muduo::net::Buffer;
+using muduo::net::EventLoop;
+using muduo::net::InetAddress;
+using muduo::net::IoUringPoller;
+using muduo::net::TcpClient;
+using muduo::net::TcpConnectionPtr;
+using muduo::net::TcpServer;
+
+namespace
+{
+
+const uint16_t kPort = 20290;
+const int kClients = 8;
+// larger than the socket buffers, so both sides wait for POLLOUT
+const size_t kMessageSize = 1024 * 1024;
+
+EventLoop* g_clientLoop = NULL;
+string g_message;
+int g_echoed = 0;
+int g_mismatched = 0;
+int g_closed = 0;
+
+void onServerMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  conn->send(buf);
+}
+
+void onClientConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->setContext(static_cast<size_t>(0));
+    conn->send(g_message);
+  }
+  else if (++g_closed == kClients)
+  {
+    g_clientLoop->quit();
+  }
+}
+
+void onClientMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  size_t* received = boost::any_cast<size_t>(conn->getMutableContext());
+  size_t n = buf->readableBytes();
+  if (*received + n > kMessageSize
+      || g_message.compare(*received, n, buf->peek(), n) != 0)
+  {
+    ++g_mismatched;
+  }
+  *received += n;
+  buf->retrieveAll();
+  if (*received == kMessageSize)
+  {
+    ++g_echoed;
+    conn->shutdown();
+  }
+}
+
+void testEcho(int numThreads)
+{
+  ::setenv("MUDUO_USE_IOURING", "1", 1);
+  g_echoed = 0;
+  g_mismatched = 0;
+  g_closed = 0;
+  g_message.clear();
+  for (size_t i = 0; i < kMessageSize; ++i)
+  {
+    g_message.push_back(static_cast<char>('A' + i % 61));
+  }
+
+  EventLoop loop;
+  g_clientLoop = &loop;
+  if (!IoUringPoller(&loop).valid())
+  {
+    BOOST_TEST_MESSAGE("io_uring is not available, skipped");
+    ::unsetenv("MUDUO_USE_IOURING");
+    return;
+  }
+
+  InetAddress addr(kPort, true);
+  TcpServer server(&loop, addr, "IoUringEchoServer");
+  server.setThreadNum(numThreads);
+  server.setMessageCallback(onServerMessage);
+  server.start();
+
+  boost::ptr_vector<TcpClient> clients;
+  for (int i = 0; i < kClients; ++i)
+  {
+    char name[32];
+    snprintf(name, sizeof name, "client%d", i);
+    clients.push_back(new TcpClient(&loop, addr, name));
+    clients.back().setConnectionCallback(onClientConnection);
+    clients.back().setMessageCallback(onClientMessage);
+    clients.back().connect();
+  }
+  loop.runAfter(10.0, boost::bind(&EventLoop::quit, &loop));
+  loop.loop();
+
+  BOOST_CHECK_EQUAL(g_echoed, kClients);
+  BOOST_CHECK_EQUAL(g_mismatched, 0);
+  BOOST_CHECK_EQUAL(g_closed, kClients);
+  ::unsetenv("MUDUO_USE_IOURING");
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(testIoUringEchoSingleThread)
+{
+  testEcho(0);
+}
+
+BOOST_AUTO_TEST_CASE(testIoUringEchoThreadPool)
+{
+  testEcho(3);
+}
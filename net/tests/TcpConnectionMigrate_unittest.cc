@@ -0,0 +1,596 @@
+#include <muduo/base/Mutex.h>
+#include <muduo/base/Thread.h>
+#include <muduo/net/BufferPool.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/EventLoopThreadPool.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/TcpClient.h>
+#include <muduo/net/TcpServer.h>
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/scoped_ptr.hpp>
+
+//#define BOOST_TEST_MODULE TcpConnectionMigrateTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <map>
+#include <set>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using muduo::AtomicInt32;
+using muduo::MutexLock;
+using muduo::MutexLockGuard;
+using muduo::Thread;
+using muduo::string;
+using muduo::Timestamp;
+using muduo::net::Buffer;
+using muduo::net::EventLoop;
+using muduo::net::InetAddress;
+using muduo::net::TcpClient;
+using muduo::net::TcpConnectionPtr;
+using muduo::net::TcpServer;
+
+namespace
+{
+
+const uint16_t kPort = 20220;
+const int kMigrations = 20;
+const size_t kChunk = 16 * 1024;
+const size_t kWindow = 256 * 1024;
+
+char patternAt(size_t i)
+{
+  return static_cast<char>(i % 251);
+}
+
+MutexLock g_mutex;
+TcpConnectionPtr g_serverConn;       // guarded by g_mutex
+std::set<EventLoop*> g_seenLoops;    // guarded by g_mutex
+AtomicInt32 g_wrongThread;
+AtomicInt32 g_serverClosed;
+
+void onServerConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->setContext(size_t(0));
+    MutexLockGuard lock(g_mutex);
+    g_serverConn = conn;
+  }
+  else
+  {
+    g_serverClosed.increment();
+  }
+}
+
+void onServerMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  if (!conn->getLoop()->isInLoopThread())
+  {
+    g_wrongThread.increment();
+  }
+  {
+    MutexLockGuard lock(g_mutex);
+    g_seenLoops.insert(conn->getLoop());
+  }
+  // the context moves along with the connection
+  size_t* received = boost::any_cast<size_t>(conn->getMutableContext());
+  *received += buf->readableBytes();
+  conn->send(buf);
+}
+
+class EchoClient
+{
+ public:
+  EchoClient(EventLoop* loop, const InetAddress& addr, TcpServer* server)
+    : loop_(loop),
+      client_(loop, addr, "MigrateClient"),
+      server_(server),
+      sent_(0),
+      received_(0),
+      corrupted_(false),
+      stopped_(false)
+  {
+    client_.setConnectionCallback(boost::bind(&EchoClient::onConnection, this, _1));
+    client_.setMessageCallback(boost::bind(&EchoClient::onMessage, this, _1, _2, _3));
+  }
+
+  void connect() { client_.connect(); }
+  void disconnect() { client_.disconnect(); }
+
+  size_t sent() const { return sent_; }
+  size_t received() const { return received_; }
+  bool corrupted() const { return corrupted_; }
+
+ private:
+  void onConnection(const TcpConnectionPtr& conn)
+  {
+    if (conn->connected())
+    {
+      sendMore(conn);
+    }
+  }
+
+  void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+  {
+    const char* data = buf->peek();
+    for (size_t i = 0; i < buf->readableBytes(); ++i)
+    {
+      if (data[i] != patternAt(received_ + i))
+      {
+        corrupted_ = true;
+      }
+    }
+    received_ += buf->readableBytes();
+    buf->retrieveAll();
+    if (server_->migrationCount() >= kMigrations)
+    {
+      stopped_ = true;
+    }
+    if (stopped_ && received_ == sent_)
+    {
+      loop_->quit();
+    }
+    else
+    {
+      sendMore(conn);
+    }
+  }
+
+  // keeps at most kWindow bytes in flight
+  void sendMore(const TcpConnectionPtr& conn)
+  {
+    while (!stopped_ && sent_ - received_ < kWindow)
+    {
+      char chunk[kChunk];
+      for (size_t i = 0; i < kChunk; ++i)
+      {
+        chunk[i] = patternAt(sent_ + i);
+      }
+      conn->send(chunk, static_cast<int>(kChunk));
+      sent_ += kChunk;
+    }
+  }
+
+  EventLoop* loop_;
+  TcpClient client_;
+  TcpServer* server_;
+  size_t sent_;
+  size_t received_;
+  bool corrupted_;
+  bool stopped_;
+};
+
+int g_round = 0;
+
+void migrate(TcpServer* server)
+{
+  TcpConnectionPtr conn;
+  {
+    MutexLockGuard lock(g_mutex);
+    conn = g_serverConn;
+  }
+  if (conn)
+  {
+    std::vector<EventLoop*> loops(server->threadPool()->getAllLoops());
+    // migrating to its current loop is refused, the next round moves it
+    server->migrateConnection(conn, loops[++g_round % loops.size()]);
+  }
+}
+
+void testMigrate(TcpServer::Option option)
+{
+  {
+    MutexLockGuard lock(g_mutex);
+    g_serverConn.reset();
+    g_seenLoops.clear();
+  }
+  g_wrongThread.getAndSet(0);
+  g_serverClosed.getAndSet(0);
+
+  EventLoop loop;
+  InetAddress addr(kPort, true);
+  TcpServer server(&loop, addr, "MigrateServer", option);
+  server.setThreadNum(2);
+  server.setIdleTimeout(10);
+  server.setConnectionCallback(onServerConnection);
+  server.setMessageCallback(onServerMessage);
+  server.start();
+
+  EchoClient client(&loop, addr, &server);
+  // the pool loops listen asynchronously with kReusePortPerLoop
+  loop.runAfter(0.1, boost::bind(&EchoClient::connect, &client));
+  loop.runEvery(0.005, boost::bind(migrate, &server));
+  loop.runAfter(10.0, boost::bind(&EventLoop::quit, &loop));
+  loop.loop();
+
+  BOOST_CHECK_GE(server.migrationCount(), kMigrations);
+  BOOST_CHECK(!client.corrupted());
+  BOOST_CHECK_GT(client.sent(), 0U);
+  BOOST_CHECK_EQUAL(client.received(), client.sent());
+  BOOST_CHECK_EQUAL(g_wrongThread.get(), 0);
+  {
+    MutexLockGuard lock(g_mutex);
+    BOOST_CHECK_EQUAL(g_seenLoops.size(), 2U);
+    BOOST_REQUIRE(g_serverConn);
+    BOOST_CHECK_EQUAL(boost::any_cast<size_t>(g_serverConn->getContext()), client.sent());
+    // lets the server close the socket
+    g_serverConn.reset();
+  }
+
+  // the connection closes in the loop it was moved to
+  client.disconnect();
+  loop.runAfter(0.5, boost::bind(&EventLoop::quit, &loop));
+  loop.loop();
+  BOOST_CHECK_EQUAL(g_serverClosed.get(), 1);
+}
+
+// rebalance: two chatty connections start on the same loop, one gets moved
+
+// the loop handling the latest message of each connection
+std::map<string, EventLoop*> g_chatty;  // guarded by g_mutex
+
+void onBusyMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  buf->retrieveAll();
+  {
+    MutexLockGuard lock(g_mutex);
+    g_chatty[conn->name()] = conn->getLoop();
+  }
+  // pretend handling a message takes 1ms
+  Timestamp start(Timestamp::now());
+  while (timeDifference(Timestamp::now(), start) < 0.001)
+  {
+  }
+}
+
+void chat(TcpClient* client)
+{
+  TcpConnectionPtr conn(client->connection());
+  if (conn)
+  {
+    conn->send("ping");
+  }
+}
+
+// senders: worker threads send to a connection being moved between loops
+
+const int kSenders = 4;
+const int kMessagesPerSender = 5000;
+const int kRecordSize = 16;
+
+// one record: sender id and sequence number
+string makeRecord(int sender, int seq)
+{
+  char buf[kRecordSize + 1];
+  snprintf(buf, sizeof buf, "%d%015d", sender, seq);
+  return string(buf, kRecordSize);
+}
+
+void sendFromWorker(int sender)
+{
+  TcpConnectionPtr conn;
+  {
+    MutexLockGuard lock(g_mutex);
+    conn = g_serverConn;
+  }
+  for (int i = 0; i < kMessagesPerSender; ++i)
+  {
+    conn->send(makeRecord(sender, i));
+    if (i % 50 == 49)
+    {
+      // spread the sends over many migrations
+      muduo::CurrentThread::sleepUsec(1000);
+    }
+  }
+}
+
+class RecordChecker
+{
+ public:
+  explicit RecordChecker(EventLoop* loop)
+    : loop_(loop),
+      received_(0),
+      outOfOrder_(false)
+  {
+    memset(next_, 0, sizeof next_);
+  }
+
+  void onMessage(const TcpConnectionPtr&, Buffer* buf, Timestamp)
+  {
+    while (buf->readableBytes() >= static_cast<size_t>(kRecordSize))
+    {
+      string record(buf->peek(), kRecordSize);
+      buf->retrieve(kRecordSize);
+      int sender = record[0] - '0';
+      int seq = atoi(record.c_str() + 1);
+      // each sender's records arrive in the order it sent them
+      if (sender < 0 || sender >= kSenders || seq != next_[sender])
+      {
+        outOfOrder_ = true;
+      }
+      else
+      {
+        ++next_[sender];
+      }
+      if (++received_ == kSenders * kMessagesPerSender)
+      {
+        loop_->quit();
+      }
+    }
+  }
+
+  int received() const { return received_; }
+  bool outOfOrder() const { return outOfOrder_; }
+
+ private:
+  EventLoop* loop_;
+  int received_;
+  bool outOfOrder_;
+  int next_[kSenders];
+};
+
+void startSenders(boost::ptr_vector<Thread>* senders)
+{
+  for (int i = 0; i < kSenders; ++i)
+  {
+    senders->push_back(new Thread(boost::bind(sendFromWorker, i)));
+    senders->back().start();
+  }
+}
+
+// rebalance in one round: the first rebalance moves several connections
+
+const int kChattyClients = 8;
+int64_t g_firstRound = 0;
+
+void watchMigrations(EventLoop* loop, TcpServer* server)
+{
+  if (g_firstRound == 0 && server->migrationCount() > 0)
+  {
+    // well within one rebalance interval
+    loop->runAfter(0.03, boost::bind(&EventLoop::quit, loop));
+    g_firstRound = -1;
+  }
+}
+
+// destroying: the server goes away while connections are being moved
+
+std::vector<TcpConnectionPtr> g_serverConns;  // guarded by g_mutex
+int g_clientsUp = 0;
+int g_clientsDown = 0;
+
+void onCollectedConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    MutexLockGuard lock(g_mutex);
+    g_serverConns.push_back(conn);
+  }
+}
+
+void onCountedClient(EventLoop* loop, const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    ++g_clientsUp;
+  }
+  else if (++g_clientsDown == g_clientsUp)
+  {
+    loop->quit();
+  }
+}
+
+void migrateAllAndDestroy(boost::scoped_ptr<TcpServer>* server)
+{
+  std::vector<TcpConnectionPtr> conns;
+  {
+    MutexLockGuard lock(g_mutex);
+    conns.swap(g_serverConns);
+  }
+  std::vector<EventLoop*> loops((*server)->threadPool()->getAllLoops());
+  for (int round = 0; round < 3; ++round)
+  {
+    for (size_t i = 0; i < conns.size(); ++i)
+    {
+      (*server)->migrateConnection(conns[i], loops[(i + round) % loops.size()]);
+    }
+  }
+  conns.clear();
+  server->reset();
+}
+
+void testDestroyWhileMigrating(TcpServer::Option option)
+{
+  g_clientsUp = 0;
+  g_clientsDown = 0;
+  EventLoop loop;
+  InetAddress addr(kPort, true);
+  boost::scoped_ptr<TcpServer> server(new TcpServer(&loop, addr, "DestroyServer", option));
+  server->setThreadNum(3);
+  server->setIdleTimeout(10);
+  server->setConnectionCallback(onCollectedConnection);
+  server->start();
+
+  boost::ptr_vector<TcpClient> clients;
+  for (int i = 0; i < kChattyClients; ++i)
+  {
+    char name[32];
+    snprintf(name, sizeof name, "client%d", i);
+    clients.push_back(new TcpClient(&loop, addr, name));
+    clients.back().setConnectionCallback(boost::bind(onCountedClient, &loop, _1));
+    loop.runAfter(0.1, boost::bind(&TcpClient::connect, &clients.back()));
+  }
+  loop.runAfter(0.3, boost::bind(migrateAllAndDestroy, &server));
+  loop.runAfter(3.0, boost::bind(&EventLoop::quit, &loop));
+  loop.loop();
+
+  BOOST_CHECK(!server);
+  BOOST_CHECK_EQUAL(g_clientsUp, kChattyClients);
+  // every connection is closed, including the ones still on their way
+  BOOST_CHECK_EQUAL(g_clientsDown, kChattyClients);
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(testMigrateConnection)
+{
+  testMigrate(TcpServer::kNoReusePort);
+}
+
+BOOST_AUTO_TEST_CASE(testMigrateReusePortPerLoop)
+{
+  testMigrate(TcpServer::kReusePortPerLoop);
+}
+
+BOOST_AUTO_TEST_CASE(testRebalance)
+{
+  EventLoop loop;
+  InetAddress addr(kPort, true);
+  TcpServer server(&loop, addr, "RebalanceServer");
+  server.setThreadNum(2);
+  server.setRebalance(0.1, 0.2);
+  server.setMessageCallback(onBusyMessage);
+  server.start();
+
+  // round robin: client0 and client2 go to the first loop, client1 to the second
+  boost::ptr_vector<TcpClient> clients;
+  for (int i = 0; i < 3; ++i)
+  {
+    char name[32];
+    snprintf(name, sizeof name, "client%d", i);
+    clients.push_back(new TcpClient(&loop, addr, name));
+    loop.runAfter(0.05 * (i + 1), boost::bind(&TcpClient::connect, &clients.back()));
+  }
+  loop.runEvery(0.005, boost::bind(chat, &clients[0]));
+  loop.runEvery(0.005, boost::bind(chat, &clients[2]));
+  loop.runAfter(1.5, boost::bind(&EventLoop::quit, &loop));
+  loop.loop();
+
+  BOOST_CHECK_GE(server.migrationCount(), 1);
+  {
+    MutexLockGuard lock(g_mutex);
+    BOOST_CHECK_EQUAL(g_chatty.size(), 2U);
+    // the chatty connections end up on different loops
+    BOOST_CHECK(g_chatty.size() == 2
+                && g_chatty.begin()->second != g_chatty.rbegin()->second);
+  }
+
+  for (size_t i = 0; i < clients.size(); ++i)
+  {
+    clients[i].disconnect();
+  }
+  loop.runAfter(0.5, boost::bind(&EventLoop::quit, &loop));
+  loop.loop();
+}
+
+BOOST_AUTO_TEST_CASE(testRebalanceSeveralInOneRound)
+{
+  {
+    MutexLockGuard lock(g_mutex);
+    g_chatty.clear();
+  }
+  g_firstRound = 0;
+
+  EventLoop loop;
+  InetAddress addr(kPort, true);
+  TcpServer server(&loop, addr, "RebalanceServer");
+  server.setThreadNum(2);
+  server.setRebalance(0.1, 0.2);
+  server.setMessageCallback(onBusyMessage);
+  server.start();
+
+  // round robin: the even clients chat, all on the first loop
+  boost::ptr_vector<TcpClient> clients;
+  for (int i = 0; i < 2 * kChattyClients; ++i)
+  {
+    char name[32];
+    snprintf(name, sizeof name, "client%d", i);
+    clients.push_back(new TcpClient(&loop, addr, name));
+    loop.runAfter(0.01 * (i + 1), boost::bind(&TcpClient::connect, &clients.back()));
+    if (i % 2 == 0)
+    {
+      loop.runEvery(0.02, boost::bind(chat, &clients.back()));
+    }
+  }
+  loop.runEvery(0.005, boost::bind(watchMigrations, &loop, &server));
+  loop.runAfter(3.0, boost::bind(&EventLoop::quit, &loop));
+  loop.loop();
+
+  // about half of the chatty connections move in the first round
+  BOOST_CHECK_GE(server.migrationCount(), kChattyClients / 2 - 1);
+  BOOST_CHECK_LE(server.migrationCount(), kChattyClients / 2 + 1);
+
+  for (size_t i = 0; i < clients.size(); ++i)
+  {
+    clients[i].disconnect();
+  }
+  loop.runAfter(0.5, boost::bind(&EventLoop::quit, &loop));
+  loop.loop();
+}
+
+BOOST_AUTO_TEST_CASE(testDestroyServerWhileMigrating)
+{
+  testDestroyWhileMigrating(TcpServer::kNoReusePort);
+}
+
+BOOST_AUTO_TEST_CASE(testDestroyReusePortServerWhileMigrating)
+{
+  testDestroyWhileMigrating(TcpServer::kReusePortPerLoop);
+}
+
+BOOST_AUTO_TEST_CASE(testSendFromThreadsWhileMigrating)
+{
+  {
+    MutexLockGuard lock(g_mutex);
+    g_serverConn.reset();
+  }
+  g_round = 0;
+
+  EventLoop loop;
+  InetAddress addr(kPort, true);
+  TcpServer server(&loop, addr, "SendersServer");
+  server.setThreadNum(2);
+  server.setConnectionCallback(onServerConnection);
+  server.start();
+
+  RecordChecker checker(&loop);
+  TcpClient client(&loop, addr, "SendersClient");
+  client.setMessageCallback(boost::bind(&RecordChecker::onMessage, &checker, _1, _2, _3));
+  client.connect();
+
+  boost::ptr_vector<Thread> senders;
+  loop.runAfter(0.2, boost::bind(startSenders, &senders));
+  // the same path the rebalancer takes, but much more often
+  loop.runEvery(0.002, boost::bind(migrate, &server));
+  loop.runAfter(10.0, boost::bind(&EventLoop::quit, &loop));
+  loop.loop();
+  for (size_t i = 0; i < senders.size(); ++i)
+  {
+    senders[i].join();
+  }
+
+  BOOST_CHECK_EQUAL(checker.received(), kSenders * kMessagesPerSender);
+  BOOST_CHECK(!checker.outOfOrder());
+  BOOST_CHECK_GE(server.migrationCount(), 10);
+  {
+    MutexLockGuard lock(g_mutex);
+    g_serverConn.reset();
+  }
+
+  client.disconnect();
+  loop.runAfter(0.5, boost::bind(&EventLoop::quit, &loop));
+  loop.loop();
+
+  // buffers leased in one loop and given back in another are accounted to the right pool
+  std::vector<EventLoop*> loops(server.threadPool()->getAllLoops());
+  for (size_t i = 0; i < loops.size(); ++i)
+  {
+    BOOST_CHECK_EQUAL(loops[i]->bufferPool()->leased(), 0);
+  }
+}
@@ -0,0 +1,177 @@
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/TcpClient.h>
+#include <muduo/net/TcpServer.h>
+
+#include <boost/bind.hpp>
+
+//#define BOOST_TEST_MODULE TcpConnectionSendFileTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <stdio.h>
+#include <unistd.h>
+
+using muduo::string;
+using muduo::Timestamp;
+using muduo::net::Buffer;
+using muduo::net::EventLoop;
+using muduo::net::InetAddress;
+using muduo::net::TcpClient;
+using muduo::net::TcpConnectionPtr;
+using muduo::net::TcpServer;
+
+namespace
+{
+
+const uint16_t kPort = 20270;
+const size_t kFileSize = 100 * 1000;
+
+FILE* g_file = NULL;
+// queue this much in front of the file, so it is written from handleWrite
+size_t g_headSize = 0;
+size_t g_truncatedSize = 0;
+int g_writeCompleted = 0;
+size_t g_received = 0;
+bool g_clientClosed = false;
+
+void onServerConnection(const TcpConnectionPtr& conn)
+{
+  if (!conn->connected())
+  {
+    return;
+  }
+  conn->cork();
+  if (g_headSize > 0)
+  {
+    conn->send(string(g_headSize, 'h'));
+  }
+  conn->sendFile(::fileno(g_file), 0, kFileSize);
+  // the file shrinks before it is sent
+  BOOST_REQUIRE_EQUAL(::ftruncate(::fileno(g_file), g_truncatedSize), 0);
+  conn->uncork();
+  conn->shutdown();
+}
+
+void onWriteComplete(const TcpConnectionPtr&)
+{
+  ++g_writeCompleted;
+}
+
+void onServerConnectionEmptyFile(EventLoop* loop, const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->sendFile(::fileno(g_file), 0, 0);
+  }
+  else
+  {
+    // the client has closed by now
+    loop->quit();
+  }
+}
+
+// callers chain the next send on write complete
+void onWriteCompleteEmptyFile(const TcpConnectionPtr& conn)
+{
+  ++g_writeCompleted;
+  conn->shutdown();
+}
+
+void onClientConnection(EventLoop* loop, const TcpConnectionPtr& conn)
+{
+  if (conn->disconnected())
+  {
+    g_clientClosed = true;
+    if (loop)
+    {
+      loop->quit();
+    }
+  }
+}
+
+void onClientMessage(Buffer* buf)
+{
+  g_received += buf->readableBytes();
+  buf->retrieveAll();
+}
+
+void testTruncatedFile(size_t headSize, size_t truncatedSize)
+{
+  g_file = ::tmpfile();
+  BOOST_REQUIRE(g_file != NULL);
+  string content(kFileSize, 'f');
+  BOOST_REQUIRE_EQUAL(::fwrite(content.data(), 1, content.size(), g_file), content.size());
+  ::fflush(g_file);
+  g_headSize = headSize;
+  g_truncatedSize = truncatedSize;
+  g_writeCompleted = 0;
+  g_received = 0;
+  g_clientClosed = false;
+
+  EventLoop loop;
+  InetAddress addr(kPort, true);
+  TcpServer server(&loop, addr, "SendFileServer");
+  server.setConnectionCallback(onServerConnection);
+  server.setWriteCompleteCallback(onWriteComplete);
+  server.start();
+
+  TcpClient client(&loop, addr, "SendFileClient");
+  client.setConnectionCallback(boost::bind(onClientConnection, &loop, _1));
+  client.setMessageCallback(boost::bind(onClientMessage, _2));
+  client.connect();
+  loop.runAfter(5.0, boost::bind(&EventLoop::quit, &loop));
+  loop.loop();
+
+  // the peer sees the connection closed, instead of waiting for the rest forever
+  BOOST_CHECK(g_clientClosed);
+  BOOST_CHECK_LE(g_received, headSize + truncatedSize);
+  BOOST_CHECK_GE(g_received, headSize);
+  BOOST_CHECK_EQUAL(g_writeCompleted, 0);
+  ::fclose(g_file);
+  g_file = NULL;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(testEmptyFileWriteComplete)
+{
+  g_file = ::tmpfile();
+  BOOST_REQUIRE(g_file != NULL);
+  g_writeCompleted = 0;
+  g_received = 0;
+  g_clientClosed = false;
+
+  EventLoop loop;
+  InetAddress addr(kPort, true);
+  TcpServer server(&loop, addr, "SendFileServer");
+  server.setConnectionCallback(boost::bind(onServerConnectionEmptyFile, &loop, _1));
+  server.setWriteCompleteCallback(onWriteCompleteEmptyFile);
+  server.start();
+
+  TcpClient client(&loop, addr, "SendFileClient");
+  client.setConnectionCallback(boost::bind(onClientConnection, static_cast<EventLoop*>(NULL), _1));
+  client.setMessageCallback(boost::bind(onClientMessage, _2));
+  client.connect();
+  loop.runAfter(5.0, boost::bind(&EventLoop::quit, &loop));
+  loop.loop();
+
+  BOOST_CHECK_EQUAL(g_writeCompleted, 1);
+  BOOST_CHECK(g_clientClosed);
+  BOOST_CHECK_EQUAL(g_received, 0);
+  ::fclose(g_file);
+  g_file = NULL;
+}
+
+BOOST_AUTO_TEST_CASE(testTruncatedFileFlush)
+{
+  // the first sendfile(2) in uncork() hits the end of file
+  testTruncatedFile(0, 0);
+}
+
+BOOST_AUTO_TEST_CASE(testTruncatedFileHandleWrite)
+{
+  // more than the socket buffers hold, the file is sent from handleWrite()
+  testTruncatedFile(16 * 1024 * 1024, 1000);
+}
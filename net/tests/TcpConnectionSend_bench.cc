@@ -0,0 +1,149 @@
+// Benchmark of TcpConnection::send() from threads other than the loop thread.
+//
+// "functor" emulates the old path, one runInLoop(boost::bind(...)) per message,
+// "queue" is the current path through the per-connection send queue.
+//
+// usage: tcpconnectionsend_bench [threads] [messages per thread] [message size]
+
+#include <muduo/base/CountDownLatch.h>
+#include <muduo/base/Thread.h>
+#include <muduo/base/Timestamp.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/EventLoopThread.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/SocketsOps.h>
+#include <muduo/net/TcpServer.h>
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+const uint16_t kPort = 2016;
+
+CountDownLatch g_connected(1);
+TcpConnectionPtr g_conn;
+
+void onConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    g_conn = conn;
+    g_connected.countDown();
+  }
+}
+
+void sendInLoop(const TcpConnectionPtr& conn, const string& message)
+{
+  conn->send(message);
+}
+
+void produce(bool useQueue, int messages, const string* message)
+{
+  EventLoop* loop = g_conn->getLoop();
+  for (int i = 0; i < messages; ++i)
+  {
+    if (useQueue)
+    {
+      g_conn->send(*message);
+    }
+    else
+    {
+      loop->runInLoop(boost::bind(sendInLoop, g_conn, *message));
+    }
+  }
+}
+
+void drain(int sockfd, int64_t total)
+{
+  char buf[65536];
+  while (total > 0)
+  {
+    ssize_t n = ::read(sockfd, buf, sizeof buf);
+    if (n <= 0)
+    {
+      perror("read");
+      exit(1);
+    }
+    total -= n;
+  }
+}
+
+void bench(const char* name, bool useQueue, int sockfd,
+           int threads, int messages, int size)
+{
+  string message(size, 'x');
+  boost::ptr_vector<Thread> producers;
+  for (int i = 0; i < threads; ++i)
+  {
+    producers.push_back(new Thread(boost::bind(produce, useQueue, messages, &message)));
+  }
+
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < threads; ++i)
+  {
+    producers[i].start();
+  }
+  drain(sockfd, static_cast<int64_t>(threads) * messages * size);
+  double seconds = timeDifference(Timestamp::now(), start);
+  for (int i = 0; i < threads; ++i)
+  {
+    producers[i].join();
+  }
+
+  double total = static_cast<double>(threads) * messages;
+  printf("%-8s %d threads, %d x %d bytes: %.3f seconds, %.0f msg/s, %.2f MiB/s\n",
+         name, threads, messages, size, seconds,
+         total / seconds, total * size / seconds / 1024 / 1024);
+}
+
+void runBench(EventLoop* loop, const InetAddress& serverAddr,
+              int threads, int messages, int size)
+{
+  int sockfd = sockets::createNonblockingOrDie(serverAddr.family());
+  int ret = sockets::connect(sockfd, serverAddr.getSockAddr());
+  if (ret < 0 && errno != EINPROGRESS)
+  {
+    perror("connect");
+    exit(1);
+  }
+  // blocking reads from now on
+  ::fcntl(sockfd, F_SETFL, 0);
+  g_connected.wait();
+
+  bench("functor", false, sockfd, threads, messages, size);
+  bench("queue", true, sockfd, threads, messages, size);
+
+  sockets::close(sockfd);
+  g_conn.reset();
+  loop->quit();
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+  int threads = argc > 1 ? atoi(argv[1]) : 4;
+  int messages = argc > 2 ? atoi(argv[2]) : 200000;
+  int size = argc > 3 ? atoi(argv[3]) : 64;
+
+  EventLoop loop;
+  InetAddress listenAddr(kPort, true);
+  TcpServer server(&loop, listenAddr, "SendBench");
+  server.setConnectionCallback(onConnection);
+  server.start();
+
+  Thread client(boost::bind(runBench, &loop, listenAddr, threads, messages, size), "client");
+  client.start();
+  loop.loop();
+  client.join();
+}
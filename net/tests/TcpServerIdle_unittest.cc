@@ -0,0 +1,108 @@
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/TcpClient.h>
+#include <muduo/net/TcpServer.h>
+
+#include <boost/bind.hpp>
+
+//#define BOOST_TEST_MODULE TcpServerIdleTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using muduo::Timestamp;
+using muduo::net::Buffer;
+using muduo::net::EventLoop;
+using muduo::net::InetAddress;
+using muduo::net::TcpClient;
+using muduo::net::TcpConnectionPtr;
+using muduo::net::TcpServer;
+
+namespace
+{
+
+const uint16_t kPort = 20190;
+
+struct Client
+{
+  Client(EventLoop* loop, const InetAddress& addr, const char* name)
+    : client(loop, addr, name),
+      connected(false)
+  {
+    client.setConnectionCallback(boost::bind(&Client::onConnection, this, _1));
+  }
+
+  void onConnection(const TcpConnectionPtr& conn)
+  {
+    connected = conn->connected();
+    if (!connected)
+    {
+      closedAt = Timestamp::now();
+    }
+  }
+
+  void ping()
+  {
+    TcpConnectionPtr conn(client.connection());
+    if (conn)
+    {
+      conn->send("ping");
+    }
+  }
+
+  TcpClient client;
+  bool connected;
+  Timestamp closedAt;
+};
+
+void discard(const TcpConnectionPtr&, Buffer* buf, Timestamp)
+{
+  buf->retrieveAll();
+}
+
+void testIdleTimeout(int numThreads)
+{
+  EventLoop loop;
+  InetAddress addr(kPort, true);
+  TcpServer server(&loop, addr, "IdleServer");
+  server.setThreadNum(numThreads);
+  server.setMessageCallback(discard);
+  server.setIdleTimeout(1);
+  server.start();
+
+  Client active(&loop, addr, "ActiveClient");
+  Client silent(&loop, addr, "SilentClient");
+  Timestamp start(Timestamp::now());
+  active.client.connect();
+  silent.client.connect();
+  loop.runEvery(0.3, boost::bind(&Client::ping, &active));
+  loop.runAfter(3.2, boost::bind(&EventLoop::quit, &loop));
+  loop.loop();
+
+  // idle for at least one second, closed by the check in the second after
+  BOOST_CHECK(!silent.connected);
+  BOOST_REQUIRE(silent.closedAt.valid());
+  double idle = timeDifference(silent.closedAt, start);
+  BOOST_CHECK_GE(idle, 0.9);
+  BOOST_CHECK_LE(idle, 2.5);
+  BOOST_CHECK(active.connected);
+  BOOST_CHECK_EQUAL(server.idleClosedCount(), 1);
+
+  active.client.disconnect();
+  loop.runAfter(0.2, boost::bind(&EventLoop::quit, &loop));
+  loop.loop();
+  BOOST_CHECK(!active.connected);
+  BOOST_CHECK_EQUAL(server.idleClosedCount(), 1);
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(testIdleTimeoutSingleThread)
+{
+  testIdleTimeout(0);
+}
+
+BOOST_AUTO_TEST_CASE(testIdleTimeoutThreadPool)
+{
+  testIdleTimeout(2);
+}
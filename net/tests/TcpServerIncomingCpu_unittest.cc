@@ -0,0 +1,107 @@
+#include <muduo/base/Mutex.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/EventLoopThreadPool.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/TcpClient.h>
+#include <muduo/net/TcpServer.h>
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+//#define BOOST_TEST_MODULE TcpServerIncomingCpuTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <map>
+#include <stdio.h>
+#include <unistd.h>
+
+using muduo::MutexLock;
+using muduo::MutexLockGuard;
+using muduo::net::EventLoop;
+using muduo::net::EventLoopThreadPool;
+using muduo::net::InetAddress;
+using muduo::net::TcpClient;
+using muduo::net::TcpConnectionPtr;
+using muduo::net::TcpServer;
+
+namespace
+{
+
+const uint16_t kPort = 20240;
+
+MutexLock g_mutex;
+std::map<EventLoop*, int> g_accepted;  // guarded by g_mutex
+
+void onServerConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    MutexLockGuard lock(g_mutex);
+    ++g_accepted[conn->getLoop()];
+  }
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(testIncomingCpuPlacement)
+{
+  int numCpus = static_cast<int>(::sysconf(_SC_NPROCESSORS_ONLN));
+  std::vector<int> cpus;
+  for (int i = 0; i < numCpus; ++i)
+  {
+    cpus.push_back(i);
+  }
+
+  EventLoop loop;
+  InetAddress addr(kPort, true);
+  TcpServer server(&loop, addr, "IncomingCpuServer");
+  // one loop per cpu, plus a second loop on cpu 0 which is never the first
+  server.setThreadNum(numCpus + 1);
+  server.threadPool()->setCpuAffinity(cpus);
+  server.threadPool()->setPlacement(EventLoopThreadPool::kIncomingCpu);
+  server.setConnectionCallback(onServerConnection);
+  server.start();
+
+  std::vector<EventLoop*> loops(server.threadPool()->getAllLoops());
+  for (int i = 0; i < numCpus; ++i)
+  {
+    BOOST_CHECK_EQUAL(server.threadPool()->cpuOf(loops[i]), i);
+    BOOST_CHECK(server.threadPool()->getLoopForCpu(i) == loops[i]);
+  }
+  BOOST_CHECK_EQUAL(server.threadPool()->cpuOf(loops[numCpus]), 0);
+  BOOST_CHECK(server.threadPool()->cpuOf(&loop) == -1);
+
+  // round robin would have used every loop
+  const int kClients = 2 * (numCpus + 1);
+  boost::ptr_vector<TcpClient> clients;
+  for (int i = 0; i < kClients; ++i)
+  {
+    char name[32];
+    snprintf(name, sizeof name, "client%d", i);
+    clients.push_back(new TcpClient(&loop, addr, name));
+    clients.back().connect();
+  }
+  loop.runAfter(0.5, boost::bind(&EventLoop::quit, &loop));
+  loop.loop();
+
+  {
+    MutexLockGuard lock(g_mutex);
+    int accepted = 0;
+    for (std::map<EventLoop*, int>::iterator it = g_accepted.begin();
+         it != g_accepted.end(); ++it)
+    {
+      accepted += it->second;
+    }
+    BOOST_CHECK_EQUAL(accepted, kClients);
+    BOOST_CHECK_EQUAL(g_accepted.count(loops[numCpus]), 0U);
+  }
+
+  for (int i = 0; i < kClients; ++i)
+  {
+    clients[i].disconnect();
+  }
+  loop.runAfter(0.2, boost::bind(&EventLoop::quit, &loop));
+  loop.loop();
+}
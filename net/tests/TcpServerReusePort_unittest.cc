@@ -0,0 +1,271 @@
+#include <muduo/base/Atomic.h>
+#include <muduo/base/Mutex.h>
+#include <muduo/base/Thread.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/TcpClient.h>
+#include <muduo/net/TcpServer.h>
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/scoped_ptr.hpp>
+
+//#define BOOST_TEST_MODULE TcpServerReusePortTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <map>
+#include <vector>
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using muduo::AtomicInt32;
+using muduo::MutexLock;
+using muduo::MutexLockGuard;
+using muduo::Timestamp;
+using muduo::net::Buffer;
+using muduo::net::EventLoop;
+using muduo::net::InetAddress;
+using muduo::net::TcpClient;
+using muduo::net::TcpConnectionPtr;
+using muduo::net::TcpServer;
+using muduo::Thread;
+
+namespace
+{
+
+const uint16_t kPort = 20200;
+const int kClients = 32;
+
+MutexLock g_mutex;
+std::map<EventLoop*, int> g_accepted;  // guarded by g_mutex
+int g_echoed = 0;
+int g_connected = 0;
+int g_closed = 0;
+bool g_quitOnConnected = false;
+EventLoop* g_clientLoop = NULL;
+
+int acceptedCount()
+{
+  MutexLockGuard lock(g_mutex);
+  int accepted = 0;
+  for (std::map<EventLoop*, int>::iterator it = g_accepted.begin();
+       it != g_accepted.end(); ++it)
+  {
+    accepted += it->second;
+  }
+  return accepted;
+}
+
+// in the client loop, once both sides have seen every connection
+void quitIfAllConnected()
+{
+  if (g_quitOnConnected && g_connected == kClients && acceptedCount() == kClients)
+  {
+    g_clientLoop->quit();
+  }
+}
+
+void onServerConnection(const TcpConnectionPtr& conn)
+{
+  // each loop accepts for itself, so the callback runs in the connection's loop
+  conn->getLoop()->assertInLoopThread();
+  if (conn->connected())
+  {
+    {
+      MutexLockGuard lock(g_mutex);
+      ++g_accepted[conn->getLoop()];
+    }
+    g_clientLoop->queueInLoop(quitIfAllConnected);
+  }
+}
+
+void onServerMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  conn->send(buf);
+}
+
+void onClientConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->send("hello");
+    ++g_connected;
+    // the server loops may not have run their connection callbacks yet
+    quitIfAllConnected();
+  }
+  else if (++g_closed == kClients)
+  {
+    g_clientLoop->quit();
+  }
+}
+
+void onClientMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  if (buf->readableBytes() >= 5)
+  {
+    buf->retrieveAll();
+    conn->shutdown();
+    ++g_echoed;
+  }
+}
+
+void testReusePortPerLoop(int numThreads, bool closeAll)
+{
+  g_accepted.clear();
+  g_echoed = 0;
+  g_connected = 0;
+  g_closed = 0;
+  g_quitOnConnected = !closeAll;
+
+  EventLoop loop;
+  g_clientLoop = &loop;
+  InetAddress addr(kPort, true);
+  boost::scoped_ptr<TcpServer> server(
+      new TcpServer(&loop, addr, "ReusePortServer", TcpServer::kReusePortPerLoop));
+  server->setThreadNum(numThreads);
+  server->setConnectionCallback(onServerConnection);
+  server->setMessageCallback(onServerMessage);
+  server->start();
+
+  boost::ptr_vector<TcpClient> clients;
+  for (int i = 0; i < kClients; ++i)
+  {
+    char name[32];
+    snprintf(name, sizeof name, "client%d", i);
+    clients.push_back(new TcpClient(&loop, addr, name));
+    clients.back().setConnectionCallback(onClientConnection);
+    if (closeAll)
+    {
+      clients.back().setMessageCallback(onClientMessage);
+    }
+    // the pool loops listen asynchronously after start()
+    loop.runAfter(0.1, boost::bind(&TcpClient::connect, &clients.back()));
+  }
+  loop.runAfter(5.0, boost::bind(&EventLoop::quit, &loop));
+  loop.loop();
+
+  int accepted = acceptedCount();
+  {
+    MutexLockGuard lock(g_mutex);
+    // the kernel spreads connections over the listening sockets
+    BOOST_CHECK_EQUAL(g_accepted.size(), static_cast<size_t>(numThreads > 0 ? numThreads : 1));
+  }
+  BOOST_CHECK_EQUAL(accepted, kClients);
+  if (closeAll)
+  {
+    BOOST_CHECK_EQUAL(g_echoed, kClients);
+  }
+  else
+  {
+    // the server destroys live connections in their own loops
+    BOOST_CHECK_EQUAL(g_closed, 0);
+    server.reset();
+    loop.runAfter(5.0, boost::bind(&EventLoop::quit, &loop));
+    loop.loop();
+  }
+  BOOST_CHECK_EQUAL(g_closed, kClients);
+}
+
+AtomicInt32 g_serverUp;
+AtomicInt32 g_serverDown;
+AtomicInt32 g_stopConnecting;
+int g_upAtDestroy = 0;
+int g_downAtDestroy = 0;
+
+void onCountingConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    g_serverUp.increment();
+  }
+  else
+  {
+    g_serverDown.increment();
+  }
+}
+
+// keeps connecting with blocking sockets, and keeps the last few open
+void connectLoop()
+{
+  struct sockaddr_in addr;
+  bzero(&addr, sizeof addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(kPort);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  std::vector<int> open;
+  while (g_stopConnecting.get() == 0)
+  {
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr) == 0)
+    {
+      open.push_back(fd);
+    }
+    else
+    {
+      ::close(fd);
+    }
+    if (open.size() > 16)
+    {
+      ::close(open.front());
+      open.erase(open.begin());
+    }
+  }
+  for (size_t i = 0; i < open.size(); ++i)
+  {
+    ::close(open[i]);
+  }
+}
+
+void destroyServer(boost::scoped_ptr<TcpServer>* server)
+{
+  server->reset();
+  // the destructor waits for every loop to close its acceptor and connections
+  g_upAtDestroy = g_serverUp.get();
+  g_downAtDestroy = g_serverDown.get();
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(testReusePortSingleThread)
+{
+  testReusePortPerLoop(0, true);
+}
+
+BOOST_AUTO_TEST_CASE(testReusePortThreadPool)
+{
+  testReusePortPerLoop(3, true);
+}
+
+BOOST_AUTO_TEST_CASE(testReusePortDestroyLive)
+{
+  testReusePortPerLoop(3, false);
+}
+
+BOOST_AUTO_TEST_CASE(testReusePortDestroyWhileConnecting)
+{
+  EventLoop loop;
+  InetAddress addr(kPort, true);
+  boost::scoped_ptr<TcpServer> server(
+      new TcpServer(&loop, addr, "ReusePortServer", TcpServer::kReusePortPerLoop));
+  server->setThreadNum(3);
+  server->setConnectionCallback(onCountingConnection);
+  server->start();
+
+  // the pool loops listen asynchronously after start()
+  Thread connector(connectLoop, "connector");
+  loop.runAfter(0.1, boost::bind(&Thread::start, &connector));
+  loop.runAfter(0.5, boost::bind(destroyServer, &server));
+  loop.runAfter(0.7, boost::bind(&EventLoop::quit, &loop));
+  loop.loop();
+  g_stopConnecting.getAndSet(1);
+  connector.join();
+
+  BOOST_CHECK(!server);
+  BOOST_CHECK_GT(g_upAtDestroy, 0);
+  BOOST_CHECK_EQUAL(g_downAtDestroy, g_upAtDestroy);
+  BOOST_CHECK_EQUAL(g_serverDown.get(), g_serverUp.get());
+}
@@ -0,0 +1,105 @@
+#include <muduo/net/EventLoop.h>
+
+#include <boost/bind.hpp>
+
+//#define BOOST_TEST_MODULE TimerSlackTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+using muduo::Timestamp;
+using muduo::net::EventLoop;
+
+namespace
+{
+
+struct Fired
+{
+  Timestamp earliest;
+  Timestamp latest;
+  Timestamp when;
+};
+
+std::vector<Fired> g_fired;
+
+void onTimer(EventLoop* loop, size_t index, size_t total)
+{
+  g_fired[index].when = Timestamp::now();
+  bool done = true;
+  for (size_t i = 0; i < total; ++i)
+  {
+    done = done && g_fired[i].when.valid();
+  }
+  if (done)
+  {
+    loop->quit();
+  }
+}
+
+void checkFired()
+{
+  for (size_t i = 0; i < g_fired.size(); ++i)
+  {
+    BOOST_CHECK(g_fired[i].when.valid());
+    BOOST_CHECK(!(g_fired[i].when < g_fired[i].earliest));
+  }
+}
+
+void testCoalesce(bool wheel)
+{
+  EventLoop loop;
+  loop.setTimingWheel(wheel);
+  const size_t kTimers = 50;
+  g_fired.assign(kTimers + 1, Fired());
+
+  // arms the timerfd at 100ms
+  Timestamp start(Timestamp::now());
+  g_fired[0].earliest = addTime(start, 0.1);
+  loop.runAfter(0.1, boost::bind(onTimer, &loop, 0, kTimers + 1));
+  int64_t rearms = loop.timerRearmCount();
+
+  // 50ms..150ms windows all contain 100ms, and would each re-arm the
+  // timerfd without slack
+  for (size_t i = 1; i <= kTimers; ++i)
+  {
+    g_fired[i].earliest = addTime(start, 0.05);
+    loop.runAfterWithSlack(0.05, 0.1, boost::bind(onTimer, &loop, i, kTimers + 1));
+  }
+  BOOST_CHECK_EQUAL(loop.timerRearmCount(), rearms);
+  BOOST_CHECK_EQUAL(loop.timerRearmsAvoided(), static_cast<int64_t>(kTimers));
+
+  loop.loop();
+  checkFired();
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(testSlackCoalesceSet)
+{
+  testCoalesce(false);
+}
+
+BOOST_AUTO_TEST_CASE(testSlackCoalesceWheel)
+{
+  testCoalesce(true);
+}
+
+BOOST_AUTO_TEST_CASE(testSlackRounding)
+{
+  EventLoop loop;
+  const size_t kTimers = 20;
+  g_fired.assign(kTimers, Fired());
+  // no timer armed: each expiration is rounded up within its window,
+  // so nearby timers share a few expirations
+  for (size_t i = 0; i < kTimers; ++i)
+  {
+    double delay = 0.01 + 0.001 * static_cast<double>(i);
+    g_fired[i].earliest = addTime(Timestamp::now(), delay);
+    loop.runAfterWithSlack(delay, 0.05, boost::bind(onTimer, &loop, i, kTimers));
+  }
+  BOOST_CHECK_LT(loop.timerRearmCount(), static_cast<int64_t>(kTimers) / 2);
+  loop.loop();
+  checkFired();
+}
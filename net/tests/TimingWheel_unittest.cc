@@ -0,0 +1,189 @@
+#include <muduo/net/TimingWheel.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/Timer.h>
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+//#define BOOST_TEST_MODULE TimingWheelTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <set>
+#include <stdlib.h>
+
+using muduo::Timestamp;
+using muduo::net::EventLoop;
+using muduo::net::Timer;
+using muduo::net::TimingWheel;
+
+namespace
+{
+
+const int64_t kStart = 1500000000LL * 1000 * 1000 + 123;
+
+void noop()
+{
+}
+
+Timer* newTimer(int64_t when)
+{
+  static int64_t sequence = 0;
+  return new Timer(noop, Timestamp(when), 0.0, ++sequence);
+}
+
+std::vector<int> g_fired;
+int g_repeated = 0;
+
+void fire(int id)
+{
+  g_fired.push_back(id);
+}
+
+void repeat()
+{
+  ++g_repeated;
+}
+
+void toggleTimingWheel(EventLoop* loop)
+{
+  loop->setTimingWheel(!loop->timingWheel());
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(testTimingWheelOrder)
+{
+  TimingWheel wheel((Timestamp(kStart)));
+  boost::ptr_vector<Timer> timers;
+  timers.push_back(newTimer(kStart + 300 * 1000));  // level 1
+  timers.push_back(newTimer(kStart + 5));           // next tick
+  timers.push_back(newTimer(kStart - 1000));        // already expired
+  timers.push_back(newTimer(kStart + 3600LL * 1000 * 1000));  // an hour, level 3
+  for (size_t i = 0; i < timers.size(); ++i)
+  {
+    wheel.add(&timers[i]);
+  }
+  BOOST_CHECK_EQUAL(wheel.size(), 4u);
+
+  std::vector<Timer*> expired;
+  wheel.advance(Timestamp(kStart), &expired);
+  BOOST_CHECK(expired.empty());
+
+  // both land in the next tick, in the order they were added
+  BOOST_CHECK(wheel.nextExpiration() <= TimingWheel::roundUp(Timestamp(kStart + 5)));
+  wheel.advance(TimingWheel::roundUp(Timestamp(kStart + 5)), &expired);
+  BOOST_REQUIRE_EQUAL(expired.size(), 2u);
+  BOOST_CHECK_EQUAL(expired[0], &timers[1]);
+  BOOST_CHECK_EQUAL(expired[1], &timers[2]);
+
+  expired.clear();
+  wheel.advance(Timestamp(kStart + 300 * 1000 - 1), &expired);
+  BOOST_CHECK(expired.empty());
+  wheel.advance(Timestamp(kStart + 300 * 1000 + 1000), &expired);
+  BOOST_REQUIRE_EQUAL(expired.size(), 1u);
+  BOOST_CHECK_EQUAL(expired[0], &timers[0]);
+
+  wheel.remove(&timers[3]);
+  BOOST_CHECK(wheel.empty());
+  BOOST_CHECK(!wheel.nextExpiration().valid());
+}
+
+BOOST_AUTO_TEST_CASE(testTimingWheelRandom)
+{
+  srand(2018);
+  TimingWheel wheel((Timestamp(kStart)));
+  boost::ptr_vector<Timer> timers;
+  std::set<Timer*> pending;
+  int64_t now = kStart;
+  int64_t expiredCount = 0;
+
+  for (int round = 0; round < 20000; ++round)
+  {
+    int op = rand() % 10;
+    if (op < 5)
+    {
+      // delays from microseconds to about two months, beyond the wheel's range
+      int64_t delay = static_cast<int64_t>(rand() % 1000000) << (rand() % 24);
+      timers.push_back(newTimer(now + delay));
+      wheel.add(&timers.back());
+      pending.insert(&timers.back());
+    }
+    else if (op < 6 && !pending.empty())
+    {
+      Timer* timer = *pending.begin();
+      wheel.remove(timer);
+      pending.erase(timer);
+    }
+    else
+    {
+      // jump to the next expiration, or far ahead
+      Timestamp next = wheel.nextExpiration();
+      if (next.valid() && rand() % 4 != 0)
+      {
+        now = std::max(now, next.microSecondsSinceEpoch());
+      }
+      else
+      {
+        now += static_cast<int64_t>(rand() % 1000) << (rand() % 32);
+      }
+
+      std::vector<Timer*> expired;
+      wheel.advance(Timestamp(now), &expired);
+      for (size_t i = 0; i < expired.size(); ++i)
+      {
+        // never early
+        BOOST_REQUIRE(expired[i]->expiration().microSecondsSinceEpoch() <= now);
+        BOOST_REQUIRE_EQUAL(pending.erase(expired[i]), 1u);
+      }
+      expiredCount += static_cast<int64_t>(expired.size());
+    }
+
+    BOOST_REQUIRE_EQUAL(wheel.size(), pending.size());
+    for (std::set<Timer*>::iterator it = pending.begin(); it != pending.end(); ++it)
+    {
+      // never late: anything due by now is gone, and the wheel wakes up in time
+      Timestamp due = TimingWheel::roundUp((*it)->expiration());
+      BOOST_REQUIRE(due.microSecondsSinceEpoch() > now / 1000 * 1000);
+      BOOST_REQUIRE(wheel.nextExpiration() <= due);
+    }
+  }
+  BOOST_CHECK_GT(expiredCount, 1000);
+
+  std::vector<Timer*> rest;
+  wheel.takeAll(&rest);
+  BOOST_CHECK_EQUAL(rest.size(), pending.size());
+  BOOST_CHECK(wheel.empty());
+}
+
+BOOST_AUTO_TEST_CASE(testTimingWheelSwitchBackend)
+{
+  EventLoop loop;
+  bool wheel = loop.timingWheel();
+  for (int i = 0; i < 5; ++i)
+  {
+    loop.runAfter(0.05 + 0.05 * i, boost::bind(fire, i));
+  }
+  muduo::net::TimerId cancelled = loop.runAfter(0.12, boost::bind(fire, 100));
+  loop.runEvery(0.02, repeat);
+
+  // switch back and forth while timers are pending
+  loop.runAfter(0.03, boost::bind(toggleTimingWheel, &loop));
+  loop.runAfter(0.08, boost::bind(&EventLoop::cancel, &loop, cancelled));
+  loop.runAfter(0.11, boost::bind(toggleTimingWheel, &loop));
+  loop.runAfter(0.17, boost::bind(toggleTimingWheel, &loop));
+  loop.runAfter(0.4, boost::bind(&EventLoop::quit, &loop));
+  loop.loop();
+
+  BOOST_CHECK_EQUAL(loop.timingWheel(), !wheel);
+  BOOST_REQUIRE_EQUAL(g_fired.size(), 5u);
+  for (int i = 0; i < 5; ++i)
+  {
+    BOOST_CHECK_EQUAL(g_fired[i], i);
+  }
+  // about 20 runs in 0.4s, allow for a slow machine
+  BOOST_CHECK_GE(g_repeated, 10);
+  BOOST_CHECK_LE(g_repeated, 21);
+}